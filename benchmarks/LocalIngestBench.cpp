@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "opencmd.hpp"
+#include "ipc/LocalClient.hpp"
+#include "server/LocalIngest.hpp"
+#include "server/ServiceServer.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Decodes the same frame through the gRPC RPCs and through the shared memory
+// transport of an in-process server, one message at a time (round trip
+// latency) and pipelined (throughput).
+//
+// Usage: bench_local_ingest <catalog directory> <schema> <message base64> [messages]
+
+static void report(const char* name, size_t messages, size_t failures, Clock::time_point start) {
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-24s %10zu msgs %8.3f s %12.0f msg/s %10.2f us/msg %6zu failed\n",
+                name, messages, seconds, messages / seconds, seconds * 1e6 / messages, failures);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "Usage: %s <catalog directory> <schema> <message base64> [messages]\n", argv[0]);
+        return 1;
+    }
+    const std::string schemaName = argv[2];
+    const std::string messageBase64 = argv[3];
+    const size_t messages = argc > 4 ? std::stoul(argv[4]) : 200000;
+    const size_t roundTrips = messages / 10 > 0 ? messages / 10 : 1;
+
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    if (SchemaCatalog::getInstance().loadCatalog(argv[1])) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", argv[1]);
+        return 1;
+    }
+    auto schemaId = SchemaCatalog::getInstance().resolve(schemaName);
+    if (!schemaId) {
+        std::fprintf(stderr, "Unknown schema <%s>\n", schemaName.c_str());
+        return 1;
+    }
+    BitStream frame(messageBase64);
+
+    ServerOptions serverOptions;
+    serverOptions.address = "127.0.0.1:0";
+    ServiceServer server(serverOptions);
+    LocalIngestOptions localOptions;
+    localOptions.socketPath = "/tmp/openCMD-bench-" + std::to_string(::getpid()) + ".sock";
+    LocalIngest localIngest(localOptions);
+    if (server.start() || localIngest.start()) {
+        return 1;
+    }
+
+    auto channel = grpc::CreateChannel("127.0.0.1:" + std::to_string(server.getPort()), grpc::InsecureChannelCredentials());
+    auto stub = interface::service::NewStub(channel);
+    interface::toJsonRequest request;
+    request.set_schema_id(schemaId.value());
+    request.set_message(reinterpret_cast<const char*>(frame.getBuffer()), frame.getByteLength());
+    request.set_bit_length(static_cast<uint32_t>(frame.getCapacity()));
+
+    {
+        size_t failures = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < roundTrips; i++) {
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            if (!stub->toJson(&context, request, &response).ok() || response.response_status() != 0) {
+                failures++;
+            }
+        }
+        report("grpc unary", roundTrips, failures, start);
+    }
+
+    {
+        size_t failures = 0;
+        auto start = Clock::now();
+        grpc::ClientContext context;
+        auto stream = stub->toJsonStream(&context);
+        std::thread writer([&] {
+            for (size_t i = 0; i < messages; i++) {
+                stream->Write(request);
+            }
+            stream->WritesDone();
+        });
+        size_t received = 0;
+        interface::toJsonStreamResponse batch;
+        while (received < messages && stream->Read(&batch)) {
+            for (const auto& response : batch.responses()) {
+                failures += response.response_status() != 0;
+            }
+            received += batch.responses_size();
+        }
+        writer.join();
+        stream->Finish();
+        report("grpc stream", received, failures + (messages - received), start);
+    }
+
+    LocalClient client;
+    if (client.connect(localOptions.socketPath)) {
+        std::fprintf(stderr, "Error in connecting to <%s>\n", localOptions.socketPath.c_str());
+        return 1;
+    }
+    {
+        size_t failures = 0;
+        auto start = Clock::now();
+        LocalClient::Result result;
+        for (size_t i = 0; i < roundTrips; i++) {
+            if (!client.send(schemaId.value(), frame.getBuffer(), frame.getCapacity()) || !client.receive(result) || result.status != 0) {
+                failures++;
+            }
+        }
+        report("shared memory unary", roundTrips, failures, start);
+    }
+
+    {
+        size_t failures = 0;
+        auto start = Clock::now();
+        std::thread sender([&] {
+            for (size_t i = 0; i < messages; i++) {
+                client.send(schemaId.value(), frame.getBuffer(), frame.getCapacity());
+            }
+        });
+        LocalClient::Result result;
+        size_t received = 0;
+        while (received < messages && client.receive(result, 10000)) {
+            failures += result.status != 0;
+            received++;
+        }
+        sender.join();
+        report("shared memory pipelined", received, failures + (messages - received), start);
+    }
+
+    client.close();
+    localIngest.stop();
+    server.shutdown();
+    return 0;
+}
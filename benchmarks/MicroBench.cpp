@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "opencmd.hpp"
+#include "capture/DelimiterScan.hpp"
+#include "capture/FrameIndex.hpp"
+#include "generator/MessageGenerator.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Offline microbenchmarks of the building blocks: BitStream construction,
+// reads, appends, shifts and sync word search, base64 in both directions,
+// newline scan and frame index of base64 captures, schema parsing, message
+// generation and decode/encode of every schema of a catalog over generated
+// frames of several sizes.
+// Every benchmark reports ns/op, operations/s and heap allocations/op.
+//
+// With --baseline the allocations are compared with a JSON reference
+// baseline (benchmarks/baseline.json, committed: the allocations do not
+// depend on the machine), and with --timings the ns/op are compared with a
+// baseline of the machine (written when missing). The run fails when a
+// benchmark allocates more than the reference, or is slower than the
+// timings by more than --threshold percent. --update rewrites both.
+//
+// Usage: bench_micro <catalog directory> [--baseline file] [--timings file]
+//                    [--update] [--threshold percent] [--filter substring]
+//                    [--min-time seconds]
+
+// Heap allocations of the calling thread, counted by the replaced operator
+// new: the benchmarks run on the main thread, the allocations of the
+// background threads (logger flusher, error reporter) are not theirs
+static thread_local uint64_t allocations = 0;
+
+// Every form of new takes its memory from malloc (aligned_alloc for the
+// over-aligned types) and every form of delete gives it back to free. GCC
+// sees the replaced new as a new expression, not as malloc, and warns on
+// each free once the delete is inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+static void* allocate(size_t size, size_t alignment) {
+    allocations++;
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        return std::malloc(size);
+    }
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* operator new(size_t size) {
+    if (void* pointer = allocate(size, 0)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* pointer = allocate(size, static_cast<size_t>(alignment))) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+#pragma GCC diagnostic pop
+
+// Keeps the compiler from optimizing away a result
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    double nanosPerOp = 0;
+    double allocationsPerOp = 0;
+};
+
+struct BenchOptions {
+    std::string filter;
+    double minTime = 0.2;
+};
+
+class Bench {
+    BenchOptions options;
+    std::vector<BenchResult> results;
+
+public:
+    explicit Bench(const BenchOptions& options) : options(options) {}
+
+    const std::vector<BenchResult>& getResults() const { return results; }
+
+    // Runs <operation> in batches until <minTime>: the fastest of five
+    // batches is kept, the least disturbed by the rest of the machine
+    void run(const std::string& name, const std::function<void()>& operation) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        size_t iterations = 1;
+        for (;;) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                operation();
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds > options.minTime / 50 || iterations >= (size_t(1) << 30)) {
+                iterations = std::max<size_t>(1, static_cast<size_t>(iterations * (options.minTime / 5) / std::max(seconds, 1e-9)));
+                break;
+            }
+            iterations *= 4;
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.nanosPerOp = 1e300;
+        uint64_t allocationsBefore = allocations;
+        for (int batch = 0; batch < 5; batch++) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                operation();
+            }
+            double nanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            result.nanosPerOp = std::min(result.nanosPerOp, nanos / iterations);
+        }
+        result.allocationsPerOp = static_cast<double>(allocations - allocationsBefore) / (5.0 * iterations);
+        std::printf("%-44s %12.1f ns/op %14.0f op/s %10.2f allocs/op\n", name.c_str(), result.nanosPerOp, 1e9 / result.nanosPerOp,
+                    result.allocationsPerOp);
+        results.push_back(result);
+    }
+};
+
+static std::vector<uint8_t> randomBytes(std::mt19937_64& random, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+static void bitStreamBenchmarks(Bench& bench, std::mt19937_64& random) {
+    for (size_t size : {16, 256, 4096}) {
+        std::vector<uint8_t> bytes = randomBytes(random, size);
+        BitStream source(bytes.data(), size * 8);
+        std::string base64 = source.to_base64();
+        std::string suffix = "/" + std::to_string(size) + "B";
+
+        bench.run("bitstream/construct_buffer" + suffix, [&] {
+            BitStream bitStream(bytes.data(), size * 8);
+            keep(bitStream);
+        });
+        bench.run("bitstream/view" + suffix, [&] {
+            BitStream bitStream = BitStream::view(bytes.data(), size * 8);
+            keep(bitStream);
+        });
+        Arena arena;
+        bench.run("base64/decode" + suffix, [&] {
+            BitStream bitStream(base64, arena);
+            keep(bitStream);
+            arena.reset();
+        });
+        bench.run("base64/encode" + suffix, [&] {
+            std::string encoded = source.to_base64();
+            keep(encoded);
+        });
+        bench.run("bitstream/shift_left_3" + suffix, [&] {
+            BitStream bitStream(bytes.data(), size * 8);
+            bitStream.shift(3, false);
+            keep(bitStream);
+        });
+        bench.run("bitstream/shift_right_3" + suffix, [&] {
+            BitStream bitStream(bytes.data(), size * 8);
+            bitStream.shift(3, true);
+            keep(bitStream);
+        });
+    }
+
+    // Sync words at any bit position of 1 MiB of random bytes
+    std::vector<uint8_t> capture = randomBytes(random, 1 << 20);
+    BitStream captureStream = BitStream::view(capture.data(), capture.size() * 8);
+    std::vector<size_t> positions;
+    for (size_t bits : {16, 32}) {
+        const uint8_t sync[] = {0x1A, 0xCF, 0xFC, 0x1D};
+        bench.run("bitstream/search/1MiB_" + std::to_string(bits) + "b", [&] {
+            positions.clear();
+            captureStream.search(sync, bits, positions);
+            keep(positions);
+        });
+    }
+
+    // Field sized reads and appends, on a stream restarted when exhausted
+    std::vector<uint8_t> bytes = randomBytes(random, 4096);
+    for (size_t bits : {1, 13, 64}) {
+        std::string suffix = "/" + std::to_string(bits) + "b";
+        uint8_t field[8];
+        BitStream readStream = BitStream::view(bytes.data(), bytes.size() * 8);
+        bench.run("bitstream/read" + suffix, [&] {
+            readStream.read(bits, field);
+            keep(field);
+        });
+        BitStream consumeStream = BitStream::view(bytes.data(), bytes.size() * 8);
+        bench.run("bitstream/consume" + suffix, [&] {
+            if (consumeStream.getOffset() + bits > consumeStream.getCapacity()) {
+                consumeStream = BitStream::view(bytes.data(), bytes.size() * 8);
+            }
+            consumeStream.consume(bits, field);
+            keep(field);
+        });
+        Arena arena;
+        BitStream appendStream(arena);
+        bench.run("bitstream/append" + suffix, [&] {
+            if (appendStream.getCapacity() >= 4096 * 8) {
+                appendStream.clear();
+            }
+            appendStream.append(bytes.data(), bits);
+        });
+    }
+}
+
+// 1 MiB of base64 lines: the newlines looked for with findDelimiters, with
+// memchr (what FrameReader does) as the reference, and the frame index
+static void captureBenchmarks(Bench& bench, std::mt19937_64& random) {
+    for (size_t lineBytes : {12, 120}) {
+        std::string capture;
+        while (capture.size() < (1 << 20)) {
+            std::vector<uint8_t> bytes = randomBytes(random, lineBytes);
+            capture += BitStream(bytes.data(), lineBytes * 8).to_base64();
+            capture += '\n';
+        }
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(capture.data());
+        std::string suffix = "/1MiB_" + std::to_string(lineBytes) + "B_frames";
+
+        std::vector<uint64_t> positions;
+        bench.run("capture/find_delimiters" + suffix, [&] {
+            positions.clear();
+            findDelimiters(data, capture.size(), '\n', positions);
+            keep(positions);
+        });
+        bench.run("capture/memchr_lines" + suffix, [&] {
+            positions.clear();
+            for (const uint8_t* cursor = data; const void* newline = std::memchr(cursor, '\n', capture.size() - (cursor - data));) {
+                positions.push_back(static_cast<const uint8_t*>(newline) - data);
+                cursor = static_cast<const uint8_t*>(newline) + 1;
+            }
+            keep(positions);
+        });
+        bench.run("capture/index_base64" + suffix, [&] {
+            FrameIndex index{CaptureFormat()};
+            index.update(data, capture.size());
+            keep(index);
+        });
+    }
+}
+
+// Frames of a schema from the message generator, kept by size: up to four
+// sizes from the smallest to the largest generated
+static std::vector<std::vector<uint8_t>> findFrames(const Schema& schema, std::vector<size_t>& frameBits) {
+    std::map<size_t, std::vector<uint8_t>> bySize;
+    GeneratorOptions options;
+    options.seed = 42;
+    options.maxRepetitions = 16;
+    MessageGenerator generator(options);
+    if (generator.load(schema) == MessageGenerator::STATUS_OK) {
+        for (int i = 0; i < 1000; i++) {
+            BitStream bitStream;
+            generator.generate(bitStream);
+            bySize.emplace(bitStream.getCapacity(), std::vector<uint8_t>(bitStream.getBuffer(), bitStream.getBuffer() + bitStream.getByteLength()));
+        }
+    }
+    std::vector<std::vector<uint8_t>> frames;
+    if (bySize.empty()) {
+        return frames;
+    }
+    std::vector<std::pair<size_t, std::vector<uint8_t>>> sorted(bySize.begin(), bySize.end());
+    size_t picks = std::min<size_t>(4, sorted.size());
+    for (size_t i = 0; i < picks; i++) {
+        auto& [bits, bytes] = sorted[picks == 1 ? 0 : i * (sorted.size() - 1) / (picks - 1)];
+        frameBits.push_back(bits);
+        frames.push_back(bytes);
+    }
+    return frames;
+}
+
+static void schemaBenchmarks(Bench& bench, const std::string& catalogDirectory) {
+    namespace fs = std::filesystem;
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(catalogDirectory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    DecoderContext context;
+    for (const auto& file : files) {
+        std::string name = file.stem().string();
+        std::ifstream input(file);
+        nlohmann::json document = nlohmann::json::parse(input, nullptr, false);
+        if (!document.is_discarded()) {
+            // Published under its own name, not to replace the catalog schema
+            bench.run("schema/parse/" + name, [&] { SchemaCatalog::getInstance().parseSchema("bench_parse_" + name, document); });
+        }
+
+        auto id = SchemaCatalog::getInstance().resolve(name);
+        if (!id) {
+            continue;
+        }
+        auto schema = SchemaCatalog::getInstance().getSchema(id.value());
+        GeneratorOptions generatorOptions;
+        MessageGenerator generator(generatorOptions);
+        if (generator.load(*schema) == MessageGenerator::STATUS_OK) {
+            Arena arena;
+            bench.run("generate/" + name, [&] {
+                BitStream bitStream(arena);
+                generator.generate(bitStream);
+                keep(bitStream);
+                arena.reset();
+            });
+        }
+
+        std::vector<size_t> frameBits;
+        auto frames = findFrames(*schema, frameBits);
+        if (frames.empty()) {
+            std::printf("%-44s no valid frame found\n", ("decode/" + name).c_str());
+            continue;
+        }
+        for (size_t i = 0; i < frames.size(); i++) {
+            const auto& frame = frames[i];
+            size_t bits = frameBits[i];
+            std::string suffix = "/" + name + "/" + std::to_string(bits) + "b";
+            nlohmann::ordered_json decoded;
+            bench.run("decode" + suffix, [&] {
+                BitStream bitStream = BitStream::view(frame.data(), bits);
+                decoded.clear();
+                context.bitstream_to_json(id.value(), bitStream, decoded);
+            });
+
+            // The flattened fields, as the encode RPCs pass them
+            nlohmann::json fields = nlohmann::json::parse(decoded.dump());
+            Arena arena;
+            bench.run("encode" + suffix, [&] {
+                BitStream bitStream(arena);
+                context.json_to_bitstream(id.value(), fields, bitStream);
+                keep(bitStream);
+                arena.reset();
+            });
+        }
+    }
+}
+
+// Compares the results with a baseline, on the values it holds (ns/op in
+// the timings, allocations/op in the reference): the failures are printed
+static int compare(const std::vector<BenchResult>& results, const nlohmann::json& baseline, double threshold) {
+    int failures = 0;
+    const auto& benchmarks = baseline["benchmarks"];
+    for (const auto& result : results) {
+        if (!benchmarks.contains(result.name)) {
+            continue;
+        }
+        const auto& entry = benchmarks[result.name];
+        if (entry.contains("ns_per_op")) {
+            double baseNanos = entry.value("ns_per_op", 0.0);
+            double change = baseNanos > 0 ? 100.0 * (result.nanosPerOp - baseNanos) / baseNanos : 0;
+            if (change > threshold) {
+                std::printf("REGRESSION %-33s %10.1f ns/op against %.1f (%+.1f%%)\n", result.name.c_str(), result.nanosPerOp, baseNanos, change);
+                failures++;
+            }
+        }
+        if (entry.contains("allocs_per_op")) {
+            double baseAllocations = entry.value("allocs_per_op", 0.0);
+            if (result.allocationsPerOp > baseAllocations + 0.5) {
+                std::printf("REGRESSION %-33s %10.2f allocs/op against %.2f\n", result.name.c_str(), result.allocationsPerOp, baseAllocations);
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+static bool readBaseline(const std::string& path, nlohmann::json& baseline) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    baseline = nlohmann::json::parse(file, nullptr, false);
+    return !baseline.is_discarded() && baseline.contains("benchmarks");
+}
+
+static void writeBaseline(const std::string& path, const std::vector<BenchResult>& results, bool timings) {
+    nlohmann::json baseline;
+    for (const auto& result : results) {
+        if (timings) {
+            baseline["benchmarks"][result.name] = {{"ns_per_op", result.nanosPerOp}};
+        } else {
+            // Rounded: the amortized allocations of a container vary a little
+            // with the number of iterations
+            baseline["benchmarks"][result.name] = {{"allocs_per_op", std::round(result.allocationsPerOp * 100) / 100}};
+        }
+    }
+    std::ofstream output(path);
+    output << baseline.dump(2) << "\n";
+    std::printf("Baseline written to <%s>\n", path.c_str());
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr,
+                     "Usage: %s <catalog directory> [--baseline file] [--timings file] [--update] [--threshold percent] [--filter substring]\n"
+                     "       [--min-time seconds]\n",
+                     argv[0]);
+        return 1;
+    }
+    const std::string catalogDirectory = argv[1];
+    BenchOptions options;
+    std::string baselinePath;
+    std::string timingsPath;
+    bool update = false;
+    double threshold = 10;
+    for (int i = 2; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (argument == "--timings" && hasValue) {
+            timingsPath = argv[++i];
+        } else if (argument == "--update") {
+            update = true;
+        } else if (argument == "--threshold" && hasValue) {
+            threshold = std::stod(argv[++i]);
+        } else if (argument == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (argument == "--min-time" && hasValue) {
+            options.minTime = std::stod(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Unknown argument <%s>\n", argument.c_str());
+            return 1;
+        }
+    }
+
+    Logger::getInstance().setSeverity(Logger::Level::CRITICAL);
+    if (SchemaCatalog::getInstance().loadCatalog(catalogDirectory)) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", catalogDirectory.c_str());
+        return 1;
+    }
+
+    // Fixed seed: the same frames from one run to the next
+    std::mt19937_64 random(42);
+    Bench bench(options);
+    bitStreamBenchmarks(bench, random);
+    captureBenchmarks(bench, random);
+    schemaBenchmarks(bench, catalogDirectory);
+
+    int failures = 0;
+    if (!baselinePath.empty()) {
+        nlohmann::json baseline;
+        if (update) {
+            writeBaseline(baselinePath, bench.getResults(), false);
+        } else if (!readBaseline(baselinePath, baseline)) {
+            std::fprintf(stderr, "Missing or invalid baseline <%s> (written with --update)\n", baselinePath.c_str());
+            return 1;
+        } else {
+            int regressions = compare(bench.getResults(), baseline, threshold);
+            std::printf("%d allocation regressions against <%s>\n", regressions, baselinePath.c_str());
+            failures += regressions;
+        }
+    }
+    if (!timingsPath.empty()) {
+        nlohmann::json timings;
+        if (update || !std::filesystem::exists(timingsPath)) {
+            writeBaseline(timingsPath, bench.getResults(), true);
+        } else if (!readBaseline(timingsPath, timings)) {
+            std::fprintf(stderr, "Invalid timings <%s>\n", timingsPath.c_str());
+            return 1;
+        } else {
+            int regressions = compare(bench.getResults(), timings, threshold);
+            std::printf("%d regressions beyond %.1f%% against <%s>\n", regressions, threshold, timingsPath.c_str());
+            failures += regressions;
+        }
+    }
+    return failures ? 2 : 0;
+}
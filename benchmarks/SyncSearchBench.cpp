@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "opencmd.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Searches a buffer of random bytes (1 GB by default) for sync words of 16,
+// 24, 32 and 64 bits planted at random bit positions, with BitStream::search
+// and with a scalar reference (a 64 bits window per byte compared at the 8
+// alignments), and reports the throughput of both. The planted sync words
+// must all be found, and both searches must find the same occurrences.
+//
+// Usage: bench_sync_search [megabytes] [sync words per megabyte]
+
+namespace {
+
+    void writeBits(uint8_t* data, size_t position, uint64_t value, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            size_t bit = position + i;
+            uint8_t mask = static_cast<uint8_t>(0x80 >> (bit % 8));
+            if ((value >> (length - 1 - i)) & 1) {
+                data[bit / 8] |= mask;
+            } else {
+                data[bit / 8] &= static_cast<uint8_t>(~mask);
+            }
+        }
+    }
+
+    uint64_t loadWindow(const uint8_t* data, size_t size, size_t byte) {
+        uint64_t value = 0;
+        if (byte + 8 <= size) {
+            std::memcpy(&value, data + byte, sizeof(value));
+            return __builtin_bswap64(value);
+        }
+        for (size_t i = 0; i < 8; i++) {
+            value = value << 8 | (byte + i < size ? data[byte + i] : 0);
+        }
+        return value;
+    }
+
+    // Patterns of up to 57 bits
+    void searchScalar(const uint8_t* data, size_t size, uint64_t pattern, size_t length, std::vector<size_t>& positions) {
+        const uint64_t mask = ~uint64_t(0) << (64 - length);
+        const uint64_t word = pattern << (64 - length);
+        const size_t last = size * 8 - length;
+        for (size_t byte = 0; byte * 8 <= last; byte++) {
+            uint64_t window = loadWindow(data, size, byte);
+            for (unsigned shift = 0; shift < 8 && byte * 8 + shift <= last; shift++) {
+                if (((window << shift) & mask) == word) {
+                    positions.push_back(byte * 8 + shift);
+                }
+            }
+        }
+    }
+
+    double seconds(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const size_t megabytes = argc > 1 ? std::stoull(argv[1]) : 1024;
+    const size_t perMegabyte = argc > 2 ? std::stoull(argv[2]) : 16;
+    const size_t size = megabytes << 20;
+
+    std::mt19937_64 random(42);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t value = random();
+        std::memcpy(data.data() + i, &value, sizeof(value));
+    }
+    BitStream bitStream = BitStream::view(data.data(), size * 8);
+
+    struct Sync {
+        uint64_t word;
+        size_t length;
+    };
+    const Sync syncs[] = {{0xEB90, 16}, {0xFAF320, 24}, {0x1ACFFC1D, 32}, {0x0347763EB0001ABCULL, 64}};
+    int failures = 0;
+    for (const Sync& sync : syncs) {
+        // Planted at random positions, far enough from each other
+        std::vector<size_t> planted;
+        size_t count = megabytes * perMegabyte;
+        for (size_t i = 0; i < count; i++) {
+            size_t slot = size * 8 / count;
+            size_t position = i * slot + random() % (slot - sync.length);
+            writeBits(data.data(), position, sync.word, sync.length);
+            planted.push_back(position);
+        }
+        uint8_t pattern[8];
+        for (size_t i = 0; i < 8; i++) {
+            pattern[i] = static_cast<uint8_t>((sync.word << (64 - sync.length)) >> (56 - 8 * i));
+        }
+
+        std::vector<size_t> found;
+        double best = 1e9;
+        for (int run = 0; run < 3; run++) {
+            found.clear();
+            auto start = Clock::now();
+            bitStream.search(pattern, sync.length, found);
+            best = std::min(best, seconds(start));
+        }
+        bool complete = std::includes(found.begin(), found.end(), planted.begin(), planted.end());
+        std::printf("search %2zu bits  %8.3f s %8.2f GB/s %10zu found (%zu planted)%s\n", sync.length, best, size / best / 1e9, found.size(),
+                    planted.size(), complete ? "" : "  MISSING PLANTED");
+
+        if (sync.length <= 57) {
+            std::vector<size_t> reference;
+            auto start = Clock::now();
+            searchScalar(data.data(), size, sync.word, sync.length, reference);
+            double elapsed = seconds(start);
+            bool same = reference == found;
+            std::printf("scalar %2zu bits  %8.3f s %8.2f GB/s %10zu found%s  (search %.1fx)\n", sync.length, elapsed, size / elapsed / 1e9,
+                        reference.size(), same ? "" : "  DIFFERENT", elapsed / best);
+            failures += same ? 0 : 1;
+        }
+        failures += complete ? 0 : 1;
+    }
+    return failures ? 1 : 0;
+}
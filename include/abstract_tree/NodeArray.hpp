@@ -10,48 +10,65 @@ namespace opencmd {
         size_t repetitions = 0;
         std::string repetition_reference = " = ";
         bool is_absolute_reference = true;
+        // Pools of cloned children: they grow to the largest array seen and
+        // are reused by the following messages (<activeItems> in use)
         std::vector<std::shared_ptr<TreeNode>> items;
+        size_t activeItems = 0;
+        std::vector<std::shared_ptr<TreeNode>> encodeItems;
+        size_t activeEncodeItems = 0;
 
     private:
-        void prepareItems(const nlohmann::json& outputJson) {
-            items.clear();
+        // Evaluate the reference in case of not absolute value
+        std::string repetitionReferenceKey() const {
+            return is_absolute_reference ? repetition_reference : this->getFullName() + repetition_reference;
+        }
+
+        // True when the message gives the array no item: the decoder writes
+        // no key for it
+        bool isEmptyIn(const nlohmann::json& inputJson) const {
+            if (is_array_size_fixed) {
+                return repetitions == 0;
+            }
+            auto reference = inputJson.find(repetitionReferenceKey());
+            return reference != inputJson.end() && reference->is_number_integer() && reference->get<int64_t>() == 0;
+        }
+
+        void preparePool(std::vector<std::shared_ptr<TreeNode>>& pool, size_t count) {
+            for(size_t i = pool.size(); i < count; i++){
+                pool.emplace_back(this->getChildren()[i % this->getChildren().size()]->clone());
+            }
+        }
+
+        void prepareItems(const nlohmann::ordered_json& outputJson) {
+            activeItems = 0;
             size_t current_repetitions = repetitions;
 
             // If the size of the array depends on the value of another field
             // of the message, find it and align the repetitions attribute 
             if(!is_array_size_fixed){
 
-                std::string repetition_reference_key = repetition_reference;
-                
-                // Evaluate the reference in case of not absolute value
-                if(!is_absolute_reference){
-                    repetition_reference_key = this->getFullName() + repetition_reference;
-                }
+                std::string repetition_reference_key = repetitionReferenceKey();
 
                 // Check if the reference is present
                 if (!outputJson.contains(repetition_reference_key)) {
-                    Logger::getInstance().log("Missing repetition reference " + repetition_reference_key + " in the evaluated json", Logger::Level::ERROR);
-                    Logger::getInstance().log(outputJson.dump(), Logger::Level::ERROR);
+                    OPENCMD_REPORT_ERROR("Missing repetition reference",
+                                         "Missing repetition reference " + repetition_reference_key + " in the evaluated json: " + outputJson.dump());
                     return;
                 } 
 
                 // Get the value of the reference
-                auto value = outputJson[repetition_reference_key];
+                const auto& value = outputJson[repetition_reference_key];
                 
                 // Check the value is a valid integer
                 if (!value.is_number_integer()) {
-                    Logger::getInstance().log("Repetition reference value is not an integer", Logger::Level::ERROR);
+                    OPENCMD_REPORT_ERROR("Repetition reference not an integer", "Repetition reference value is not an integer");
                     return;
                 }
                 current_repetitions = value.get<int>();
             }
-            items.reserve(current_repetitions*this->getChildren().size());
-            // Create the array of elements to be used during the convertion
-            for(size_t i = 0; i < current_repetitions; i++){
-                for (auto& child : this->getChildren()) {
-                    items.emplace_back(child->clone());
-                }
-            }
+            // Prepare the array of elements to be used during the convertion
+            activeItems = current_repetitions*this->getChildren().size();
+            preparePool(items, activeItems);
         };
 
     public:
@@ -65,14 +82,7 @@ namespace opencmd {
                 is_array_size_fixed(other.is_array_size_fixed),
                 repetitions(other.repetitions),
                 repetition_reference(other.repetition_reference),
-                is_absolute_reference(other.is_absolute_reference) { 
-            items.reserve(other.items.size());
-            for (const auto& item : other.items) {
-                if (item) {
-                    items.emplace_back(item->clone());
-                }
-            }
-        }
+                is_absolute_reference(other.is_absolute_reference) {}
 
 /*         NodeArray& operator=(const NodeArray& other) {
             if (this != &other) {
@@ -121,28 +131,39 @@ namespace opencmd {
             }
         }
 
-        int getRepetitions() { return repetitions; }
+        int getRepetitions() const { return repetitions; }
+        bool isArraySizeFixed() const { return is_array_size_fixed; }
+        const std::string& getRepetitionReference() const { return repetition_reference; }
+        bool isAbsoluteReference() const { return is_absolute_reference; }
+
+        std::optional<size_t> getFixedBitLength() const override {
+            if (!is_array_size_fixed) {
+                return std::nullopt;
+            }
+            size_t itemLength = 0;
+            for (const auto& child : this->getChildren()) {
+                auto childLength = child->getFixedBitLength();
+                if (!childLength) {
+                    return std::nullopt;
+                }
+                itemLength += childLength.value();
+            }
+            return itemLength * repetitions;
+        }
 
         int bitstream_to_json(BitStream& bitStream, nlohmann::ordered_json& outputJson) override {
             prepareItems(outputJson);
-            std::string array_key_basename = std::string(this->getFullName()) + std::string("/"); 
-            int array_index = 0;
-            for (auto& item : items) {
+            std::string array_key_basename = this->getFullName() + "/"; 
+            for (size_t array_index = 0; array_index < activeItems; array_index++) {
+                auto& item = items[array_index];
                 // Evaluate the item
-                item->bitstream_to_json(bitStream, outputJson);
-                
-                // Prepare the a local json with the correct key (/array/n)
-                // and the value from the evaluated item
-                nlohmann::json j;
-                std::string array_key = array_key_basename + std::to_string(array_index);
-                j[array_key] = outputJson[item->getFullName()];
+                childToJson(*item, *this->getChildren()[array_index % this->getChildren().size()], bitStream, outputJson);
                 
-                // Remove the current item from the actual evaluated json 
+                // Move the value from the evaluated item to the correct
+                // key (/array/n), removing the item from the evaluated json 
+                auto value = std::move(outputJson[item->getFullName()]);
                 outputJson.erase(item->getFullName());
-
-                // Add the local json to the global json
-                outputJson.update(j);
-                array_index++;
+                outputJson[array_key_basename + std::to_string(array_index)] = std::move(value);
             }
             return 0;
         };
@@ -150,23 +171,25 @@ namespace opencmd {
         int json_to_bitstream(const nlohmann::json& inputJson, BitStream& bitStream) override {
             
             if(!inputJson.contains(this->getFullName()+"/0")){
-                Logger::getInstance().error("Key <"+this->getFullName()+"/0"+"> not found in the provided json object or the related value is not an array");
+                if (isEmptyIn(inputJson)) {
+                    activeEncodeItems = 0;
+                    return 0;
+                }
+                OPENCMD_REPORT_ERROR("Array key not found", "Key <"+this->getFullName()+"/0"+"> not found in the provided json object or the related value is not an array");
                 return 100;      
             }
-            items.clear();
+            activeEncodeItems = 0;
             for (auto& [key, val] : inputJson.items()){
                 if(key.rfind(this->getFullName(), 0) == 0){
-                    for (auto& child : this->getChildren()) {
-                        items.emplace_back(child->clone());
-                    }
+                    activeEncodeItems += this->getChildren().size();
                 }
             }
-            int index = 0;
-            for (auto& item : items) {
+            preparePool(encodeItems, activeEncodeItems);
+            for (size_t index = 0; index < activeEncodeItems; index++) {
+                auto& item = encodeItems[index];
                 item->setName(std::to_string(index));
                 item->setParentName(this->getFullName());
-                item->json_to_bitstream(inputJson, bitStream);
-                index++;
+                childToBitstream(*item, *this->getChildren()[index % this->getChildren().size()], inputJson, bitStream);
             }
             
             return 0;
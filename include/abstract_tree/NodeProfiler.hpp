@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../bitstream/BitStream.hpp"
+#include "../memory/ThreadSlots.hpp"
+
+namespace opencmd {
+
+    /* Sampling profiler of the tree evaluation.
+     *
+     * One message every <samplePeriod> (per thread) is profiled: each node
+     * evaluated records its calls, cycles and bits consumed (or appended)
+     * under its schema path, e.g. engine;decode;data;[item]. The other
+     * messages pay a thread local check per node. Every thread records in
+     * its own call tree, locked once per profiled message; the dumps merge
+     * the trees of all the threads.
+     *
+     * The cycles are TSC ticks on x86, nanoseconds elsewhere.
+     */
+    class NodeProfiler {
+    public:
+        enum class Operation { DECODE, ENCODE };
+
+        struct Frame {
+            std::string name;
+            uint64_t calls = 0;
+            uint64_t cycles = 0;
+            uint64_t bits = 0;
+            std::vector<std::unique_ptr<Frame>> children;
+            // Children are mostly evaluated in order: the search starts
+            // after the last one found
+            size_t nextChild = 0;
+
+            explicit Frame(std::string name) : name(std::move(name)) {}
+            Frame* child(const std::string& childName);
+        };
+
+        static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        // Bits read by a decode or written by an encode: the other term does
+        // not move during the evaluation
+        static size_t streamBits(const BitStream& bitStream) { return bitStream.getOffset() + bitStream.getCapacity(); }
+
+        // Evaluation of a node in a profiled message
+        class NodeScope {
+            Frame* parent;
+            Frame* frame;
+            const BitStream& bitStream;
+            size_t startBits;
+            uint64_t start;
+
+        public:
+            NodeScope(const std::string& name, const BitStream& bitStream)
+                : parent(currentFrame), frame(parent->child(name)), bitStream(bitStream), startBits(streamBits(bitStream)), start(cycles()) {
+                currentFrame = frame;
+            }
+            ~NodeScope() {
+                frame->calls++;
+                frame->cycles += cycles() - start;
+                frame->bits += streamBits(bitStream) - startBits;
+                currentFrame = parent;
+            }
+            NodeScope(const NodeScope&) = delete;
+            NodeScope& operator=(const NodeScope&) = delete;
+        };
+
+        // Profiled message of a schema, for the messages picked by sample()
+        class MessageScope {
+            std::unique_lock<std::mutex> lock;
+            Frame* frame;
+            const BitStream& bitStream;
+            size_t startBits;
+            uint64_t start;
+
+        public:
+            MessageScope(uint32_t schema, const std::string& schemaName, Operation operation, const BitStream& bitStream);
+            ~MessageScope();
+            MessageScope(const MessageScope&) = delete;
+            MessageScope& operator=(const MessageScope&) = delete;
+        };
+
+    private:
+        struct ThreadProfile {
+            // Held by the owner thread during a profiled message
+            std::mutex mutex;
+            std::map<std::pair<uint32_t, Operation>, std::unique_ptr<Frame>> roots;
+        };
+
+        static inline thread_local Frame* currentFrame = nullptr;
+        static inline thread_local uint32_t countdown = 0;
+        static inline std::atomic<uint32_t> samplePeriod{0};
+
+        ThreadSlots<ThreadProfile> profiles;
+
+        NodeProfiler() = default;
+        // Call trees of all the threads merged, per schema root
+        std::vector<std::unique_ptr<Frame>> merge();
+
+    public:
+        static NodeProfiler& getInstance();
+        NodeProfiler(const NodeProfiler&) = delete;
+        NodeProfiler& operator=(const NodeProfiler&) = delete;
+
+        // One message profiled every <period> per thread (0 = disabled)
+        void setSamplePeriod(uint32_t period) { samplePeriod.store(period, std::memory_order_relaxed); }
+        uint32_t getSamplePeriod() const { return samplePeriod.load(std::memory_order_relaxed); }
+
+        static bool isActive() { return currentFrame != nullptr; }
+
+        // True when the next message of the calling thread is to be profiled
+        static bool sample() {
+            uint32_t period = samplePeriod.load(std::memory_order_relaxed);
+            if (period == 0 || currentFrame) {
+                return false;
+            }
+            if (countdown == 0) {
+                countdown = period - 1;
+                return true;
+            }
+            countdown--;
+            return false;
+        }
+
+        // Folded stacks (one "frame;frame;... self_cycles" line per path),
+        // the input of flamegraph.pl and similar tools
+        std::string folded();
+        // Per schema table of the paths: calls, cycles and bits per call
+        std::string table();
+        void reset();
+    };
+
+}
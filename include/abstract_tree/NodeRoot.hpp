@@ -15,9 +15,21 @@ namespace opencmd {
             return std::make_unique<NodeRoot>(*this); 
         }
 
+        std::optional<size_t> getFixedBitLength() const override {
+            size_t total = 0;
+            for (const auto& child : this->getChildren()) {
+                auto childLength = child->getFixedBitLength();
+                if (!childLength) {
+                    return std::nullopt;
+                }
+                total += childLength.value();
+            }
+            return total;
+        }
+
         int bitstream_to_json(BitStream& bitStream, nlohmann::ordered_json& outputJson) override {
             for (auto& child : this->getChildren()) {
-                auto retVal = child->bitstream_to_json(bitStream, outputJson);
+                auto retVal = childToJson(*child, *child, bitStream, outputJson);
                 if(retVal){
                     return retVal;
                 }
@@ -27,7 +39,7 @@ namespace opencmd {
 
         int json_to_bitstream(const nlohmann::json& inputJson, BitStream& bitStream) override {
             for (auto& child : this->getChildren()) {
-                auto retVal = child->json_to_bitstream(inputJson, bitStream);
+                auto retVal = childToBitstream(*child, *child, inputJson, bitStream);
                 if(retVal){
                     return retVal;
                 }
@@ -48,7 +48,8 @@ namespace opencmd {
             } else if(key=="routing_table"){
                 if(attribute.isArray()) {
                     std::cout << attribute.to_string() << std::endl;
-                    for(auto item : attribute.getArray().value()){
+                    auto items = attribute.getArray().value();
+                    for(auto item : items){
                         std::cout << item.to_string() << std::endl;
                     }
                 } else {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "TreeNode.hpp"
 
 namespace opencmd {
@@ -13,8 +15,14 @@ namespace opencmd {
         };
 
     private:
+        // Values are handled as 64 bits integers, in local buffers
+        static constexpr size_t MAX_BIT_LENGTH = 64;
+
         size_t bitLength = 0;
         Endianness endianness = Endianness::BIG;
+        // Constant or enumerated field: the only values a valid message can
+        // carry (empty = any value). Used to detect the message type
+        std::vector<uint64_t> allowedValues;
 
     public:
         NodeUnsignedInteger() : TreeNode() {}
@@ -25,7 +33,8 @@ namespace opencmd {
 
         NodeUnsignedInteger(const NodeUnsignedInteger& other) : TreeNode(other), 
             bitLength(other.bitLength), 
-            endianness(other.endianness) {}
+            endianness(other.endianness),
+            allowedValues(other.allowedValues) {}
 
         virtual std::unique_ptr<TreeNode> clone() const override { 
             return std::make_unique<NodeUnsignedInteger>(*this); 
@@ -42,6 +51,9 @@ namespace opencmd {
                     if(bitLength<=0){
                         Logger::getInstance().log("Attribute <bit_length> is not valid (<=0)", Logger::Level::ERROR);
                         bitLength = 0;
+                    } else if(bitLength>MAX_BIT_LENGTH){
+                        Logger::getInstance().log("Attribute <bit_length> is not valid (>64)", Logger::Level::ERROR);
+                        bitLength = 0;
                     }
                 }
             } else if(key=="endianness"){
@@ -59,83 +71,126 @@ namespace opencmd {
                         Logger::getInstance().log("Attribute <endianness> is not valid ("+endianess_str+")", Logger::Level::ERROR);
                     }
                 }
+            } else if(key=="allowed_values"){
+                allowedValues.clear();
+                if(attribute.isInteger()){
+                    allowedValues.push_back(attribute.getInteger().value());
+                } else if(attribute.isArray()){
+                    auto values = attribute.getArray().value();
+                    for(const auto& item : values){
+                        if(!item.isInteger()){
+                            Logger::getInstance().log("Attribute <allowed_values> contains a value that is not an integer", Logger::Level::ERROR);
+                            allowedValues.clear();
+                            return;
+                        }
+                        allowedValues.push_back(item.getInteger().value());
+                    }
+                } else {
+                    Logger::getInstance().log("Attribute <allowed_values> is not an integer or an array of integers", Logger::Level::ERROR);
+                }
             }
         }
 
-        int bitstream_to_json(BitStream& bitStream, nlohmann::ordered_json& outputJson) override {
-            size_t numberOfBytes = bitLength + 7 >> 3;
-            auto buffer = bitStream.consume(bitLength);
+        size_t getBitLength() const { return bitLength; }
+        Endianness getEndianness() const { return endianness; }
+        const std::vector<uint64_t>& getAllowedValues() const { return allowedValues; }
+
+        std::optional<size_t> getFixedBitLength() const override { return bitLength; }
+
+        // Value of a field of <bitLength> bits, read (left aligned) in <buffer>
+        static std::optional<uint64_t> decodeValue(const uint8_t* buffer, size_t bitLength, Endianness endianness) {
+            size_t numberOfBytes = (bitLength + 7) >> 3;
             uint64_t result = 0;
             switch (endianness){
                 case Endianness::BIG:
                     for (size_t i = 0; i < numberOfBytes; ++i) {
-                        result |= buffer[i] << ((numberOfBytes - 1 - i) * 8);
+                        result |= static_cast<uint64_t>(buffer[i]) << ((numberOfBytes - 1 - i) * 8);
                     }
                     break;
                 case Endianness::LITTLE:
                     for (size_t i = 0; i < numberOfBytes; ++i) {
-                        result |= buffer[i] << (i * 8);
+                        result |= static_cast<uint64_t>(buffer[i]) << (i * 8);
                     }
                     break;
-                case Endianness::MIDDLE:
-                    Logger::getInstance().warning("Unsupported endianness: MIDDLE not (yet) implemented");
-                    return 100;
                 default:
-                    Logger::getInstance().warning("Unsupported endianness");
-                    return 100;
+                    return std::nullopt;
             }
 
             // Align to the right if the value is not a multiple of 8
-            int64_t value = 0;
             if (bitLength % 8) {
-                value = result >> (8 - (bitLength % 8));
-            } else {
-                value = result;
+                return result >> (8 - (bitLength % 8));
+            }
+            return result;
+        }
+
+        // Inverse of decodeValue: the <bitLength> bits of <value>, left
+        // aligned in <buffer>
+        static bool encodeValue(uint64_t value, size_t bitLength, Endianness endianness, uint8_t* buffer) {
+            size_t numberOfBytes = (bitLength + 7) >> 3;
+            uint64_t aligned = value << (numberOfBytes * 8 - bitLength);
+            switch (endianness){
+                case Endianness::BIG:
+                    for (size_t i = 0; i < numberOfBytes; ++i) {
+                        buffer[i] = static_cast<uint8_t>(aligned >> ((numberOfBytes - 1 - i) * 8));
+                    }
+                    return true;
+                case Endianness::LITTLE:
+                    for (size_t i = 0; i < numberOfBytes; ++i) {
+                        buffer[i] = static_cast<uint8_t>(aligned >> (i * 8));
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        int bitstream_to_json(BitStream& bitStream, nlohmann::ordered_json& outputJson) override {
+            uint8_t buffer[MAX_BIT_LENGTH / 8];
+            bitStream.consume(bitLength, buffer);
+            auto result = decodeValue(buffer, bitLength, endianness);
+            if (!result) {
+                if (endianness == Endianness::MIDDLE) {
+                    OPENCMD_REPORT_WARNING("Unsupported endianness", "Unsupported endianness: MIDDLE not (yet) implemented");
+                } else {
+                    OPENCMD_REPORT_WARNING("Unsupported endianness", "Unsupported endianness");
+                }
+                return 100;
+            }
+            int64_t value = result.value();
+
+            if (!allowedValues.empty() && std::find(allowedValues.begin(), allowedValues.end(), result.value()) == allowedValues.end()) {
+                OPENCMD_REPORT_ERROR("Value not allowed", "Value <" + std::to_string(result.value()) + "> of <" + this->getFullName() + "> is not one of the allowed values");
+                return 100;
             }
 
             // Prepare the json output
-            std::string key = this->getFullName();
-            outputJson[key] = value;
+            outputJson[this->getFullName()] = value;
 
             return 0;
         }
 
         int json_to_bitstream(const nlohmann::json& inputJson, BitStream& bitStream) override { 
             if(!inputJson.is_object()){
-                Logger::getInstance().error("The provided json is not an object");
+                OPENCMD_REPORT_ERROR("Json not an object", "The provided json is not an object");
                 return 100;
             }
             if(!inputJson.contains(this->getFullName()) || !inputJson[this->getFullName()].is_number_integer()){
-                Logger::getInstance().error("Key <"+this->getFullName()+"> not found in the provided json object or the related value is not an integer");
+                OPENCMD_REPORT_ERROR("Integer key not found", "Key <"+this->getFullName()+"> not found in the provided json object or the related value is not an integer");
                 return 100;      
             }
             uint64_t rawValue = inputJson[this->getFullName()];
-            uint64_t value = 0;
-            switch (endianness){
-                case Endianness::BIG:
-                    value = rawValue;
-/*                     for (int i = 0; i < sizeof(uint64_t); ++i) {
-                        value |= ((rawValue >> (i * 8)) & 0xFF) << ((7 - i) * 8);
-                    }
- */                    break;
-                case Endianness::LITTLE:
-                    // No convertion needed
-                    value = rawValue;
-                    break;
-                case Endianness::MIDDLE:
-                    Logger::getInstance().warning("Unsupported endianness: MIDDLE not (yet) implemented");
-                    return 100;
-                default:
-                    Logger::getInstance().warning("Unsupported endianness");
-                    return 100;
+            if (endianness == Endianness::MIDDLE) {
+                OPENCMD_REPORT_WARNING("Unsupported endianness", "Unsupported endianness: MIDDLE not (yet) implemented");
+                return 100;
+            }
+            uint8_t alignedBuffer[MAX_BIT_LENGTH / 8];
+            if (!encodeValue(rawValue, bitLength, endianness, alignedBuffer)) {
+                OPENCMD_REPORT_WARNING("Unsupported endianness", "Unsupported endianness");
+                return 100;
             }
-            Logger::getInstance().debug("Appending <"+this->getFullName()+"> with value <"+std::to_string(rawValue)+"> (bits <"+std::to_string(bitLength)+">)");
-     
-            uint8_t inputBuffer[(bitLength+7)/8];
-            std::memcpy(inputBuffer, &value, (bitLength+7)/8);
-            BitStream bsInteger(inputBuffer, bitLength);
-            bitStream.append(bsInteger);
-            Logger::getInstance().debug("Post <"+bitStream.to_string()+">");
+            OPENCMD_LOG_DEBUG("Appending <"+this->getFullName()+"> with value <"+std::to_string(rawValue)+"> (bits <"+std::to_string(bitLength)+">)");
+            bitStream.append(alignedBuffer, bitLength);
+            OPENCMD_LOG_DEBUG("Post <"+bitStream.to_string()+">");
             return 0;
         }
     };
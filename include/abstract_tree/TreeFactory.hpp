@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "TreeNode.hpp"
+#include "../memory/Arena.hpp"
 
 namespace opencmd {
 
@@ -21,19 +22,39 @@ namespace opencmd {
             creators[className] = []() -> std::unique_ptr<TreeNode> {
                 return std::make_unique<T>();
             };
+            arenaCreators[className] = [](Arena& arena) -> std::shared_ptr<TreeNode> {
+                return std::allocate_shared<T>(ArenaAllocator<T>(arena));
+            };
         }
 
         std::unique_ptr<TreeNode> create(const std::string& className) {
-            if (creators.find(className) != creators.end()) {
-                return creators[className]();
+            auto it = creators.find(className);
+            if (it != creators.end()) {
+                auto node = it->second();
+                node->setType(className);
+                return node;
             }
             Logger::getInstance().log("Failed to create class for classname <" + className + ">", Logger::Level::ERROR);
             return nullptr;
             
         }
 
+        // Same as create, with the node (and its reference count) allocated
+        // in the provided arena: used for the immutable schema trees
+        std::shared_ptr<TreeNode> create(const std::string& className, Arena& arena) {
+            auto it = arenaCreators.find(className);
+            if (it != arenaCreators.end()) {
+                auto node = it->second(arena);
+                node->setType(className);
+                return node;
+            }
+            Logger::getInstance().log("Failed to create class for classname <" + className + ">", Logger::Level::ERROR);
+            return nullptr;
+        }
+
     private:
         std::unordered_map<std::string, std::function<std::unique_ptr<TreeNode>()>> creators;
+        std::unordered_map<std::string, std::function<std::shared_ptr<TreeNode>(Arena&)>> arenaCreators;
 
     private:
         TreeFactory() = default;
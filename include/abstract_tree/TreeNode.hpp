@@ -6,7 +6,9 @@
 #include <nlohmann/json.hpp>
 #include "../bitstream/BitStream.hpp"
 #include "../logger/Logger.hpp"
+#include "../logger/ErrorReporter.hpp"
 #include "TreeNodeAttribute.hpp"
+#include "NodeProfiler.hpp"
 
 
 namespace opencmd {
@@ -14,16 +16,18 @@ namespace opencmd {
     class TreeNode {
 
     private:
+        std::string type;
         std::string name;
         std::string parentName;
+        std::string fullName;
         std::map<std::string, TreeNodeAttribute> attributeMap;
         std::vector<std::shared_ptr<TreeNode>> children;
 
     public:
 
-        TreeNode() : name(""), parentName("") {}
-        TreeNode(std::string name, std::string parentName) : name(name), parentName(parentName) {}
-        TreeNode(const TreeNode& other) : name(other.name), parentName(other.parentName) { 
+        TreeNode() : name(""), parentName(""), fullName("") {}
+        TreeNode(std::string name, std::string parentName) : name(name), parentName(parentName), fullName(parentName + name) {}
+        TreeNode(const TreeNode& other) : type(other.type), name(other.name), parentName(other.parentName), fullName(other.fullName) { 
             for(auto it = other.attributeMap.begin(); it != other.attributeMap.end(); ++it){
                 attributeMap[it->first] = it->second;
             }
@@ -37,6 +41,7 @@ namespace opencmd {
 
         TreeNode& operator=(const TreeNode& other) {
             if (this != &other) {
+                this->setType(other.getType());
                 this->setName(other.getName());
                 this->setParentName(other.getParentName());
                 attributeMap.clear();
@@ -58,9 +63,11 @@ namespace opencmd {
 
         virtual ~TreeNode() = default;
         
+        const std::string getType() const { return type; }
         const std::string getName() const { return name; }
         const std::string getParentName() const { return parentName; }
-        const std::string getFullName() const { return parentName + name;}
+        // Cached, it is used as key for every evaluated field
+        const std::string& getFullName() const { return fullName; }
         const std::map<std::string, TreeNodeAttribute>& getAttributeMap() const { return attributeMap; }
         std::optional<TreeNodeAttribute> getAttribute(const std::string& key) const {
             auto it = attributeMap.find(key);
@@ -70,12 +77,17 @@ namespace opencmd {
             return std::nullopt;
         }
         
-        void setName(std::string name) { this->name = name; }
+        void setType(std::string type) { this->type = type; }
+        void setName(std::string name) { 
+            this->name = name; 
+            this->fullName = this->parentName + this->name;
+        }
         void setParentName(std::string parentName) { 
             if (!parentName.empty() && parentName.back() != '/') {
                 parentName += '/';
             }
             this->parentName = parentName; 
+            this->fullName = this->parentName + this->name;
         }
 
         virtual void addAttribute(const std::string& key, const TreeNodeAttribute& attribute) {
@@ -90,9 +102,39 @@ namespace opencmd {
             children.push_back(child); 
         }
 
+        // Number of bits of the node when it does not depend on the message
+        // content (nullopt for variable length nodes)
+        virtual std::optional<size_t> getFixedBitLength() const { return std::nullopt; }
+
         virtual int json_to_bitstream(const nlohmann::json&, BitStream&) = 0; //{ return 0; };
         virtual int bitstream_to_json(BitStream&, nlohmann::ordered_json&) = 0; //{ return 0; };
 
+    protected:
+        // Evaluation of a child node, attributed to the schema path of
+        // <schemaNode> (the template of an array item) when the message is
+        // profiled
+        static int childToJson(TreeNode& child, const TreeNode& schemaNode, BitStream& bitStream, nlohmann::ordered_json& outputJson) {
+            if (!NodeProfiler::isActive()) {
+                return child.bitstream_to_json(bitStream, outputJson);
+            }
+            NodeProfiler::NodeScope scope(schemaNode.profileName(), bitStream);
+            return child.bitstream_to_json(bitStream, outputJson);
+        }
+        static int childToBitstream(TreeNode& child, const TreeNode& schemaNode, const nlohmann::json& inputJson, BitStream& bitStream) {
+            if (!NodeProfiler::isActive()) {
+                return child.json_to_bitstream(inputJson, bitStream);
+            }
+            NodeProfiler::NodeScope scope(schemaNode.profileName(), bitStream);
+            return child.json_to_bitstream(inputJson, bitStream);
+        }
+        // Anonymous nodes are the items of the arrays
+        const std::string& profileName() const {
+            static const std::string item = "[item]";
+            return name.empty() ? item : name;
+        }
+
+    public:
+
         virtual std::string to_string(size_t indent = 0) const { 
             std::ostringstream oss;
             std::string indentStr(indent, ' ');
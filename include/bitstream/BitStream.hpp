@@ -7,48 +7,113 @@
 #include <stdexcept>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <sstream>
 #include <iomanip>
 
 
+#include "../memory/Arena.hpp"
+
 namespace opencmd {
     class BitStream {
     private:
-        std::unique_ptr<uint8_t[]> buffer; 
-        size_t capacity;                   
-        size_t offset;                     
+        // The bits live in <buffer>, which is either owned (heap), carved out
+        // of an Arena (released with the arena), borrowed from the caller
+        // (read only view, copied on the first modification) or not yet
+        // allocated.
+        // <bufferSize> is the allocated size in bytes, possibly larger than
+        // the bytes used by <capacity> bits, so that appends grow
+        // geometrically and a cleared stream can be refilled without
+        // allocating again
+        std::unique_ptr<uint8_t[]> ownedBuffer;
+        uint8_t* buffer = nullptr;
+        size_t bufferSize = 0;
+        size_t capacity = 0;                   
+        size_t offset = 0;                     
+        Arena* arena = nullptr;
+        bool borrowed = false;
 
         void copyBits(uint8_t*, size_t, const uint8_t*, size_t, size_t) const;
+        void reserveBytes(size_t);
+        void detach();
 
     public:
 
-        BitStream() : capacity(0), offset(0), buffer(nullptr) {}
+        BitStream() = default;
+        explicit BitStream(Arena& arena) : arena(&arena) {}
         BitStream(const uint8_t*, size_t);
-        BitStream(const std::string&);
+        // Base64 input; <lengthInBits> trims the decoded bytes to the exact
+        // length of the message (0 = all the decoded bits)
+        BitStream(const std::string&, size_t lengthInBits = 0);
+        BitStream(const std::string&, Arena&, size_t lengthInBits = 0);
+
+        // Read only view over <lengthInBits> bits already in the stream
+        // layout (e.g. a payload owned by a protobuf message): nothing is
+        // copied unless the stream is modified. The data must outlive the view
+        static BitStream view(const uint8_t*, size_t lengthInBits);
+
+        BitStream(BitStream&&) noexcept;
+        BitStream& operator=(BitStream&&) noexcept;
+        BitStream(const BitStream&) = delete;
+        BitStream& operator=(const BitStream&) = delete;
 
         void set(const uint8_t*, size_t);
+        void clear() { capacity = 0; offset = 0; }
 
         std::unique_ptr<uint8_t[]> read(size_t) const;
+        void read(size_t, uint8_t*) const;
+
+        // Random access read at an absolute bit position, the offset is not
+        // affected (e.g. to inspect a message before decoding it)
+        void peek(size_t, size_t, uint8_t*) const;
 
         std::unique_ptr<uint8_t[]> consume(size_t);
+        void consume(size_t, uint8_t*);
 
         void append(const BitStream&);
+        void append(const uint8_t*, size_t);
 
+        // Shifts the bytes of the stream as one little endian integer (byte
+        // 0 the least significant), left or right: the bits shifted out are
+        // lost, the capacity does not change
         int shift(const size_t, const bool);
 
+        // Bit positions, from the start of the stream, of every occurrence of
+        // the <patternLength> bits of <pattern> (stream layout) starting in
+        // [from, to), overlapping ones included: sync words or preambles of a
+        // capture that is not byte aligned. Patterns of 16 bits or more are
+        // looked for 32 bytes at a time, comparing the data with the pattern
+        // shifted to each of the 8 bit alignments (AVX2, or 16 bytes with
+        // SSE2), and every candidate is verified
+        void search(const uint8_t* pattern, size_t patternLength, std::vector<size_t>& positions, size_t from = 0, size_t to = SIZE_MAX) const;
+        std::vector<size_t> search(const uint8_t* pattern, size_t patternLength, size_t from = 0, size_t to = SIZE_MAX) const;
+
         std::string to_string() const;
 
         std::string to_base64() const { 
-            return base64_encode(this->buffer.get(), (this->capacity + 7) / 8);
+            return base64_encode(this->buffer, (this->capacity + 7) / 8);
         };
 
         size_t getCapacity() const { return capacity; }
+        size_t getByteLength() const { return (capacity + 7) / 8; }
+        const uint8_t* getBuffer() const { return buffer; }
         void reduceCapacity(const size_t);
         size_t getOffset() const { return offset;}
+
+        // Converts <lengthInBits> bits stored as a little endian integer
+        // (right aligned) into the left aligned layout used by BitStream
+        static void toStreamLayout(const uint8_t*, size_t, uint8_t*);
+
+        // Base64 text decoded in place of the caller (e.g. a line of a
+        // mapped file): <output> holds base64_decoded_length bytes.
+        // std::invalid_argument on an invalid length or character
+        static size_t base64_decoded_length(std::string_view);
+        static void base64_decode(std::string_view, uint8_t*, size_t);
         
     private:
 
-        static std::string to_string(const std::unique_ptr<uint8_t[]>&, size_t);
+        static std::string to_string(const uint8_t*, size_t);
         
         static constexpr uint8_t INVALID_CHAR = 0xFF;
         static constexpr uint8_t base64_lookup[256] = {
@@ -73,7 +138,7 @@ namespace opencmd {
             INVALID_CHAR, INVALID_CHAR, INVALID_CHAR, INVALID_CHAR, INVALID_CHAR, INVALID_CHAR, INVALID_CHAR, INVALID_CHAR
         };
         static constexpr char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-        static size_t base64_decode(const std::string&, std::unique_ptr<uint8_t[]>&);
+        static size_t exactLength(size_t, size_t);
         static std::string base64_encode(const uint8_t*, size_t);
     };
 }
\ No newline at end of file
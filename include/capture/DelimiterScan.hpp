@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opencmd {
+
+    // Appends to <positions> the offset of every <delimiter> byte of [data,
+    // data + size), in order. One pass over the data, 32 or 16 bytes per
+    // comparison (AVX2 when the CPU has it, SSE2 otherwise on x86-64)
+    void findDelimiters(const uint8_t* data, size_t size, uint8_t delimiter, std::vector<uint64_t>& positions);
+
+}
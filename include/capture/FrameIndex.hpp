@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "FrameReader.hpp"
+
+namespace opencmd {
+
+    /* Sidecar index of the frames of a capture file.
+     *
+     * One entry per valid frame: its offset in the capture, its length in
+     * bits and, when built with classification, the schema the catalog
+     * detects for it; candump logs also keep the timestamp of every frame.
+     * With the index a frame, or the frames of an offset or time range, is
+     * found by a binary search, and a range is split in chunks on exact
+     * frame boundaries without reading the capture.
+     *
+     * The index remembers how many bytes of the capture it covers (up to
+     * the end of the last complete frame) and a checksum of the last of
+     * them: update() on a capture that was appended to scans the new bytes
+     * only, and starts over when the covered bytes changed. Line formats
+     * are scanned for newlines with SIMD comparisons (findDelimiters), the
+     * lengths of the base64 frames following from the lengths of the lines.
+     * SYNC captures, whose frames are not byte aligned, are not indexed.
+     *
+     * Layout (host endianness, like SchemaSnapshot), rewritten as a whole
+     * through a temporary file:
+     *
+     *   [ magic "OCMDFIDX" ][ format version ][ capture format ]
+     *   [ frame size ][ indexed bytes ][ checksum of the indexed tail ]
+     *   [ frame count ][ schema count ][ flags ]
+     *   [ entries ][ timestamps (candump) ][ schema names ]
+     *   [ FNV-1a checksum of all the above ]
+     */
+    class FrameIndex {
+    public:
+        static constexpr uint32_t FORMAT_VERSION = 1;
+        static constexpr int STATUS_OK = 0;
+        static constexpr int ERROR_OPEN = 1;
+        // Not an index of this capture format, or corrupted
+        static constexpr int ERROR_INVALID_INDEX = 2;
+        static constexpr int ERROR_WRITE = 3;
+        // Frames not classified, or without a single candidate schema
+        static constexpr uint16_t NO_SCHEMA = 0;
+
+        struct Entry {
+            uint64_t offset;
+            uint32_t bitLength;
+            // 1 + index in the schema names, or NO_SCHEMA
+            uint16_t schema;
+            uint16_t reserved;
+        };
+
+    private:
+        CaptureFormat format;
+        bool classified = false;
+        std::vector<Entry> entries;
+        // CANDUMP: microseconds since the epoch, one per entry (a line
+        // without one has the timestamp of the line before it)
+        std::vector<int64_t> timestamps;
+        std::vector<std::string> schemaNames;
+        std::unordered_map<std::string, uint16_t> schemaNumbers;
+        uint64_t indexedBytes = 0;
+        uint64_t tailChecksum = 0;
+        // Where the last update started scanning (0 when it indexed again)
+        uint64_t scanStart = 0;
+
+        void clear();
+        void add(const CaptureFrame& frame, uint64_t bitLength, const uint8_t* bits);
+        uint16_t schemaNumber(const std::string& name);
+        size_t scanLines(const uint8_t* data, size_t size);
+        size_t scanLengthPrefixed(const uint8_t* data, size_t size);
+        size_t scanRaw(const uint8_t* data, size_t size);
+        static uint64_t checksumTail(const uint8_t* data, size_t end);
+
+    public:
+        FrameIndex() = default;
+        explicit FrameIndex(const CaptureFormat& format, bool classify = false) : format(format), classified(classify) {}
+
+        // Indexes the frames of <data> not indexed yet; returns the number
+        // of malformed frames skipped
+        size_t update(const uint8_t* data, size_t size);
+
+        // Reads an index of a capture in <format> (ERROR_INVALID_INDEX for
+        // another format), classified or not
+        int read(const std::string& path, const CaptureFormat& format);
+        int write(const std::string& path) const;
+
+        size_t size() const { return entries.size(); }
+        const Entry& operator[](size_t frame) const { return entries[frame]; }
+        int64_t getTimestamp(size_t frame) const { return timestamps.empty() ? 0 : timestamps[frame]; }
+        // Empty for NO_SCHEMA
+        std::string_view getSchemaName(const Entry& entry) const;
+        uint64_t getIndexedBytes() const { return indexedBytes; }
+        uint64_t getScanStart() const { return scanStart; }
+        const CaptureFormat& getFormat() const { return format; }
+        bool isClassified() const { return classified; }
+
+        // First frame at or after <offset> / <microseconds> (the frames of a
+        // candump log in time order), size() when none
+        size_t findOffset(uint64_t offset) const;
+        size_t findTime(int64_t microseconds) const;
+        // Offset just past the frame (or past the malformed lines after it)
+        uint64_t frameEnd(size_t frame) const;
+        // Offsets of the chunks of about <chunkBytes> bytes covering the
+        // frames [first, last): {offset of first, ..., end of last - 1}
+        std::vector<size_t> chunkBoundaries(size_t first, size_t last, size_t chunkBytes) const;
+
+        // "1436509052.249713" in microseconds (0 when not a timestamp)
+        static int64_t parseTimestamp(std::string_view text);
+    };
+
+}
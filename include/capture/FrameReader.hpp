@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace opencmd {
+
+    struct CaptureFormat {
+        enum class Type {
+            // Frames of <frameSize> bytes back to back
+            RAW,
+            // 32 bits little endian bit length, then the bytes of the frame
+            // (as written by opencmd_generate)
+            LENGTH_PREFIXED,
+            // One base64 frame per line
+            BASE64_LINES,
+            // candump log lines: "(1436509052.249713) can0 123#DEADBEEF",
+            // "can0 123##1DEADBEEF" (CAN FD) or "can0 123 [4] DE AD BE EF"
+            CANDUMP,
+            // A bit stream not byte aligned (e.g. a link layer capture):
+            // every frame starts with a sync word, at any bit position
+            SYNC
+        };
+
+        Type type = Type::BASE64_LINES;
+        // RAW only
+        size_t frameSize = 0;
+        // SYNC only: the sync word (stream layout) and its length; frames of
+        // <frameBits> bits, or up to the next sync word when 0, that start
+        // after the sync word (at it with <keepSync>)
+        std::vector<uint8_t> syncWord;
+        size_t syncBits = 0;
+        size_t frameBits = 0;
+        bool keepSync = false;
+
+        // "raw", "length-prefixed", "base64", "candump" or "sync"
+        static std::optional<Type> parse(const std::string&);
+        // "<hex digits>[/<bits>]" (e.g. "1ACFFC1D", "7E/8"), the bits being
+        // the first ones of the digits (all of them by default)
+        bool parseSyncWord(const std::string&);
+    };
+
+    struct CaptureFrame {
+        // The frame in the stream layout: points into the file for the
+        // binary formats, into the reader for the text ones (valid until the
+        // next frame is read)
+        const uint8_t* data = nullptr;
+        size_t bitLength = 0;
+        // Position of the frame (its prefix, or its line) in the file; in
+        // bits for SYNC (the position of its sync word)
+        size_t offset = 0;
+        // CANDUMP only: the text of the log (timestamp empty when absent)
+        std::string_view timestamp;
+        std::string_view interface;
+        uint32_t canId = 0;
+    };
+
+    /* Frames of a range of a capture file, in file order.
+     *
+     * A range must start on a frame: chunkBoundaries splits a file in ranges
+     * of about the same size that do, so that the chunks of a file can be
+     * read in parallel. A malformed frame is reported as such and skipped
+     * (its line, for the text formats); in the binary formats the framing
+     * is lost after it, and the range ends there. Frames without any bit
+     * (e.g. CAN remote requests) are malformed too: there is nothing to
+     * decode.
+     *
+     * SYNC frames are the ones whose sync word starts in the range; a frame
+     * may continue past the range, up to <limit> (the end of the data).
+     * The sync words are looked for with BitStream::search, a window of
+     * the data at a time, and the frames are copied byte aligned.
+     */
+    class FrameReader {
+    public:
+        static constexpr int STATUS_OK = 0;
+        static constexpr int END_OF_RANGE = 1;
+        static constexpr int ERROR_INVALID_FRAME = 400;
+
+    private:
+        static constexpr size_t NO_SYNC = SIZE_MAX;
+
+        const uint8_t* data;
+        size_t position;
+        size_t end;
+        size_t limit;
+        CaptureFormat format;
+        // Bytes of the frames of the text formats (and of SYNC)
+        std::vector<uint8_t> payload;
+        // SYNC: the sync words found in [bitPosition, syncSearched), the next
+        // one at <syncCursor>
+        size_t bitPosition;
+        size_t syncSearched;
+        size_t syncCursor = 0;
+        std::vector<size_t> syncPositions;
+
+        int nextRaw(CaptureFrame&);
+        int nextLengthPrefixed(CaptureFrame&);
+        int nextLine(CaptureFrame&);
+        int parseBase64(std::string_view line, CaptureFrame&);
+        int parseCandump(std::string_view line, CaptureFrame&);
+        int nextSync(CaptureFrame&);
+        size_t findSync(size_t from);
+        int locateSync(size_t& sync, size_t& bitStart, size_t& bitEnd);
+
+    public:
+        // <limit>: the end of the data, for the SYNC frames that continue
+        // past <end> (0 = end)
+        FrameReader(const uint8_t* data, size_t begin, size_t end, const CaptureFormat& format, size_t limit = 0);
+
+        int next(CaptureFrame& frame);
+        size_t getPosition() const { return position; }
+
+        // Offsets of the chunks of about <chunkBytes> bytes of a file, each
+        // starting on a frame: {0, ..., size}
+        static std::vector<size_t> chunkBoundaries(const uint8_t* data, size_t size, size_t chunkBytes, const CaptureFormat& format);
+    };
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace opencmd {
+
+    /* Read only mapping of a whole file.
+     *
+     * The pages are loaded by the kernel as they are read and can be
+     * dropped again under memory pressure, so a capture larger than the
+     * memory is processed without reading it into buffers. An empty file is
+     * a valid mapping of 0 bytes.
+     */
+    class MappedFile {
+    public:
+        static constexpr int STATUS_OK = 0;
+        static constexpr int ERROR_OPEN = 1;
+        static constexpr int ERROR_MAP = 2;
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        int open(const std::string& path);
+        void close();
+        // Drops the pages of [begin, end) from the memory of the process,
+        // once read (they are loaded again if read later)
+        void release(size_t begin, size_t end) const;
+
+        const uint8_t* getData() const { return data; }
+        size_t getSize() const { return size; }
+    };
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace opencmd {
+
+    /* Watches the catalog directory (inotify) and triggers a reload of the
+     * SchemaCatalog when a schema file is written, moved or deleted.
+     * Bursts of events (e.g. a rollout copying many files) are coalesced:
+     * the reload happens once the directory has been quiet for the
+     * debounce interval.
+     */
+    class CatalogWatcher {
+    private:
+        std::string directory;
+        std::chrono::milliseconds debounce;
+        std::atomic<bool> running{false};
+        std::thread watcherThread;
+        int inotifyFd = -1;
+
+        void run();
+
+    public:
+        CatalogWatcher(const std::string& directory, std::chrono::milliseconds debounce = std::chrono::milliseconds(200)) 
+            : directory(directory), debounce(debounce) {}
+        ~CatalogWatcher() { stop(); }
+        CatalogWatcher(const CatalogWatcher&) = delete;
+        CatalogWatcher& operator=(const CatalogWatcher&) = delete;
+
+        int start();
+        void stop();
+    };
+
+}
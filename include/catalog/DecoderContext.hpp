@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "PathTable.hpp"
+#include "SchemaCatalog.hpp"
+
+namespace opencmd {
+
+    /* Per thread (or per stream) evaluation context.
+     *
+     * Requests address schemas through their SchemaId: the context keeps one
+     * evaluation tree per schema, cloned from the catalog the first time the
+     * schema is used and reused for the following messages. A tree is cloned
+     * again only when a catalog reload replaced the schema.
+     * A context is not thread-safe: each worker owns its own.
+     */
+    class DecoderContext {
+    public:
+        static constexpr int ERROR_UNKNOWN_SCHEMA = 404;
+
+    private:
+        struct CachedTree {
+            uint64_t generation = 0;
+            std::shared_ptr<const Schema> schema;
+            std::unique_ptr<TreeNode> tree;
+            // Built on first use, with the tree
+            std::unique_ptr<PathTable> pathTable;
+        };
+        std::vector<CachedTree> trees;
+
+    public:
+        DecoderContext() = default;
+        DecoderContext(const DecoderContext&) = delete;
+        DecoderContext& operator=(const DecoderContext&) = delete;
+
+        TreeNode* acquireTree(SchemaId id);
+        const PathTable* acquirePathTable(SchemaId id);
+
+        int bitstream_to_json(SchemaId id, BitStream& bitStream, nlohmann::ordered_json& outputJson);
+        int json_to_bitstream(SchemaId id, const nlohmann::json& inputJson, BitStream& bitStream);
+    };
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_tree/NodeUnsignedInteger.hpp"
+#include "Schema.hpp"
+
+namespace opencmd {
+
+    /* Index used to detect the schema of a raw message.
+     *
+     * Every schema contributes the unsigned integer fields that have
+     * <allowed_values> and sit at a fixed bit offset (all the preceding
+     * fields have a fixed length). The index keeps one table per distinct
+     * field (offset, length, endianness), mapping each value to the bitset
+     * of the schemas that allow it, next to the bitset of the schemas not
+     * constraining the field. A message is classified by reading every
+     * field once and intersecting the bitsets, so a message costs one lookup
+     * per field instead of a trial decode with every schema, and the index
+     * grows with the number of constraints, not with their combinations.
+     *
+     * At most MAX_KEYS fields and MAX_ENTRIES values are indexed, the fields
+     * constraining more schemas first: the constraints left out are not
+     * checked, which only widens the candidates returned.
+     */
+    class DiscriminatorIndex {
+    public:
+        struct FieldKey {
+            size_t bitOffset = 0;
+            size_t bitLength = 0;
+            NodeUnsignedInteger::Endianness endianness = NodeUnsignedInteger::Endianness::BIG;
+
+            bool operator==(const FieldKey& other) const {
+                return bitOffset == other.bitOffset && bitLength == other.bitLength && endianness == other.endianness;
+            }
+        };
+
+        static constexpr size_t MAX_KEYS = 256;
+        static constexpr size_t MAX_ENTRIES = 65536;
+
+    private:
+        // One bit per schema, in the order the candidates are returned
+        using SchemaSet = std::vector<uint64_t>;
+
+        struct KeyTable {
+            FieldKey key;
+            std::unordered_map<uint64_t, SchemaSet> allowed;
+            SchemaSet unconstrained;
+        };
+
+        struct Constraint {
+            FieldKey key;
+            std::vector<uint64_t> values;
+        };
+
+        struct SchemaConstraints {
+            SchemaId id;
+            std::vector<Constraint> constraints;
+        };
+
+        std::vector<KeyTable> tables;
+        std::vector<SchemaId> schemaOrder;
+
+        static void collectConstraints(const TreeNode&, SchemaConstraints&);
+
+    public:
+        DiscriminatorIndex() = default;
+
+        static DiscriminatorIndex build(const std::vector<std::shared_ptr<const Schema>>& schemasById);
+
+        // Candidate schemas for the message (empty when no schema matches,
+        // more than one when the discriminating fields do not tell them apart)
+        std::vector<SchemaId> classify(const BitStream& bitStream) const;
+
+        bool empty() const { return schemaOrder.empty(); }
+
+        size_t keyCount() const { return tables.size(); }
+    };
+
+}
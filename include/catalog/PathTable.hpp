@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../abstract_tree/NodeArray.hpp"
+#include "../abstract_tree/NodeUnsignedInteger.hpp"
+
+namespace opencmd {
+
+    /* Numeric ids of the field paths of a schema.
+     *
+     * The paths are the keys of the flattened decoded message, with each
+     * array position replaced by a "*" segment (e.g. "/data/3" becomes
+     * "/data/" followed by "*"): a decoded field is then identified by a
+     * path id plus the array indices it was found at.
+     * Ids start at 1, in the order of the fields in the schema. <version>
+     * is a hash of the paths, so that a client can tell whether the table
+     * it fetched still applies.
+     * The table also keeps which paths are unsigned integers: the decoded
+     * JSON holds them as signed numbers.
+     */
+    class PathTable {
+    public:
+        static constexpr uint32_t NO_PATH = 0;
+
+    private:
+        std::vector<std::string> paths;
+        std::unordered_map<std::string, uint32_t> ids;
+        // Indexed by path id
+        std::vector<bool> unsignedPaths{false};
+        uint64_t version = 0;
+
+        void collect(const TreeNode&, const std::string& arrayPrefix);
+        void add(const std::string&, const TreeNode&);
+
+    public:
+        PathTable() = default;
+
+        static PathTable build(const TreeNode& root);
+
+        // Id of a flattened key, filling <indices> with its array positions
+        // (NO_PATH when the key has no template in the table)
+        uint32_t lookup(const std::string& key, std::string& templateBuffer, std::vector<uint32_t>& indices) const;
+
+        const std::vector<std::string>& getPaths() const { return paths; }
+        bool isUnsigned(uint32_t id) const { return id < unsignedPaths.size() && unsignedPaths[id]; }
+        uint64_t getVersion() const { return version; }
+    };
+
+}
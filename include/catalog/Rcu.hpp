@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace opencmd {
+
+    /* Epoch based read-copy-update domain.
+     *
+     * Every reader thread owns a slot where it announces the epoch it
+     * entered its read-side section in (0 = not reading). Readers never
+     * block: entering and leaving a section are two atomic stores.
+     * Writers publish a new version, advance the global epoch and wait
+     * until no reader is still inside a section started before the
+     * advance, then the old version can be released.
+     */
+    class RcuDomain {
+    public:
+        static constexpr size_t MAX_READERS = 1024;
+
+        static RcuDomain& getInstance();
+
+        void readLock();
+        void readUnlock();
+        void synchronize();
+
+    private:
+        struct alignas(64) ReaderSlot {
+            std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> used{false};
+        };
+
+        std::atomic<uint64_t> globalEpoch{1};
+        ReaderSlot slots[MAX_READERS];
+
+        RcuDomain() = default;
+        RcuDomain(const RcuDomain&) = delete;
+        RcuDomain& operator=(const RcuDomain&) = delete;
+
+        ReaderSlot* claimSlot();
+        friend struct RcuThreadState;
+    };
+
+    template <typename T>
+    class RcuPointer {
+    public:
+        class ReadGuard {
+        private:
+            const T* pointer;
+
+        public:
+            explicit ReadGuard(const std::atomic<const T*>& current) {
+                RcuDomain::getInstance().readLock();
+                pointer = current.load(std::memory_order_seq_cst);
+            }
+            ~ReadGuard() { RcuDomain::getInstance().readUnlock(); }
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator=(const ReadGuard&) = delete;
+
+            const T* get() const { return pointer; }
+            const T* operator->() const { return pointer; }
+            const T& operator*() const { return *pointer; }
+        };
+
+    private:
+        std::atomic<const T*> current;
+        std::mutex writerMutex;
+
+    public:
+        explicit RcuPointer(std::unique_ptr<T> initial = std::make_unique<T>()) : current(initial.release()) {}
+        ~RcuPointer() { delete current.load(); }
+        RcuPointer(const RcuPointer&) = delete;
+        RcuPointer& operator=(const RcuPointer&) = delete;
+
+        ReadGuard read() const { return ReadGuard(current); }
+
+        // Writers are serialized among themselves only; the update function
+        // receives the current version and returns the one to be published
+        template <typename F>
+        void update(F&& makeNext) {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            std::unique_ptr<T> next = makeNext(*current.load());
+            const T* previous = current.exchange(next.release(), std::memory_order_seq_cst);
+            RcuDomain::getInstance().synchronize();
+            delete previous;
+        }
+    };
+
+}
@@ -5,18 +5,56 @@
 #include <fstream>
 
 #include "SchemaElement.hpp"
+#include "../abstract_tree/NodeRoot.hpp"
+#include "../memory/Arena.hpp"
 
 namespace opencmd {
+
+    // Stable numeric handle of a schema: resolved once from the schema name,
+    // it never changes (nor is reused) across catalog reloads
+    using SchemaId = uint32_t;
+    static constexpr SchemaId INVALID_SCHEMA_ID = 0;
+
     class Schema {
     private:
+        SchemaId id = INVALID_SCHEMA_ID;
         std::string catalogName;
         std::string version;
         std::map<std::string, std::string> metadata;
         //std::vector<SchemaElement> structure;
 
     public:
+        // The nodes of the abstract tree are allocated in the arena, which
+        // must then outlive the tree: it is declared before it (destroyed
+        // after it) and the assignments release the tree first
+        std::shared_ptr<Arena> arena;
         std::shared_ptr<NodeRoot> abstractTree;
         Schema() = default;
+        Schema(const Schema&) = default;
+        Schema(Schema&&) = default;
+        Schema& operator=(const Schema& other) {
+            if (this != &other) {
+                this->abstractTree = other.abstractTree;
+                this->arena = other.arena;
+                this->id = other.id;
+                this->catalogName = other.catalogName;
+                this->version = other.version;
+                this->metadata = other.metadata;
+            }
+            return *this;
+        }
+        Schema& operator=(Schema&& other) {
+            if (this != &other) {
+                this->abstractTree = std::move(other.abstractTree);
+                this->arena = std::move(other.arena);
+                this->id = other.id;
+                this->catalogName = std::move(other.catalogName);
+                this->version = std::move(other.version);
+                this->metadata = std::move(other.metadata);
+            }
+            return *this;
+        }
+        SchemaId getId() const { return this->id; }
         const std::string getCatalogName() const { return this->catalogName; }
         const std::string getVersion() const { return this->version; }
         const std::map<std::string, std::string> getMetadata() const { return this->metadata; }
@@ -25,6 +63,7 @@ namespace opencmd {
         //const std::vector<SchemaElement>& getStructure() const { return this->structure; }
         //std::vector<SchemaElement>& getStructureForUpdate() { return this->structure; }
         
+        void setId(SchemaId id){ this->id = id;}
         void setCatalogName(const std::string& name){ this->catalogName = name;}
         void setVersion(const std::string& version){ this->version = version;}
         void setMetadata(const std::map<std::string, std::string>& metadata){ this->metadata = metadata;}
@@ -13,12 +13,39 @@
 #include "../abstract_tree/NodeArray.hpp"
 #include "../abstract_tree/NodeUnsignedInteger.hpp"
 #include "Schema.hpp"
+#include "SchemaSnapshot.hpp"
+#include "Rcu.hpp"
+#include "DiscriminatorIndex.hpp"
 
 namespace opencmd {
 
     class SchemaCatalog {
+    public:
+        using SchemaMap = std::unordered_map<std::string, std::shared_ptr<const Schema>>;
+
+        // One immutable version of the catalog: schemas by name and by id
+        struct CatalogVersion {
+            SchemaMap schemas;
+            std::vector<std::shared_ptr<const Schema>> schemasById;
+            DiscriminatorIndex discriminatorIndex;
+        };
+
     private:
-        std::unordered_map<std::string, Schema> schemaMap;
+        // Readers (request handlers) never lock: they access the current
+        // version of the catalog through a RCU read-side section, while
+        // loads and reloads publish a new version atomically
+        RcuPointer<CatalogVersion> catalogVersion;
+        std::atomic<uint64_t> generation{0};
+
+        // Schema ids are assigned once per name and never reused
+        std::mutex idMutex;
+        std::unordered_map<std::string, SchemaId> assignedIds;
+
+        // Serializes loads/reloads and protects the reload parameters
+        std::mutex loadMutex;
+        std::string catalogDirectory;
+        std::string catalogSnapshotPath;
+        size_t catalogThreads = 0;
 
     public:
 
@@ -28,7 +55,14 @@ namespace opencmd {
         }
 
         int parseSchema(const std::string&, const nlohmann::json&);
+        int loadCatalog(const std::string& directory, const std::string& snapshotPath = "", size_t threads = 0);
+        int reload();
+        std::optional<SchemaId> resolve(const std::string& key) const;
+        std::shared_ptr<const Schema> getSchema(const std::string& key) const;
+        std::shared_ptr<const Schema> getSchema(SchemaId id) const;
+        std::vector<SchemaId> classify(const BitStream& bitStream) const;
         std::shared_ptr<TreeNode> cloneAbstractTree(const std::string& key) const;
+        uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
         std::string to_string(const SchemaElement::SchemaElementArray&);
 
     private:
@@ -42,9 +76,15 @@ namespace opencmd {
         };
         SchemaCatalog& operator=(const SchemaCatalog&) = delete;
 
-        std::optional<std::shared_ptr<TreeNode>> evalArray(const nlohmann::json&);
-        std::optional<std::shared_ptr<TreeNode>> evalObject(const nlohmann::json&);
-        std::optional<std::shared_ptr<TreeNodeAttribute>> evalAttribute(const nlohmann::json&);
+        int compileSchema(const std::string&, const nlohmann::json&, Schema&);
+        int loadCatalogLocked();
+        SchemaId assignId(const std::string&);
+        void publish(std::function<void(SchemaMap&)>);
+        static std::string fingerprint(const std::vector<std::string>&);
+
+        std::optional<std::shared_ptr<TreeNode>> evalArray(const nlohmann::json&, Arena&);
+        std::optional<std::shared_ptr<TreeNode>> evalObject(const nlohmann::json&, Arena&);
+        std::optional<TreeNodeAttribute> evalAttribute(const nlohmann::json&);
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../abstract_tree/TreeFactory.hpp"
+#include "../abstract_tree/NodeRoot.hpp"
+#include "Schema.hpp"
+
+namespace opencmd {
+
+    /* Binary snapshot of a compiled catalog.
+     *
+     * The snapshot stores, for every schema, the already evaluated abstract
+     * tree (node types, names, attributes and children) so that a warm
+     * restart can rebuild the catalog without parsing any JSON file.
+     *
+     * Layout (host endianness, the file is a local cache and not meant to
+     * be moved across architectures):
+     *
+     *   [ magic "OCMDSNAP" ][ format version ][ reserved ]
+     *   [ payload size (64 bits) ][ FNV-1a checksum of the payload (64 bits) ]
+     *   [ payload ... ]
+     *
+     * The payload starts with the fingerprint of the catalog directory the
+     * snapshot was built from: a snapshot whose fingerprint does not match
+     * the current directory content is considered stale and rejected.
+     */
+    class SchemaSnapshot {
+    public:
+        static constexpr uint32_t FORMAT_VERSION = 1;
+
+        static int write(const std::string& path, const std::string& fingerprint, const std::vector<Schema>& schemas);
+        static int read(const std::string& path, const std::string& fingerprint, std::vector<Schema>& schemas);
+
+        static uint64_t checksum(const uint8_t* data, size_t length);
+
+    private:
+        SchemaSnapshot() = delete;
+    };
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "TaskPool.hpp"
+
+namespace opencmd {
+
+    /* Chunks processed in parallel on a TaskPool, consumed in order.
+     *
+     * At most <window> chunks are in flight: the calling thread waits for
+     * the oldest one, hands its result to the consumer and only then
+     * submits the next chunk, so the memory held by the results is bounded
+     * whatever the number of chunks, while the workers keep busy as long as
+     * the consumer is faster than them. Each chunk gets a fresh <Result>.
+     */
+    template <typename Result>
+    class OrderedPipeline {
+    public:
+        using ProcessFunction = std::function<void(TaskPool::Context&, size_t chunk, Result&)>;
+        using ConsumeFunction = std::function<void(size_t chunk, Result&)>;
+
+    private:
+        struct Slot {
+            TaskGroup group;
+            Result result;
+        };
+
+        TaskPool& pool;
+        size_t window;
+
+    public:
+        OrderedPipeline(TaskPool& pool, size_t window) : pool(pool), window(std::max<size_t>(window, 1)) {}
+
+        // Processes the chunks [0, chunks): <consume> runs on the calling
+        // thread, in chunk order
+        void run(size_t chunks, const ProcessFunction& process, const ConsumeFunction& consume) {
+            std::vector<std::unique_ptr<Slot>> slots(std::min(window, chunks));
+            for (auto& slot : slots) {
+                slot = std::make_unique<Slot>();
+            }
+            auto submit = [&](size_t chunk) {
+                Slot* slot = slots[chunk % slots.size()].get();
+                slot->result = Result();
+                pool.submit([&process, slot, chunk](TaskPool::Context& context) { process(context, chunk, slot->result); }, &slot->group);
+            };
+
+            size_t submitted = 0;
+            for (; submitted < slots.size(); submitted++) {
+                submit(submitted);
+            }
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                Slot& slot = *slots[chunk % slots.size()];
+                pool.wait(slot.group);
+                consume(chunk, slot.result);
+                if (submitted < chunks) {
+                    submit(submitted++);
+                }
+            }
+        }
+    };
+
+}
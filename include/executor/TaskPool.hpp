@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../catalog/DecoderContext.hpp"
+#include "../memory/Arena.hpp"
+#include "ThreadPinning.hpp"
+#include "WorkStealingDeque.hpp"
+
+namespace opencmd {
+
+    struct TaskPoolOptions {
+        // Worker threads (0 = one per core)
+        size_t threads = 0;
+        PinningPolicy pinning = PinningPolicy::NONE;
+    };
+
+    // Tasks submitted together, to be waited for as a whole
+    class TaskGroup {
+        friend class TaskPool;
+        std::atomic<size_t> pending{0};
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+
+        void done();
+
+    public:
+        // Tasks expected before the group is done (counted by the pool for
+        // the tasks pushed with the group)
+        void add(size_t count) { pending.fetch_add(count, std::memory_order_relaxed); }
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    /* Work stealing pool of decode workers.
+     *
+     * Every worker owns a deque: the tasks it spawns (e.g. the halves of a
+     * range being split) go to its own deque and are taken back LIFO, while
+     * idle workers steal the oldest tasks of the others. Tasks submitted by
+     * threads outside the pool go through a shared injection queue. Each
+     * worker also owns a Context, handed to the tasks it runs, with its
+     * scratch arena and its decoder context: tasks use them without
+     * synchronization. Idle workers sleep until new tasks are submitted.
+     */
+    class TaskPool {
+    public:
+        struct Context {
+            size_t index = 0;
+            Arena scratch;
+            DecoderContext decoder;
+        };
+        using Function = std::function<void(Context&)>;
+        using RangeFunction = std::function<void(Context&, size_t begin, size_t end)>;
+
+        class Task {
+        public:
+            TaskGroup* group = nullptr;
+            virtual ~Task() = default;
+            virtual void run(TaskPool&, Context&) = 0;
+        };
+
+    private:
+        struct Worker {
+            TaskPool* pool;
+            Context context;
+            WorkStealingDeque<Task> deque;
+            std::thread thread;
+        };
+        // Worker running on the calling thread (nullptr outside the pools)
+        static thread_local Worker* currentWorker;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::mutex injectedMutex;
+        std::deque<Task*> injected;
+        std::atomic<size_t> injectedCount{0};
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        std::atomic<size_t> sleepers{0};
+        std::atomic<bool> stopping{false};
+
+        void work(Worker&);
+        Task* findTask(Worker*, uint64_t& seed);
+        bool hasTasks();
+        void execute(Task*, Context&);
+        void wake();
+
+    public:
+        explicit TaskPool(const TaskPoolOptions& options = TaskPoolOptions());
+        // Runs the tasks already submitted, then stops the workers
+        ~TaskPool();
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+
+        // Queues a task, on the deque of the calling worker when called from
+        // the pool
+        void push(Task*);
+        void submit(Function function, TaskGroup* group = nullptr);
+        // Waits for the tasks of <group>: a worker of the pool runs tasks in
+        // the meantime, any other thread sleeps
+        void wait(TaskGroup& group);
+        // Calls <function> over [0, count), split in ranges of about <grain>
+        // items spread across the workers, and waits for all of them
+        void parallelFor(size_t count, size_t grain, const RangeFunction& function);
+        // Same without waiting: the ranges are added to <group>, and
+        // <function> must outlive them
+        void parallelFor(size_t count, size_t grain, const RangeFunction& function, TaskGroup& group);
+
+        size_t size() const { return workers.size(); }
+        // Context of the calling thread when it is a worker of a pool
+        static Context* currentContext();
+    };
+
+    // One T per worker of a pool, created the first time the worker uses it
+    template <typename T>
+    class WorkerLocal {
+        std::vector<std::unique_ptr<T>> slots;
+
+    public:
+        explicit WorkerLocal(const TaskPool& pool) : slots(pool.size()) {}
+
+        T& get(TaskPool::Context& context) {
+            auto& slot = slots[context.index];
+            if (!slot) {
+                slot = std::make_unique<T>();
+            }
+            return *slot;
+        }
+    };
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <pthread.h>
+#include <vector>
+
+namespace opencmd {
+
+    enum class PinningPolicy {
+        // Threads run wherever the scheduler puts them
+        NONE,
+        // Thread i runs on the i-th CPU the process is allowed to use
+        CORE,
+        // Thread i runs on the CPUs of the i-th NUMA node (round robin), so
+        // that its memory stays local to the node
+        NUMA_NODE
+    };
+
+    // CPUs the process is allowed to run on, grouped by NUMA node (a single
+    // group when the topology is not available)
+    std::vector<std::vector<int>> cpuTopology();
+
+    // Restricts <thread> according to <policy> for the thread of rank
+    // <index>; 0 on success (and always with PinningPolicy::NONE)
+    int pinThread(pthread_t thread, PinningPolicy policy, size_t index);
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace opencmd {
+
+    /* Chase-Lev work stealing deque of T pointers.
+     *
+     * The owner thread pushes and pops at the bottom (LIFO, the most recent
+     * and cache hot work first), the other threads steal from the top
+     * (FIFO, the oldest and usually largest pieces of work). Only the race
+     * on the last element goes through a CAS. The buffer grows when full;
+     * the buffers it replaces are kept until the deque is destroyed, since
+     * a thief may still be reading from them.
+     */
+    template <typename T>
+    class WorkStealingDeque {
+    private:
+        struct Buffer {
+            int64_t mask;
+            std::unique_ptr<std::atomic<T*>[]> slots;
+
+            explicit Buffer(int64_t capacity) : mask(capacity - 1), slots(new std::atomic<T*>[capacity]) {}
+            int64_t capacity() const { return mask + 1; }
+            T* get(int64_t index) const { return slots[index & mask].load(std::memory_order_relaxed); }
+            void put(int64_t index, T* item) { slots[index & mask].store(item, std::memory_order_relaxed); }
+        };
+
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Buffer*> buffer;
+        // Owner only: the current buffer and the ones it replaced
+        std::vector<std::unique_ptr<Buffer>> buffers;
+
+        Buffer* grow(Buffer* current, int64_t t, int64_t b) {
+            buffers.push_back(std::make_unique<Buffer>(current->capacity() * 2));
+            Buffer* grown = buffers.back().get();
+            for (int64_t i = t; i < b; i++) {
+                grown->put(i, current->get(i));
+            }
+            buffer.store(grown, std::memory_order_release);
+            return grown;
+        }
+
+    public:
+        // <capacity> must be a power of two
+        explicit WorkStealingDeque(int64_t capacity = 256) {
+            buffers.push_back(std::make_unique<Buffer>(capacity));
+            buffer.store(buffers.back().get(), std::memory_order_relaxed);
+        }
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        // Owner only
+        void push(T* item) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            Buffer* current = buffer.load(std::memory_order_relaxed);
+            if (b - t > current->capacity() - 1) {
+                current = grow(current, t, b);
+            }
+            current->put(b, item);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        // Owner only: nullptr when empty
+        T* pop() {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Buffer* current = buffer.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T* item = current->get(b);
+            if (t == b) {
+                // Last element: raced against the thieves
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        // Any thread: nullptr when empty or when another thread won the
+        // element
+        T* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            T* item = buffer.load(std::memory_order_acquire)->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return item;
+        }
+
+        bool empty() const {
+            return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+        }
+    };
+
+}
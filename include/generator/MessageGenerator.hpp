@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../abstract_tree/NodeUnsignedInteger.hpp"
+#include "../bitstream/BitStream.hpp"
+#include "../catalog/Schema.hpp"
+
+namespace opencmd {
+
+    struct GeneratorOptions {
+        enum class Distribution {
+            // Every value of a field equally likely
+            UNIFORM,
+            // Half of the values on the bounds of the field (min, min + 1,
+            // max - 1, max), the others uniform
+            BOUNDARY
+        };
+
+        uint64_t seed = 1;
+        Distribution distribution = Distribution::UNIFORM;
+        // Items of the arrays sized by a reference field, within the values
+        // the reference field can hold
+        uint64_t minRepetitions = 0;
+        uint64_t maxRepetitions = 8;
+        // Inclusive value range per field path (e.g. "/identifier"), for the
+        // fields without allowed values
+        std::map<std::string, std::pair<uint64_t, uint64_t>> ranges;
+    };
+
+    /* Random valid messages of a schema, with their decoded fields.
+     *
+     * The tree of the schema is compiled once into a flat list of fields and
+     * arrays; a message is then a walk of that list drawing each value from
+     * a seeded generator, so the same seed gives the same messages. Values
+     * respect the bit lengths and the allowed values, and the fields used as
+     * repetition references are drawn first within the repetitions range, so
+     * that the arrays they size are generated accordingly. Routers consume no
+     * bits in the decoder and generate none.
+     *
+     * The fields are the flattened JSON returned by the decoder (keys are
+     * the field paths, the array items are numbered).
+     */
+    class MessageGenerator {
+    public:
+        static constexpr int STATUS_OK = 0;
+        static constexpr int ERROR_UNSUPPORTED_SCHEMA = 1;
+
+    private:
+        struct Field {
+            std::string path;
+            size_t bitLength;
+            NodeUnsignedInteger::Endianness endianness;
+            std::vector<uint64_t> allowedValues;
+            uint64_t min;
+            uint64_t max;
+            // Template of an array item
+            bool item = false;
+            // Sizes an array: drawn within the repetitions range
+            bool repetitionReference = false;
+        };
+        // A field, or an array followed by the steps of its item templates
+        struct Step {
+            enum class Kind { FIELD, ARRAY };
+            Kind kind;
+            // FIELD: the field; ARRAY: the reference field (or NO_FIELD)
+            size_t field;
+            // ARRAY only
+            uint64_t repetitions = 0;
+            size_t itemsPerRepetition = 0;
+            std::string itemPrefix;
+        };
+        static constexpr size_t NO_FIELD = static_cast<size_t>(-1);
+
+        GeneratorOptions options;
+        uint64_t state;
+        std::vector<Field> fields;
+        std::vector<Step> steps;
+        // Per message: last value drawn per field (for the references)
+        std::vector<uint64_t> values;
+        // Per message: the bytes written, and the bits not yet in a byte
+        std::vector<uint8_t> frame;
+        uint64_t pending = 0;
+        size_t pendingBits = 0;
+        size_t frameBits = 0;
+
+        uint64_t next();
+        uint64_t draw(const Field& field);
+        uint64_t drawRepetitions(const Field& field);
+        int compile(const TreeNode& node);
+        int compileField(const TreeNode& node);
+        // Writes <value> as the decoder reads it, returns the decoded value
+        uint64_t writeField(const Field& field, uint64_t value);
+        void writeBits(uint64_t bits, size_t length);
+
+    public:
+        explicit MessageGenerator(const GeneratorOptions& options = GeneratorOptions());
+
+        // Compiles the tree of <schema>: ERROR_UNSUPPORTED_SCHEMA for nested
+        // arrays or references to fields inside an array
+        int load(const Schema& schema);
+        int load(const TreeNode& root);
+
+        // Appends a random message to <bitStream>, and its decoded fields to
+        // <output> when not null
+        void generate(BitStream& bitStream, nlohmann::ordered_json* output = nullptr);
+
+        void reseed(uint64_t seed) { state = seed; }
+    };
+
+}
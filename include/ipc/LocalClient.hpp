@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "LocalProtocol.hpp"
+#include "ShmRing.hpp"
+
+namespace opencmd {
+
+    /* Producer side of the shared memory transport (see LocalProtocol.hpp).
+     *
+     * send() and receive() are lock free as long as the rings are neither
+     * full nor empty, and may be called from two different threads (one
+     * sending, one receiving). Results come back in the order of the
+     * requests: a producer sending from the same thread it receives from
+     * must bound the messages in flight, or both rings fill up and the two
+     * sides wait for each other.
+     */
+    class LocalClient {
+    public:
+        struct Result {
+            uint64_t tag;
+            int status;
+            // JSON document (status 0) or error message, valid until the
+            // next receive
+            std::string_view text;
+        };
+
+    private:
+        int socket = -1;
+        // Reader and writer doorbells of the request and response rings
+        int bells[4] = {-1, -1, -1, -1};
+        void* memory = nullptr;
+        size_t memorySize = 0;
+        ShmRing requests;
+        ShmRing responses;
+        uint64_t nextTag = 0;
+        bool holdingResult = false;
+
+    public:
+        LocalClient() = default;
+        ~LocalClient() { close(); }
+        LocalClient(const LocalClient&) = delete;
+        LocalClient& operator=(const LocalClient&) = delete;
+
+        // Connects to the unix socket of a LocalIngest; 0 on success
+        int connect(const std::string& socketPath);
+        void close();
+        bool isConnected() const { return socket >= 0; }
+
+        // Queues the decoding of <bitLength> bits of <data> with the schema
+        // <schemaId> (as returned by resolveSchema), waiting up to
+        // <timeoutMs> while the request ring is full (< 0 waits forever).
+        // The tag given to the message is stored in <tag>. Empty messages
+        // are refused (false, nothing queued)
+        bool send(uint32_t schemaId, const uint8_t* data, size_t bitLength, uint64_t* tag = nullptr, int timeoutMs = -1);
+        // Next result, waiting up to <timeoutMs> for it; false on timeout or
+        // when the server went away
+        bool receive(Result& result, int timeoutMs = -1);
+    };
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace opencmd {
+
+    /* Wire format of the shared memory transport between co-located
+     * producers and openCMD.
+     *
+     * A producer connects to the unix socket of the server, which answers
+     * with a LocalHandshake and five descriptors passed with SCM_RIGHTS: the
+     * shared memory (a memfd holding the request ring followed by the
+     * response ring), then the reader and writer doorbells of the request
+     * ring and those of the response ring. The socket then stays open only
+     * to tell each side that the other one went away.
+     */
+    static constexpr uint32_t LOCAL_PROTOCOL_MAGIC = 0x4F434D44;  // "OCMD"
+    static constexpr uint32_t LOCAL_PROTOCOL_VERSION = 1;
+    static constexpr size_t LOCAL_HANDSHAKE_DESCRIPTORS = 5;
+
+    struct LocalHandshake {
+        uint32_t magic;
+        uint32_t version;
+        // Capacities of the two rings, laid out one after the other in the
+        // shared memory (ShmRing::regionSize bytes each)
+        uint64_t requestCapacity;
+        uint64_t responseCapacity;
+    };
+
+    // Request record: followed by the (bitLength + 7) / 8 bytes of the message
+    struct LocalDecodeRequest {
+        uint64_t tag;
+        uint32_t schemaId;
+        uint32_t bitLength;
+    };
+
+    // Response record, in the order of the requests: followed by <length>
+    // bytes, the JSON document of the message when status is 0 and an error
+    // message otherwise
+    struct LocalDecodeResult {
+        uint64_t tag;
+        int32_t status;
+        uint32_t length;
+    };
+
+    // Descriptor passing over a unix socket: <count> descriptors along with
+    // <size> bytes of <data>. Both return 0 on success, -1 on failure
+    int sendDescriptors(int socket, const void* data, size_t size, const int* descriptors, size_t count);
+    int receiveDescriptors(int socket, void* data, size_t size, int* descriptors, size_t count);
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace opencmd {
+
+    /* Eventfds of a ring: the consumer sleeps on <reader> and the producer
+     * on <writer>, each side ringing the bell of the other one. <peer> is the
+     * connection with the other process (e.g. the unix socket used for the
+     * handshake), watched while sleeping to detect that it went away.
+     */
+    struct Doorbells {
+        int reader = -1;
+        int writer = -1;
+        int peer = -1;
+    };
+
+    /* Single producer / single consumer ring of variable size records,
+     * living in memory shared by two processes.
+     *
+     * The producer reserves a contiguous record, fills it and commits it;
+     * the consumer peeks the oldest record and releases it once done (the
+     * record can be used in place until then). Positions are published with
+     * release/acquire atomics, so the fast path takes no lock and no system
+     * call: a doorbell is rung only when the other side declared it is
+     * going to sleep (the waiting flags in the header).
+     *
+     * Records are 8 byte aligned and never wrap: a record not fitting before
+     * the end of the buffer is placed at its beginning, after a skip marker.
+     */
+    class ShmRing {
+    public:
+        static constexpr uint32_t MAGIC = 0x4F434D52;  // "OCMR"
+        static constexpr size_t RECORD_HEADER_SIZE = 8;
+
+        struct alignas(64) Header {
+            uint32_t magic;
+            uint32_t reserved;
+            uint64_t capacity;
+            // Written by the consumer
+            alignas(64) std::atomic<uint64_t> head;
+            std::atomic<uint32_t> readerWaiting;
+            // Written by the producer
+            alignas(64) std::atomic<uint64_t> tail;
+            std::atomic<uint32_t> writerWaiting;
+        };
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+    private:
+        static constexpr uint32_t SKIP_MARKER = 0xFFFFFFFF;
+
+        Header* header = nullptr;
+        uint8_t* buffer = nullptr;
+        uint64_t mask = 0;
+        Doorbells bells;
+
+        // Producer side: next position to write, last head seen and the
+        // position the pending reservation starts at (after a skip marker)
+        uint64_t writePosition = 0;
+        uint64_t cachedHead = 0;
+        uint64_t reservedPosition = 0;
+        // Consumer side: next position to read, last tail seen and the size
+        // of the record returned by peek
+        uint64_t readPosition = 0;
+        uint64_t cachedTail = 0;
+        uint64_t peekedSize = 0;
+
+        static uint64_t recordSize(size_t payloadSize) { return (RECORD_HEADER_SIZE + payloadSize + 7) & ~uint64_t(7); }
+        void ring(int bell);
+        bool sleep(int bell, std::atomic<uint32_t>& waitingFlag, bool (ShmRing::*ready)(size_t), size_t size, int timeoutMs);
+        bool readable(size_t);
+        bool writable(size_t size);
+
+    public:
+        // Bytes of shared memory needed by a ring of <capacity> bytes (a
+        // power of two)
+        static size_t regionSize(size_t capacity) { return sizeof(Header) + capacity; }
+        // Formats the ring at <memory>, to be done once before any endpoint
+        // is attached
+        static void initialize(void* memory, size_t capacity);
+
+        ShmRing() = default;
+        // Attaches to a ring formatted in <memory> (<size> bytes mapped)
+        ShmRing(void* memory, size_t size, const Doorbells& bells);
+        ShmRing(const ShmRing&) = delete;
+        ShmRing& operator=(const ShmRing&) = delete;
+        ShmRing(ShmRing&&) = default;
+        ShmRing& operator=(ShmRing&&) = default;
+
+        bool isValid() const { return header != nullptr; }
+        // Largest payload a record can carry
+        size_t maxPayloadSize() const { return mask ? (mask + 1) / 2 - RECORD_HEADER_SIZE : 0; }
+
+        // Producer: space for a payload of <size> bytes (nullptr when the ring
+        // is full), published by commit
+        uint8_t* reserve(size_t size);
+        void commit(size_t size);
+        // Waits until a payload of <size> bytes fits; false on timeout or
+        // when the peer went away (timeoutMs < 0 waits forever)
+        bool waitWritable(size_t size, int timeoutMs = -1);
+
+        // Consumer: oldest record (nullptr when the ring is empty), valid
+        // until release
+        const uint8_t* peek(size_t& size);
+        void release();
+        bool waitReadable(int timeoutMs = -1);
+    };
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+
+// Reports an error of the input being processed: every occurrence is
+// counted per (call site, schema), while <message> is built and logged only
+// for the first occurrences of each period; the reporter then logs a
+// summary of the suppressed ones. <site> names the error in the summaries
+#define OPENCMD_REPORT(level, site, message)                                                     \
+    do {                                                                                         \
+        static ::opencmd::ErrorSite opencmdErrorSite(site, level);                               \
+        if (opencmdErrorSite.occurrence(::opencmd::ErrorReporter::currentSchema())) {            \
+            OPENCMD_LOG(level, message);                                                         \
+        }                                                                                        \
+    } while (0)
+#define OPENCMD_REPORT_WARNING(site, message) OPENCMD_REPORT(::opencmd::Logger::Level::WARNING, site, message)
+#define OPENCMD_REPORT_ERROR(site, message) OPENCMD_REPORT(::opencmd::Logger::Level::ERROR, site, message)
+
+namespace opencmd {
+
+    struct ErrorReportOptions {
+        // Period of the summaries and of the refill of the detailed messages
+        std::chrono::seconds summaryPeriod{10};
+        // Occurrences logged in full per (site, schema) and period
+        int64_t detailsPerPeriod = 5;
+    };
+
+    /* Call site of an input error, with its counters per schema.
+     *
+     * Sites are static objects created by OPENCMD_REPORT and registered with
+     * the ErrorReporter. The counters of a schema live in blocks allocated
+     * on first use and never freed, so an occurrence is a lookup and an
+     * atomic increment, plus a token taken while the detailed messages of
+     * the period are not used up.
+     */
+    class ErrorSite {
+    public:
+        // Occurrences out of any schema (or of an invalid one)
+        static constexpr uint32_t NO_SCHEMA = 0;
+
+        struct Counters {
+            std::atomic<uint64_t> occurrences{0};
+            // Detailed messages left in the period (refilled by the reporter)
+            std::atomic<int64_t> tokens{0};
+            // Reporter only: occurrences at the last summary
+            uint64_t summarized = 0;
+        };
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 64;
+        static constexpr size_t BLOCKS = 64;
+        struct Block {
+            Counters counters[BLOCK_SIZE];
+        };
+
+        const char* name;
+        Logger::Level level;
+        // Trivially destructible on purpose: sites are used until the end
+        // of the process, static destruction included
+        std::atomic<Block*> blocks[BLOCKS];
+
+        Counters& counters(uint32_t schema);
+
+    public:
+        ErrorSite(const char* name, Logger::Level level);
+        ErrorSite(const ErrorSite&) = delete;
+        ErrorSite& operator=(const ErrorSite&) = delete;
+
+        // Counts an occurrence: true when it is to be logged in full
+        bool occurrence(uint32_t schema) {
+            Counters& schemaCounters = counters(schema);
+            schemaCounters.occurrences.fetch_add(1, std::memory_order_relaxed);
+            return schemaCounters.tokens.load(std::memory_order_relaxed) > 0 &&
+                   schemaCounters.tokens.fetch_sub(1, std::memory_order_relaxed) > 0;
+        }
+
+        const char* getName() const { return name; }
+        Logger::Level getLevel() const { return level; }
+        // Calls <function> for every schema with occurrences
+        void forEach(const std::function<void(uint32_t schema, Counters&)>& function);
+    };
+
+    /* Aggregation of the input errors.
+     *
+     * Keeps the registry of the error sites and, on a background thread,
+     * logs every period one summary per (site, schema) whose occurrences
+     * were not all logged in full, then refills the detailed messages. The
+     * schema of an occurrence is the one the calling thread is processing,
+     * set by a SchemaScope (e.g. by the DecoderContext).
+     */
+    class ErrorReporter {
+    public:
+        // Marks the schema processed by the calling thread, while in scope
+        class SchemaScope {
+            uint32_t previous;
+
+        public:
+            explicit SchemaScope(uint32_t schema) : previous(currentSchemaId) { currentSchemaId = schema; }
+            ~SchemaScope() { currentSchemaId = previous; }
+            SchemaScope(const SchemaScope&) = delete;
+            SchemaScope& operator=(const SchemaScope&) = delete;
+        };
+
+    private:
+        static inline thread_local uint32_t currentSchemaId = ErrorSite::NO_SCHEMA;
+
+        std::mutex sitesMutex;
+        std::vector<ErrorSite*> sites;
+        std::atomic<int64_t> detailsPerPeriod;
+        std::chrono::seconds summaryPeriod;
+
+        std::thread summarizer;
+        std::mutex summarizerMutex;
+        std::condition_variable summarizerCondition;
+        bool periodChanged = false;
+        bool stopping = false;
+
+        ErrorReporter();
+        void summarizeLoop();
+        void stop();
+
+    public:
+        static ErrorReporter& getInstance();
+        ErrorReporter(const ErrorReporter&) = delete;
+        ErrorReporter& operator=(const ErrorReporter&) = delete;
+
+        static uint32_t currentSchema() { return currentSchemaId; }
+
+        void setOptions(const ErrorReportOptions& options);
+        int64_t getDetailsPerPeriod() const { return detailsPerPeriod.load(std::memory_order_relaxed); }
+
+        void registerSite(ErrorSite* site);
+        // Logs the summaries of the occurrences not summarized yet and
+        // refills the detailed messages (done every period)
+        void summarize();
+        // Calls <function> for every (site, schema) with occurrences
+        void forEach(const std::function<void(const ErrorSite&, uint32_t schema, uint64_t occurrences)>& function);
+    };
+
+}
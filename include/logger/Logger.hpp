@@ -1,10 +1,48 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Lowest level compiled in (0 = DEBUG ... 4 = CRITICAL): the OPENCMD_LOG_*
+// calls below it are removed from the build, arguments included
+#ifndef OPENCMD_LOG_MIN_LEVEL
+#define OPENCMD_LOG_MIN_LEVEL 0
+#endif
+
+// Logs <message> only when <level> is compiled in and enabled: the message
+// expression is not evaluated otherwise
+#define OPENCMD_LOG(level, message)                                                                        \
+    do {                                                                                                   \
+        if (::opencmd::Logger::isCompiledIn(level) && ::opencmd::Logger::getInstance().isEnabled(level)) { \
+            ::opencmd::Logger::getInstance().log((message), (level));                                      \
+        }                                                                                                  \
+    } while (0)
+#define OPENCMD_LOG_DEBUG(message) OPENCMD_LOG(::opencmd::Logger::Level::DEBUG, message)
+#define OPENCMD_LOG_INFO(message) OPENCMD_LOG(::opencmd::Logger::Level::INFO, message)
+#define OPENCMD_LOG_WARNING(message) OPENCMD_LOG(::opencmd::Logger::Level::WARNING, message)
+#define OPENCMD_LOG_ERROR(message) OPENCMD_LOG(::opencmd::Logger::Level::ERROR, message)
+#define OPENCMD_LOG_CRITICAL(message) OPENCMD_LOG(::opencmd::Logger::Level::CRITICAL, message)
 
 namespace opencmd {
+    /* Asynchronous logger.
+     *
+     * A message is copied, with its timestamp and level, into a ring buffer
+     * owned by the calling thread (single producer, lock free) and written
+     * to the standard output by a background flusher thread, which drains
+     * the buffers of all the threads in batches and renders the timestamps
+     * (the date part is formatted once per second). A full buffer either
+     * drops the message (counted and reported by the flusher) or blocks the
+     * caller until the flusher makes room, according to the overflow
+     * policy. Critical messages are flushed before log() returns.
+     */
     class Logger {
 	 	public:
 			enum class Level {
@@ -15,10 +53,27 @@ namespace opencmd {
 	   			CRITICAL
 	   		};
 
+			enum class OverflowPolicy {
+				// The message is discarded, the flusher reports how many were
+				DROP,
+				// The caller waits for the flusher to free enough room
+				BLOCK
+			};
+
 			static Logger& getInstance();
 
    			Level getSeverity();
 			void setSeverity(Level severity);
+			void setOverflowPolicy(OverflowPolicy policy);
+
+			static constexpr bool isCompiledIn(Level level) {
+				return static_cast<int>(level) >= OPENCMD_LOG_MIN_LEVEL;
+			}
+			// Whether a message of <level> would be logged: to be checked before
+			// building an expensive message
+			bool isEnabled(Level level) const {
+				return isCompiledIn(level) && static_cast<int>(level) >= static_cast<int>(severity.load(std::memory_order_relaxed));
+			}
 
 	  		void log(const std::string& message, Level level);
 	  		void debug(const std::string& message);
@@ -27,10 +82,47 @@ namespace opencmd {
 	  		void error(const std::string& message);
 	  		void critical(const std::string& message);
 
+			// Waits until the messages logged so far are written
+			void flush();
+
 		private:
-	   		Logger() = default;
+			struct ThreadBuffer;
+			static constexpr size_t THREAD_BUFFER_SIZE = 256 * 1024;
+
+	   		Logger();
 			Logger(const Logger&) = delete;
 	  		Logger& operator=(const Logger&) = delete;
-			Level severity = Level::DEBUG;
+			std::atomic<Level> severity{Level::DEBUG};
+			std::atomic<OverflowPolicy> overflowPolicy{OverflowPolicy::BLOCK};
+
+			std::mutex buffersMutex;
+			std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+			std::thread flusher;
+			std::mutex flusherMutex;
+			std::condition_variable flusherCondition;
+			std::condition_variable flushedCondition;
+			// Completed passes of the flusher over the buffers
+			uint64_t passes = 0;
+			bool draining = false;
+			bool wakeRequested = false;
+			bool stopping = false;
+			// Once stopped (at exit) messages are written synchronously
+			std::atomic<bool> running{false};
+			std::mutex writeMutex;
+
+			// Cached rendering of the current second of the timestamps
+			int64_t cachedSecond = -1;
+			std::string cachedPrefix;
+
+			ThreadBuffer& threadBuffer();
+			void wakeFlusher();
+			void flushLoop();
+			// Moves the records of every buffer to <out>; false when all empty
+			bool drain(std::string& out);
+			void format(std::string& out, int64_t micros, Level level, const char* message, size_t length);
+			// Writes and clears <out>
+			void write(std::string& out);
+			void stop();
     };
 }
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace opencmd {
+
+    /* Monotonic arena: allocations are carved out of large chunks by bumping
+     * a cursor and are never freed one by one. Everything allocated in the
+     * arena goes away at once with reset() or with the arena itself.
+     *
+     * reset() keeps a single chunk as large as all the memory used so far,
+     * so that a resettable arena (e.g. the per-thread scratch arena used for
+     * the temporaries of a request) stops allocating once warmed up.
+     */
+    class Arena {
+    public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+    private:
+        struct Chunk {
+            Chunk* next;
+            size_t size;
+        };
+
+        Chunk* head = nullptr;
+        uint8_t* cursor = nullptr;
+        uint8_t* limit = nullptr;
+        size_t chunkSize;
+        size_t bytesUsed = 0;
+        size_t bytesReserved = 0;
+
+        void addChunk(size_t minimumSize);
+        void releaseChunks();
+
+    public:
+        explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE) : chunkSize(chunkSize) {}
+        ~Arena() { releaseChunks(); }
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+                addChunk(size + alignment);
+                aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            }
+            cursor = reinterpret_cast<uint8_t*>(aligned + size);
+            bytesUsed += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        template <typename T>
+        T* allocateArray(size_t count) {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void reset();
+
+        size_t getBytesUsed() const { return bytesUsed; }
+        size_t getBytesReserved() const { return bytesReserved; }
+
+        // Scratch arena of the calling thread, for per-request temporaries:
+        // whoever drives a request resets it once the request is completed
+        static Arena& threadScratch();
+    };
+
+    // Standard allocator over an Arena (deallocation is a no-op), usable
+    // with std::allocate_shared and the standard containers
+    template <typename T>
+    class ArenaAllocator {
+    private:
+        Arena* arena;
+
+        template <typename U> friend class ArenaAllocator;
+
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+        void deallocate(T*, size_t) {}
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+    };
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace opencmd {
+
+    /* One T per thread, recycled across threads.
+     *
+     * local() returns the slot of the calling thread: the first time, the
+     * slot released by a thread that exited, or a new one. What a thread
+     * accumulated in its slot is kept for the next owner and for the
+     * readers (forEach), and there are never more slots than threads alive
+     * at once. The slot is released by the thread_local handle at the exit
+     * of the thread, so the ThreadSlots must outlive every thread: it is a
+     * member of a never destroyed singleton (see Logger::getInstance). The
+     * handle is per T, each T is kept in a single ThreadSlots.
+     */
+    template <typename T>
+    class ThreadSlots {
+    private:
+        struct Slot {
+            T value;
+            std::atomic<bool> inUse{false};
+        };
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+
+    public:
+        T& local() {
+            struct Handle {
+                Slot* slot = nullptr;
+                ~Handle() {
+                    if (slot) {
+                        slot->inUse.store(false, std::memory_order_release);
+                    }
+                }
+            };
+            thread_local Handle handle;
+            if (!handle.slot) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& slot : slots) {
+                    bool free = false;
+                    if (slot->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                        handle.slot = slot.get();
+                        break;
+                    }
+                }
+                if (!handle.slot) {
+                    slots.push_back(std::make_unique<Slot>());
+                    handle.slot = slots.back().get();
+                    handle.slot->inUse.store(true, std::memory_order_relaxed);
+                }
+            }
+            return handle.slot->value;
+        }
+
+        // Calls <function> on every slot, in use or not, while no thread
+        // takes a new one
+        template <typename Function>
+        void forEach(Function&& function) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& slot : slots) {
+                function(slot->value);
+            }
+        }
+    };
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace opencmd {
+
+    // Counter written by a single thread: a plain load and store, without
+    // any locked instruction. Readers sum the counters of all the threads
+    class ShardCounter {
+        std::atomic<uint64_t> value{0};
+
+    public:
+        void add(uint64_t amount) { value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    };
+
+    /* Log-linear histogram of durations in nanoseconds (HDR style).
+     *
+     * Every power of two is split in 2^SUB_BUCKET_BITS buckets, so a value
+     * is known within 25% from 64 ns to about a minute, with a bucket below
+     * and one above the range. Recording is an index computation and two
+     * single writer counters: each thread records in its own histogram and
+     * the histograms are merged when read.
+     */
+    class Histogram {
+    public:
+        static constexpr int MIN_EXPONENT = 6;
+        static constexpr int MAX_EXPONENT = 36;
+        static constexpr int SUB_BUCKET_BITS = 2;
+        static constexpr size_t BUCKETS = (size_t(MAX_EXPONENT - MIN_EXPONENT) << SUB_BUCKET_BITS) + 2;
+
+        static size_t bucketIndex(uint64_t nanos) {
+            if (nanos < (uint64_t(1) << MIN_EXPONENT)) {
+                return 0;
+            }
+            int exponent = 63 - __builtin_clzll(nanos);
+            if (exponent >= MAX_EXPONENT) {
+                return BUCKETS - 1;
+            }
+            size_t subBucket = (nanos >> (exponent - SUB_BUCKET_BITS)) & ((size_t(1) << SUB_BUCKET_BITS) - 1);
+            return 1 + (size_t(exponent - MIN_EXPONENT) << SUB_BUCKET_BITS) + subBucket;
+        }
+
+        // First bucket of the values >= 2^exponent ns
+        static constexpr size_t firstBucketOf(int exponent) {
+            return 1 + (size_t(exponent - MIN_EXPONENT) << SUB_BUCKET_BITS);
+        }
+
+        ShardCounter buckets[BUCKETS];
+        ShardCounter sum;
+
+        void record(uint64_t nanos) {
+            buckets[bucketIndex(nanos)].add(1);
+            sum.add(nanos);
+        }
+    };
+
+    // Histograms of several threads merged
+    struct HistogramSnapshot {
+        uint64_t buckets[Histogram::BUCKETS] = {};
+        uint64_t sum = 0;
+        uint64_t count = 0;
+
+        void add(const Histogram& histogram) {
+            for (size_t i = 0; i < Histogram::BUCKETS; i++) {
+                uint64_t value = histogram.buckets[i].get();
+                buckets[i] += value;
+                count += value;
+            }
+            sum += histogram.sum.get();
+        }
+    };
+
+}
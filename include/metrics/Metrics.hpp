@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Histogram.hpp"
+#include "../memory/ThreadSlots.hpp"
+
+namespace opencmd {
+
+    /* Instrumentation of the service: requests per RPC, messages per schema
+     * and status code, bytes in and out, latency histograms of the RPCs and
+     * of the stages of a message (decode, encode, base64, serialization).
+     *
+     * Every thread records in its own shard with single writer counters, so
+     * recording takes no lock and shares no cache line; a scrape sums the
+     * shards and renders them in the Prometheus text format. The shard of a
+     * thread that exits is taken over by the next thread, the totals never
+     * go back. Recording is disabled until setEnabled(true).
+     */
+    class Metrics {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Rpc { TO_JSON, TO_BITS, TO_JSON_BATCH, TO_BITS_BATCH, TO_FIELDS, RESOLVE_SCHEMA, CLASSIFY, PATH_TABLE, LOCAL_DECODE, COUNT };
+        enum class Operation { DECODE, ENCODE, COUNT };
+        enum class Stage { DECODE, ENCODE, BASE64, SERIALIZATION, COUNT };
+
+        // Status codes counted on their own, the others count as "other"
+        static constexpr std::array<int, 7> STATUS_CODES = {0, 100, 400, 404, 413, 503, 504};
+
+        // Records the duration of an RPC, from construction to destruction
+        class RpcTimer {
+            Rpc rpc;
+            bool enabled;
+            Clock::time_point start;
+
+        public:
+            explicit RpcTimer(Rpc rpc);
+            ~RpcTimer();
+            RpcTimer(const RpcTimer&) = delete;
+            RpcTimer& operator=(const RpcTimer&) = delete;
+        };
+
+        // Times the consecutive stages of a message: lap() records the time
+        // elapsed since the previous lap (or the construction)
+        class StageTimer {
+            uint32_t schema;
+            bool enabled;
+            Clock::time_point last;
+
+        public:
+            explicit StageTimer(uint32_t schema);
+            void lap(Stage stage);
+            void skip();
+        };
+
+    private:
+        static constexpr size_t OPERATIONS = static_cast<size_t>(Operation::COUNT);
+        static constexpr size_t STAGES = static_cast<size_t>(Stage::COUNT);
+        static constexpr size_t RPCS = static_cast<size_t>(Rpc::COUNT);
+        static constexpr size_t STATUSES = STATUS_CODES.size() + 1;
+        static constexpr size_t BLOCK_SIZE = 16;
+        static constexpr size_t BLOCKS = 256;
+
+        struct SchemaMetrics {
+            ShardCounter messages[OPERATIONS][STATUSES];
+            ShardCounter bytesIn[OPERATIONS];
+            ShardCounter bytesOut[OPERATIONS];
+            Histogram stages[STAGES];
+        };
+        struct SchemaBlock {
+            SchemaMetrics schemas[BLOCK_SIZE];
+        };
+        struct RpcMetrics {
+            ShardCounter requests;
+            Histogram duration;
+        };
+        struct Shard {
+            // Schemas beyond the table share its last entry
+            std::atomic<SchemaBlock*> blocks[BLOCKS] = {};
+            RpcMetrics rpcs[RPCS];
+
+            ~Shard();
+            SchemaMetrics& schema(uint32_t id);
+        };
+
+        std::atomic<bool> enabled{false};
+        ThreadSlots<Shard> shards;
+
+        Metrics() = default;
+        static size_t statusIndex(int status);
+
+    public:
+        static Metrics& getInstance();
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+        void recordRpc(Rpc rpc, uint64_t nanos);
+        void recordMessage(uint32_t schema, Operation operation, int status, size_t bytesIn, size_t bytesOut);
+        void recordStage(uint32_t schema, Stage stage, uint64_t nanos);
+
+        // All the metrics in the Prometheus text exposition format
+        std::string exposition();
+    };
+
+}
@@ -7,5 +7,7 @@
 
 #include "logger/Logger.hpp"
 #include "catalog/SchemaCatalog.hpp"
+#include "catalog/CatalogWatcher.hpp"
+#include "catalog/DecoderContext.hpp"
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+
+#include "../executor/TaskPool.hpp"
+
+namespace opencmd {
+
+    class RequestHandler;
+
+    /* Runs the items of a batch in chunks on the workers of a TaskPool.
+     *
+     * The thread submitting a batch processes the first chunk itself, with
+     * its own handler, while the rest is split across the pool, and returns
+     * once every chunk is done. Each worker of the pool owns a
+     * RequestHandler (decoder context and scratch arena), so chunks run
+     * without sharing any per request state; the caller decides where the
+     * result of each item goes (e.g. a pre-sized repeated field), in order.
+     */
+    class BatchEngine {
+    public:
+        using ChunkFunction = std::function<void(RequestHandler&, size_t begin, size_t end)>;
+
+    private:
+        TaskPool& pool;
+        size_t chunkSize;
+        WorkerLocal<RequestHandler> handlers;
+
+    public:
+        BatchEngine(TaskPool& pool, size_t chunkSize);
+        BatchEngine(const BatchEngine&) = delete;
+        BatchEngine& operator=(const BatchEngine&) = delete;
+
+        // Calls <function> over [0, count) split in chunks; the calling
+        // thread takes part with <handler>
+        void run(size_t count, RequestHandler& handler, const ChunkFunction& function);
+
+        size_t getThreadCount() const { return pool.size(); }
+    };
+
+}
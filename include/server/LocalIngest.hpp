@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace opencmd {
+
+    struct LocalIngestOptions {
+        // Unix socket the co-located producers connect to
+        std::string socketPath;
+        // Capacity in bytes of the rings of each connection (powers of two):
+        // decoded JSON documents are larger than the frames
+        size_t requestRingSize = size_t(4) << 20;
+        size_t responseRingSize = size_t(16) << 20;
+    };
+
+    /* Shared memory transport for producers running on the same host.
+     *
+     * Every connection on the unix socket gets its own shared memory with a
+     * request ring (frames and schema ids, written by the producer) and a
+     * response ring (decoded messages, written by openCMD), see
+     * LocalProtocol.hpp. A connection is served by a dedicated thread with
+     * its own DecoderContext: frames are decoded in place from the ring, and
+     * the thread sleeps on its doorbell only when the request ring is empty.
+     */
+    class LocalIngest {
+    public:
+        static constexpr int STATUS_INVALID_REQUEST = 400;
+        static constexpr int STATUS_UNKNOWN_SCHEMA = 404;
+        static constexpr int STATUS_RESULT_TOO_LARGE = 413;
+
+    private:
+        struct Session;
+
+        LocalIngestOptions options;
+        int listenSocket = -1;
+        std::thread acceptThread;
+        std::mutex sessionsMutex;
+        std::list<std::unique_ptr<Session>> sessions;
+        std::atomic<bool> stopping{false};
+
+        void accept();
+        std::unique_ptr<Session> openSession(int socket);
+        void serve(Session&);
+        void reapSessions(bool all);
+
+    public:
+        explicit LocalIngest(const LocalIngestOptions& options);
+        ~LocalIngest();
+        LocalIngest(const LocalIngest&) = delete;
+        LocalIngest& operator=(const LocalIngest&) = delete;
+
+        int start();
+        void stop();
+    };
+
+}
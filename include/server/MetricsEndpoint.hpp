@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace opencmd {
+
+    /* Minimal HTTP endpoint serving the Metrics in the Prometheus text
+     * format on GET /metrics, and the NodeProfiler results on GET /profile
+     * (per schema table) and GET /profile/folded (folded stacks).
+     *
+     * A single thread accepts the scrapes and answers them one at a time,
+     * closing every connection: scrapes come every few seconds from a
+     * handful of collectors. Starting the endpoint enables the recording
+     * of the metrics.
+     */
+    class MetricsEndpoint {
+        // host:port, e.g. 127.0.0.1:9464 (port 0 picks a free one)
+        std::string address;
+        int listenSocket = -1;
+        int selectedPort = 0;
+        std::thread acceptThread;
+        std::atomic<bool> stopping{false};
+
+        void accept();
+        void serve(int socket);
+
+    public:
+        explicit MetricsEndpoint(const std::string& address);
+        ~MetricsEndpoint();
+        MetricsEndpoint(const MetricsEndpoint&) = delete;
+        MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+        int start();
+        void stop();
+
+        int getPort() const { return selectedPort; }
+    };
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../catalog/SchemaCatalog.hpp"
+#include "BatchEngine.hpp"
+
+namespace opencmd {
+
+    struct MicroBatchOptions {
+        // Requests of the same RPC and schema arriving within the window are
+        // handled as one batch (0 = no scheduling, each request is handled
+        // right away by the worker that received it)
+        std::chrono::microseconds window{0};
+        size_t maxBatchSize = 256;
+        // Threads taking the batches out of the queues
+        size_t threads = 1;
+
+        // Overload: at most <maxQueued> requests wait in the queues, the
+        // request arriving on a full queue is rejected (REJECT_NEW) or the
+        // oldest waiting one makes room for it (DROP_OLDEST)
+        enum class OverloadPolicy { REJECT_NEW, DROP_OLDEST };
+        size_t maxQueued = 4096;
+        OverloadPolicy overloadPolicy = OverloadPolicy::REJECT_NEW;
+        // Requests that waited longer than this when their batch starts are
+        // rejected instead of handled (0 = no limit), as are the requests
+        // past the deadline set by their client
+        std::chrono::microseconds maxQueueDelay{0};
+    };
+
+    /* Scheduler coalescing single message requests into batches.
+     *
+     * Requests are queued by (kind, schema), the kind telling apart the RPCs
+     * (e.g. toJson and toBits). A queue is flushed when it holds
+     * maxBatchSize requests or when its oldest request waited for the
+     * window; the batch then runs on a scheduler thread, split across the
+     * BatchEngine when there is one, with the decoder context of the schema
+     * warm for the whole batch. The queues are bounded, so under overload
+     * the latency of the accepted requests stays within the window plus the
+     * time to handle maxQueued requests instead of growing without limit.
+     */
+    class MicroBatcher {
+    public:
+        using Clock = std::chrono::steady_clock;
+        static constexpr int STATUS_OVERLOADED = 503;
+        static constexpr int STATUS_EXPIRED = 504;
+
+        // A queued request, owned by the scheduler until it is processed or
+        // rejected (each happens once, on a scheduler or batch thread)
+        class Item {
+            friend class MicroBatcher;
+            Clock::time_point arrival;
+            Clock::time_point deadline;
+
+        public:
+            virtual ~Item() = default;
+            virtual void process(RequestHandler&) = 0;
+            virtual void reject(int status, const std::string& message) = 0;
+        };
+
+    private:
+        using Key = std::pair<const void*, SchemaId>;
+
+        MicroBatchOptions options;
+        BatchEngine* batchEngine;
+        std::vector<std::thread> threads;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::map<Key, std::deque<Item*>> queues;
+        size_t queued = 0;
+        bool stopping = false;
+
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> overloaded{0};
+        std::atomic<uint64_t> expired{0};
+
+        void work();
+        void runBatch(std::vector<Item*>& batch, RequestHandler& handler);
+
+    public:
+        MicroBatcher(const MicroBatchOptions& options, BatchEngine* batchEngine);
+        // Rejects the requests still queued
+        ~MicroBatcher();
+        MicroBatcher(const MicroBatcher&) = delete;
+        MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+        // Queues <item> with the requests of the same <kind> and <schema>;
+        // <deadline> is the time after which its client gave up on it
+        void submit(Item* item, const void* kind, SchemaId schema, Clock::time_point deadline = Clock::time_point::max());
+
+        uint64_t getBatchCount() const { return batches.load(std::memory_order_relaxed); }
+        uint64_t getOverloadedCount() const { return overloaded.load(std::memory_order_relaxed); }
+        uint64_t getExpiredCount() const { return expired.load(std::memory_order_relaxed); }
+    };
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "service.pb.h"
+
+#include "../catalog/DecoderContext.hpp"
+#include "../memory/Arena.hpp"
+#include "BatchEngine.hpp"
+
+namespace opencmd {
+
+    /* Transport independent implementation of the service RPCs.
+     *
+     * A handler owns the per worker state (the evaluation trees of the
+     * DecoderContext and the scratch arena of the request temporaries), so
+     * it must be used by one thread at a time; the catalog itself is shared
+     * and read without locks. The outcome of a request is reported in the
+     * response_status / response_message fields of the response.
+     */
+    class RequestHandler {
+    public:
+        static constexpr int STATUS_OK = 0;
+        static constexpr int STATUS_INVALID_REQUEST = 400;
+        static constexpr int STATUS_UNKNOWN_SCHEMA = DecoderContext::ERROR_UNKNOWN_SCHEMA;
+
+    private:
+        DecoderContext context;
+        Arena scratch;
+        // Splits the batch RPCs across its threads (nullptr = the whole
+        // batch is processed by the calling thread)
+        BatchEngine* batchEngine = nullptr;
+        // Reused by the path lookups of toFields
+        std::string pathBuffer;
+        std::vector<uint32_t> pathIndices;
+
+        static std::string schemaName(SchemaId id, const std::string& messageType);
+
+        // Input of a request: a view over the raw bytes when present, the
+        // decoded base64 otherwise
+        BitStream inputStream(const std::string& messageBase64, const std::string& message, uint32_t bitLength);
+        void decodeMessage(SchemaId, const std::string& messageBase64, const std::string& message, uint32_t bitLength, interface::toJsonResponse&);
+        void encodeMessage(SchemaId, const std::string& messageJson, bool binaryOutput, interface::toBitsResponse&);
+        void runBatch(size_t count, const BatchEngine::ChunkFunction&);
+
+    public:
+        RequestHandler() = default;
+        RequestHandler(const RequestHandler&) = delete;
+        RequestHandler& operator=(const RequestHandler&) = delete;
+
+        // Schema addressed by a request: its id when set, its name otherwise
+        static std::optional<SchemaId> resolveSchemaId(uint32_t schemaId, const std::string& messageType);
+
+        void toJson(const interface::toJsonRequest&, interface::toJsonResponse&);
+        void toBits(const interface::toBitsRequest&, interface::toBitsResponse&);
+        void toJsonBatch(const interface::toJsonBatchRequest&, interface::toJsonBatchResponse&);
+        void toBitsBatch(const interface::toBitsBatchRequest&, interface::toBitsBatchResponse&);
+        void resolveSchema(const interface::resolveSchemaRequest&, interface::resolveSchemaResponse&);
+        void classify(const interface::classifyRequest&, interface::classifyResponse&);
+        void toFields(const interface::toJsonRequest&, interface::toFieldsResponse&);
+        void getPathTable(const interface::pathTableRequest&, interface::pathTableResponse&);
+
+        void setBatchEngine(BatchEngine* engine) { batchEngine = engine; }
+    };
+
+}
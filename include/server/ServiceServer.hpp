@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "service.grpc.pb.h"
+
+#include "BatchEngine.hpp"
+#include "MicroBatcher.hpp"
+#include "RequestHandler.hpp"
+
+namespace opencmd {
+
+    struct ServerOptions {
+        // host:port (port 0 picks a free one) or unix:/path/to/socket
+        std::string address = "0.0.0.0:50051";
+        // Completion queues, each drained by its own polling thread which
+        // also runs the handlers (0 = one per core)
+        size_t workers = 0;
+        // Calls of each RPC kept posted on every queue, waiting for a client
+        size_t pendingCalls = 16;
+
+        // Streaming RPCs: responses produced within the coalescing window
+        // are sent in a single message (at most streamBatchSize responses).
+        // A zero window sends as soon as the previous write is completed
+        std::chrono::microseconds streamWindow{1000};
+        size_t streamBatchSize = 256;
+
+        // Batch RPCs: threads of the work stealing pool shared by the
+        // workers to split large batches (0 = a batch is processed by its
+        // worker alone) and number of messages per chunk
+        size_t batchThreads = 0;
+        size_t batchChunkSize = 256;
+        // Placement of the worker and pool threads on the CPUs
+        PinningPolicy pinning = PinningPolicy::NONE;
+
+        // Unary toJson / toBits / toFields: coalescing of the concurrent
+        // requests of a schema and load shedding (disabled by default)
+        MicroBatchOptions microBatch;
+
+        // Time given to the open calls (e.g. long lived streams) to complete
+        // on shutdown, before they are cancelled
+        std::chrono::milliseconds shutdownTimeout{5000};
+    };
+
+    /* Asynchronous gRPC server of the service RPCs.
+     *
+     * Every worker owns a completion queue, the thread polling it and a
+     * RequestHandler: a call is accepted, handled and answered on the same
+     * thread, so the per worker state (decoder context, scratch arena) is
+     * never shared and the workers only meet on the catalog, which is read
+     * lock free. With one worker per core the server keeps all the cores
+     * busy without context switches between a polling and a handler pool.
+     */
+    class ServiceServer {
+    public:
+        struct Worker;
+
+    private:
+        ServerOptions options;
+        interface::service::AsyncService service;
+        std::unique_ptr<grpc::Server> server;
+        std::unique_ptr<TaskPool> taskPool;
+        std::unique_ptr<BatchEngine> batchEngine;
+        std::unique_ptr<MicroBatcher> microBatcher;
+        std::vector<std::unique_ptr<Worker>> workers;
+        int selectedPort = 0;
+
+        void run(Worker&);
+
+    public:
+        explicit ServiceServer(const ServerOptions& options = ServerOptions());
+        ~ServiceServer();
+        ServiceServer(const ServiceServer&) = delete;
+        ServiceServer& operator=(const ServiceServer&) = delete;
+
+        int start();
+        void shutdown();
+
+        // Port bound by a TCP address (useful when the requested port is 0)
+        int getPort() const { return selectedPort; }
+        size_t getWorkerCount() const { return workers.size(); }
+    };
+
+}
@@ -0,0 +1,164 @@
+#include "../../include/abstract_tree/NodeProfiler.hpp"
+
+#include <cstdio>
+
+using namespace opencmd;
+
+namespace {
+
+    using Frame = NodeProfiler::Frame;
+    using MergedRoots = std::map<std::pair<std::string, NodeProfiler::Operation>, std::unique_ptr<Frame>>;
+
+    const char* operationName(NodeProfiler::Operation operation) {
+        return operation == NodeProfiler::Operation::DECODE ? "decode" : "encode";
+    }
+
+    // Frames of the folded stacks are separated by ';' and end with a space
+    std::string frameName(const std::string& name) {
+        std::string sanitized = name;
+        for (char& c : sanitized) {
+            if (c == ';' || c == ' ' || c == '\n') {
+                c = '_';
+            }
+        }
+        return sanitized;
+    }
+
+    void mergeInto(Frame& target, const Frame& source) {
+        target.calls += source.calls;
+        target.cycles += source.cycles;
+        target.bits += source.bits;
+        for (const auto& child : source.children) {
+            mergeInto(*target.child(child->name), *child);
+        }
+    }
+
+    uint64_t selfCycles(const Frame& frame) {
+        uint64_t children = 0;
+        for (const auto& child : frame.children) {
+            children += child->cycles;
+        }
+        return frame.cycles > children ? frame.cycles - children : 0;
+    }
+
+    void foldFrame(std::string& out, const std::string& stack, const Frame& frame) {
+        uint64_t self = selfCycles(frame);
+        if (self > 0) {
+            out += stack + " " + std::to_string(self) + "\n";
+        }
+        for (const auto& child : frame.children) {
+            foldFrame(out, stack + ";" + frameName(child->name), *child);
+        }
+    }
+
+    void tableRows(std::string& out, const std::string& path, const Frame& frame, const Frame& root) {
+        char row[256];
+        double messages = static_cast<double>(root.calls);
+        double calls = static_cast<double>(frame.calls);
+        std::snprintf(row, sizeof(row), "  %-48s %12.2f %14.1f %8.1f %10.1f\n", path.c_str(), calls / messages, frame.cycles / calls,
+                      root.cycles ? 100.0 * selfCycles(frame) / root.cycles : 0.0, frame.bits / calls);
+        out += row;
+        for (const auto& child : frame.children) {
+            tableRows(out, path + "/" + child->name, *child, root);
+        }
+    }
+
+}
+
+NodeProfiler& NodeProfiler::getInstance() {
+    // Never destroyed, like the Logger
+    static NodeProfiler* instance = new NodeProfiler();
+    return *instance;
+}
+
+NodeProfiler::Frame* NodeProfiler::Frame::child(const std::string& childName) {
+    for (size_t i = 0; i < children.size(); i++) {
+        size_t index = (nextChild + i) % children.size();
+        if (children[index]->name == childName) {
+            nextChild = index + 1;
+            return children[index].get();
+        }
+    }
+    children.push_back(std::make_unique<Frame>(childName));
+    nextChild = children.size();
+    return children.back().get();
+}
+
+NodeProfiler::MessageScope::MessageScope(uint32_t schema, const std::string& schemaName, Operation operation, const BitStream& bitStream)
+    : bitStream(bitStream) {
+    ThreadProfile& profile = NodeProfiler::getInstance().profiles.local();
+    lock = std::unique_lock<std::mutex>(profile.mutex);
+    auto& root = profile.roots[{schema, operation}];
+    if (!root || root->name != schemaName) {
+        // The id was given to another schema by a reload
+        root = std::make_unique<Frame>(schemaName);
+    }
+    frame = root.get();
+    currentFrame = frame;
+    startBits = streamBits(bitStream);
+    start = cycles();
+}
+
+NodeProfiler::MessageScope::~MessageScope() {
+    frame->calls++;
+    frame->cycles += cycles() - start;
+    frame->bits += streamBits(bitStream) - startBits;
+    currentFrame = nullptr;
+}
+
+std::vector<std::unique_ptr<NodeProfiler::Frame>> NodeProfiler::merge() {
+    MergedRoots merged;
+    profiles.forEach([&](ThreadProfile& profile) {
+        std::lock_guard<std::mutex> profileLock(profile.mutex);
+        for (auto& [key, root] : profile.roots) {
+            auto& target = merged[{root->name, key.second}];
+            if (!target) {
+                target = std::make_unique<Frame>(frameName(root->name) + ";" + operationName(key.second));
+            }
+            mergeInto(*target, *root);
+        }
+    });
+    std::vector<std::unique_ptr<Frame>> roots;
+    for (auto& [key, root] : merged) {
+        roots.push_back(std::move(root));
+    }
+    return roots;
+}
+
+std::string NodeProfiler::folded() {
+    std::string out;
+    for (const auto& root : merge()) {
+        foldFrame(out, root->name, *root);
+    }
+    return out;
+}
+
+std::string NodeProfiler::table() {
+    std::string out;
+    char line[256];
+    for (const auto& root : merge()) {
+        if (root->calls == 0) {
+            continue;
+        }
+        // Roots are named <schema>;<operation>
+        size_t separator = root->name.rfind(';');
+        std::string title = root->name.substr(0, separator) + " (" + root->name.substr(separator + 1) + ")";
+        std::snprintf(line, sizeof(line), "%s: %lu messages profiled, %.1f cycles and %.1f bits per message\n", title.c_str(),
+                      static_cast<unsigned long>(root->calls), static_cast<double>(root->cycles) / root->calls, static_cast<double>(root->bits) / root->calls);
+        out += line;
+        std::snprintf(line, sizeof(line), "  %-48s %12s %14s %8s %10s\n", "path", "calls/msg", "cycles/call", "self %", "bits/call");
+        out += line;
+        for (const auto& child : root->children) {
+            tableRows(out, child->name, *child, *root);
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+void NodeProfiler::reset() {
+    profiles.forEach([](ThreadProfile& profile) {
+        std::lock_guard<std::mutex> profileLock(profile.mutex);
+        profile.roots.clear();
+    });
+}
@@ -1,5 +1,11 @@
 #include "../../include/bitstream/BitStream.hpp"
 
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 using namespace opencmd;
 
 BitStream::BitStream(const uint8_t* inputBuffer, size_t initialCapacityInBits)
@@ -29,38 +35,130 @@ BitStream::BitStream(const uint8_t* inputBuffer, size_t initialCapacityInBits)
         throw std::invalid_argument("BitStream::set - Input data is invalid or empty");
     }
 
-    size_t byteCapacity = (capacity + 7) / 8;
-    buffer = std::make_unique<uint8_t[]>(byteCapacity);
-    size_t bitShiftAmount = capacity % 8;
+    reserveBytes((capacity + 7) / 8);
+    toStreamLayout(inputBuffer, capacity, buffer);
+}
+
+void BitStream::toStreamLayout(const uint8_t* inputBuffer, size_t lengthInBits, uint8_t* outputBuffer) {
+    size_t byteCapacity = (lengthInBits + 7) / 8;
+    size_t bitShiftAmount = lengthInBits % 8;
 
     if(bitShiftAmount == 0){
-        memcpy(buffer.get(), inputBuffer, byteCapacity);
+        memcpy(outputBuffer, inputBuffer, byteCapacity);
     } else {
         // Circular Right Shift to align to the BitStream approach
-        uint8_t* tempBuffer = (uint8_t*) malloc(sizeof(uint8_t)*byteCapacity);
-        if(!tempBuffer){
-            throw std::invalid_argument("BitStream::set - Impossible to allocate internal buffer"); 
-        }
-
+        // (every output byte only depends on the input bytes, so the
+        // result is written directly in the output buffer)
         size_t bitMask = (static_cast<size_t>(1) << bitShiftAmount) - 1;
         uint8_t carry = inputBuffer[0] & bitMask;
         for(int byteIndex = byteCapacity-1; byteIndex >= 0; byteIndex--){
-            uint8_t currentByte = (inputBuffer[byteIndex] >> bitShiftAmount) | (carry << 8-bitShiftAmount);
+            uint8_t currentByte = (inputBuffer[byteIndex] >> bitShiftAmount) | (carry << (8-bitShiftAmount));
             carry = inputBuffer[byteIndex] & bitMask;
-            tempBuffer[byteIndex] = currentByte;
+            outputBuffer[byteIndex] = currentByte;
         }
+    }
+}
 
-        memcpy(buffer.get(), tempBuffer, byteCapacity);
-        free(tempBuffer);
+BitStream::BitStream(const std::string& base64_str, size_t lengthInBits) : offset(0) {
+    if (base64_str.empty()) {
+        throw std::invalid_argument("BitStream::set - Input base64 string is invalid or empty");
     }
+    size_t lengthInBytes = BitStream::base64_decoded_length(base64_str);
+    reserveBytes(lengthInBytes);
+    BitStream::base64_decode(base64_str, buffer, lengthInBytes);
+    capacity = exactLength(lengthInBytes, lengthInBits);
 }
 
-BitStream::BitStream(const std::string& base64_str) : offset(0) {
+BitStream::BitStream(const std::string& base64_str, Arena& arena, size_t lengthInBits) : arena(&arena) {
     if (base64_str.empty()) {
         throw std::invalid_argument("BitStream::set - Input base64 string is invalid or empty");
     }
-    size_t lengthInBytes = BitStream::base64_decode(base64_str, buffer);
-    capacity = lengthInBytes * 8;
+    size_t lengthInBytes = BitStream::base64_decoded_length(base64_str);
+    reserveBytes(lengthInBytes);
+    BitStream::base64_decode(base64_str, buffer, lengthInBytes);
+    capacity = exactLength(lengthInBytes, lengthInBits);
+}
+
+BitStream BitStream::view(const uint8_t* data, size_t lengthInBits) {
+    if (!data || lengthInBits == 0) {
+        throw std::invalid_argument("BitStream::view - Input data is invalid or empty");
+    }
+    BitStream bitStream;
+    bitStream.buffer = const_cast<uint8_t*>(data);
+    bitStream.bufferSize = (lengthInBits + 7) / 8;
+    bitStream.capacity = lengthInBits;
+    bitStream.borrowed = true;
+    return bitStream;
+}
+
+size_t BitStream::exactLength(size_t lengthInBytes, size_t lengthInBits) {
+    if (lengthInBits == 0) {
+        return lengthInBytes * 8;
+    }
+    // The message must end in the last byte of the payload
+    if ((lengthInBits + 7) / 8 != lengthInBytes) {
+        throw std::invalid_argument("BitStream - Bit length " + std::to_string(lengthInBits) + " does not match a payload of " + std::to_string(lengthInBytes) + " bytes");
+    }
+    return lengthInBits;
+}
+
+BitStream::BitStream(BitStream&& other) noexcept
+    : ownedBuffer(std::move(other.ownedBuffer)), buffer(other.buffer), bufferSize(other.bufferSize),
+      capacity(other.capacity), offset(other.offset), arena(other.arena), borrowed(other.borrowed) {
+    other.buffer = nullptr;
+    other.borrowed = false;
+    other.bufferSize = 0;
+    other.capacity = 0;
+    other.offset = 0;
+}
+
+BitStream& BitStream::operator=(BitStream&& other) noexcept {
+    if (this != &other) {
+        ownedBuffer = std::move(other.ownedBuffer);
+        buffer = other.buffer;
+        bufferSize = other.bufferSize;
+        capacity = other.capacity;
+        offset = other.offset;
+        arena = other.arena;
+        borrowed = other.borrowed;
+        other.buffer = nullptr;
+        other.borrowed = false;
+        other.bufferSize = 0;
+        other.capacity = 0;
+        other.offset = 0;
+    }
+    return *this;
+}
+
+void BitStream::reserveBytes(size_t byteCapacity) {
+    if (!borrowed && byteCapacity <= bufferSize) {
+        return;
+    }
+    // Grow geometrically, keeping the bytes already in use (a borrowed
+    // buffer is copied as is, the first time the stream is modified)
+    size_t newSize = borrowed ? std::max(byteCapacity, bufferSize) : std::max(byteCapacity, bufferSize * 2);
+    uint8_t* newBuffer;
+    std::unique_ptr<uint8_t[]> newOwnedBuffer;
+    if (arena) {
+        newBuffer = arena->allocateArray<uint8_t>(newSize);
+    } else {
+        newOwnedBuffer = std::make_unique<uint8_t[]>(newSize);
+        newBuffer = newOwnedBuffer.get();
+    }
+    size_t usedBytes = (capacity + 7) / 8;
+    if (buffer && usedBytes) {
+        std::memcpy(newBuffer, buffer, std::min(usedBytes, bufferSize));
+    }
+    ownedBuffer = std::move(newOwnedBuffer);
+    buffer = newBuffer;
+    bufferSize = newSize;
+    borrowed = false;
+}
+
+void BitStream::detach() {
+    if (borrowed) {
+        reserveBytes(bufferSize);
+    }
 }
 
 void BitStream::copyBits(uint8_t* dest, size_t destBitOffset, const uint8_t* src, size_t srcBitOffset, size_t length) const {
@@ -85,10 +183,11 @@ void BitStream::set(const uint8_t* inputBuffer, size_t inputBitLength) {
     if (!inputBuffer || inputBitLength == 0) {
         throw std::invalid_argument("BitStream::set - Input data is invalid or empty");
     }
+    capacity = 0;
+    size_t byteCapacity = (inputBitLength + 7) >> 3;            
+    reserveBytes(byteCapacity);
+    std::memcpy(buffer, inputBuffer, byteCapacity);
     capacity = inputBitLength;
-    size_t byteCapacity = (capacity + 7) >> 3;            
-    buffer = std::make_unique<uint8_t[]>(byteCapacity);
-    std::memcpy(buffer.get(), inputBuffer, byteCapacity);
     offset = 0;
 }
 
@@ -96,28 +195,39 @@ void BitStream::reduceCapacity(const size_t newCapacity) {
     if(newCapacity>=capacity){
         return;
     }
+    detach();
+    // Keep the last bytes, moving them to the beginning of the buffer
     size_t byteCapacity = (capacity + 7) / 8;
     size_t newByteCapacity = (newCapacity + 7) / 8;
-    std::unique_ptr<uint8_t[]> tempBuffer = std::make_unique<uint8_t[]>(newByteCapacity);
-    int byteIndex = byteCapacity-1;
-    for(int newByteIndex = newByteCapacity-1; newByteIndex>=0; newByteIndex--){
-        tempBuffer[newByteIndex] = buffer[byteIndex--];
-    }
-    buffer = std::move(tempBuffer);
+    std::memmove(buffer, buffer + (byteCapacity - newByteCapacity), newByteCapacity);
     capacity=newCapacity;
 }
         
 std::unique_ptr<uint8_t[]> BitStream::read(size_t length) const {
+    size_t byteLength = (length + 7) >> 3;
+    auto result = std::make_unique<uint8_t[]>(byteLength);
+    read(length, result.get());
+    return result; 
+}
+
+void BitStream::read(size_t length, uint8_t* destination) const {
     if (offset + length > capacity) {
         throw std::out_of_range("BitStream: you are trying to read beyond the end of the bit stream (offset + length > capacity)");
     }
 
     size_t byteLength = (length + 7) >> 3;
-    auto result = std::make_unique<uint8_t[]>(byteLength);
-    std::fill(result.get(), result.get() + byteLength, 0);
-    copyBits(result.get(), 0, buffer.get(), offset, length);
-    
-    return result; 
+    std::fill(destination, destination + byteLength, 0);
+    copyBits(destination, 0, buffer, offset, length);
+}
+
+void BitStream::peek(size_t bitOffset, size_t length, uint8_t* destination) const {
+    if (bitOffset + length > capacity) {
+        throw std::out_of_range("BitStream: you are trying to peek beyond the end of the bit stream (bitOffset + length > capacity)");
+    }
+
+    size_t byteLength = (length + 7) >> 3;
+    std::fill(destination, destination + byteLength, 0);
+    copyBits(destination, 0, buffer, bitOffset, length);
 }
 
 std::unique_ptr<uint8_t[]> BitStream::consume(size_t length) {
@@ -129,6 +239,14 @@ std::unique_ptr<uint8_t[]> BitStream::consume(size_t length) {
     return result;
 }
 
+void BitStream::consume(size_t length, uint8_t* destination) {
+    if (offset + length > capacity) {
+        throw std::out_of_range("BitStream: you are trying to consume beyond the end of the bit stream (offset + length > capacity)");
+    }
+    read(length, destination); 
+    offset += length;
+}
+
 /*
 void BitStream::append(const BitStream& other) {
 
@@ -155,19 +273,20 @@ void BitStream::append(const BitStream& other) {
 
 
 void BitStream::append(const BitStream& other) {
+    append(other.buffer, other.capacity);
+}
 
-    size_t newCapacity = capacity + other.capacity;
-    size_t newByteCapacity = (newCapacity + 7) / 8;
-
-    std::unique_ptr<uint8_t[]> newBuffer = std::make_unique<uint8_t[]>(newByteCapacity);
-    std::fill(newBuffer.get(), newBuffer.get() + newByteCapacity, 0);
+void BitStream::append(const uint8_t* source, size_t lengthInBits) {
 
+    size_t newCapacity = capacity + lengthInBits;
+    size_t newByteCapacity = (newCapacity + 7) / 8;
     size_t currentByteCapacity = (capacity + 7) / 8;
-    std::memcpy(newBuffer.get(), buffer.get(), currentByteCapacity);
 
-    copyBits(newBuffer.get(), capacity, other.buffer.get(), 0, other.capacity);
+    reserveBytes(newByteCapacity);
+    std::fill(buffer + currentByteCapacity, buffer + newByteCapacity, 0);
+
+    copyBits(buffer, capacity, source, 0, lengthInBits);
 
-    buffer = std::move(newBuffer);
     capacity = newCapacity; 
 }
 
@@ -177,9 +296,10 @@ int BitStream::shift(const size_t shiftAmount, const bool shiftRight) {
         return 1;
     }
 
+    detach();
     if (shiftAmount > capacity) {
         // shifting more bits than the actual capacity 
-        std::fill(buffer.get(), buffer.get()+capacity, 0);
+        std::fill(buffer, buffer+(capacity+7)/8, 0);
         return 0;
     }
 
@@ -187,53 +307,234 @@ int BitStream::shift(const size_t shiftAmount, const bool shiftRight) {
     std::unique_ptr<uint8_t[]> tempBuffer = std::make_unique<uint8_t[]>(capacityInBytes);
     std::fill(tempBuffer.get(), tempBuffer.get() + capacityInBytes, 0);
 
+    size_t shiftByte = shiftAmount / 8;
+    size_t shiftBit  = shiftAmount % 8;
     if (shiftRight) {
-        // Right Shift
-/* TBD */
-/*
-        size_t shiftByte = (shiftAmount+7) / 8;
-        size_t shiftBit  = shiftAmount % 8;
+        // Right Shift: byte i takes the bits of bytes i+shiftByte and
+        // i+shiftByte+1
+        for(size_t byteIndex = 0; byteIndex + shiftByte < capacityInBytes; byteIndex++){
+            uint16_t aux16 = buffer[byteIndex+shiftByte];
+            if(shiftBit && byteIndex+shiftByte+1 < capacityInBytes){
+                aux16 |= uint16_t(buffer[byteIndex+shiftByte+1]) << 8;
+            }
+            tempBuffer[byteIndex] = (aux16 >> shiftBit) & 0xFF;
+        }
+    } else {
+        // Left Shift: byte i takes the bits of bytes i-shiftByte and
+        // i-shiftByte-1
+        for(size_t byteIndex = shiftByte; byteIndex < capacityInBytes; byteIndex++){
+            uint16_t aux16 = uint16_t(buffer[byteIndex-shiftByte]) << 8;
+            if(shiftBit && byteIndex > shiftByte){
+                aux16 |= buffer[byteIndex-shiftByte-1];
+            }
+            tempBuffer[byteIndex] = (aux16 << shiftBit) >> 8;
+        }
+    }
+    std::memcpy(buffer, tempBuffer.get(), capacityInBytes); 
+    return 0;
+}
+
+namespace {
 
-        for(int byteIndex = capacityInBytes-1; byteIndex>=0; byteIndex--){
+    // 64 bits of <data> from byte <byte>, big endian: stream positions
+    // 8 * byte to 8 * byte + 63 (zeros past the <size> bytes)
+    inline uint64_t loadWindow(const uint8_t* data, size_t size, size_t byte) {
+        uint64_t value = 0;
+        if (byte + 8 <= size) {
+            std::memcpy(&value, data + byte, sizeof(value));
+            return __builtin_bswap64(value);
+        }
+        for (size_t i = 0; i < 8; i++) {
+            value = value << 8 | (byte + i < size ? data[byte + i] : 0);
+        }
+        return value;
+    }
 
-            if(byteIndex+shiftByte > capacityInBytes) continue;
+    /* A search pattern by words of 56 bits, left aligned: any bit position
+     * of the data is compared with one unaligned 64 bits load per word.
+     */
+    class BitPattern {
+    private:
+        std::vector<uint64_t> words;
+        std::vector<uint64_t> masks;
+        const uint8_t* pattern;
+        size_t length;
+        size_t patternBytes;
+
+    public:
+        BitPattern(const uint8_t* pattern, size_t length) : pattern(pattern), length(length), patternBytes((length + 7) / 8) {
+            for (size_t start = 0; start < length; start += 56) {
+                uint64_t mask = ~uint64_t(0) << (64 - std::min<size_t>(56, length - start));
+                words.push_back(loadWindow(pattern, patternBytes, start / 8) & mask);
+                masks.push_back(mask);
+            }
+        }
 
-            uint16_t aux16 = buffer[byteIndex];
-            aux16 <<= shiftBit;
-            uint8_t carry = (aux16 >> 8) & 0xFF;
-            uint8_t value = aux16 & 0xFF;
+        // The bits of the pattern that fall in byte <index> (0, 1 or 2) of
+        // the data when the pattern starts at bit <shift> of byte 0, and
+        // their mask
+        uint8_t shiftedByte(size_t index, unsigned shift, uint8_t& mask) const {
+            size_t first = std::max<size_t>(8 * index, shift);
+            size_t last = std::min<size_t>(8 * index + 8, shift + length);
+            mask = 0;
+            if (first >= last) {
+                return 0;
+            }
+            mask = static_cast<uint8_t>((0xFF >> (first - 8 * index)) & (0xFF << (8 * index + 8 - last)));
+            size_t start = first - shift;
+            uint8_t bits = static_cast<uint8_t>(loadWindow(pattern, patternBytes, start / 8) << (start % 8) >> 56);
+            return static_cast<uint8_t>(bits >> (first - 8 * index)) & mask;
+        }
 
-            tempBuffer[byteIndex+shiftByte] |= carry;
-            tempBuffer[byteIndex+shiftByte-1] = value;
+        // Every occurrence starting in byte <byte> of the data, within
+        // [from, to)
+        void matchByte(const uint8_t* data, size_t size, size_t byte, size_t from, size_t to, std::vector<size_t>& positions) const {
+            uint64_t window = loadWindow(data, size, byte);
+            for (unsigned shift = 0; shift < 8; shift++) {
+                size_t position = 8 * byte + shift;
+                if (position < from || position >= to || ((window << shift) & masks[0]) != words[0]) {
+                    continue;
+                }
+                bool match = true;
+                for (size_t i = 1; match && i < words.size(); i++) {
+                    size_t start = position + 56 * i;
+                    match = ((loadWindow(data, size, start / 8) << (start % 8)) & masks[i]) == words[i];
+                }
+                if (match) {
+                    positions.push_back(position);
+                }
+            }
         }
-*/
-    } else {
-        // Left Shift
-        size_t shiftByte = (shiftAmount+7) / 8;
-        size_t shiftBit  = shiftAmount % 8;
+    };
+
+#if defined(__x86_64__)
+
+    // At every alignment a pattern of 16 bits or more fills byte 1 of the
+    // data, and fills at least 4 bits of byte 0 or of byte 2: a block of data
+    // is compared with these bytes (the second one masked) for the 8
+    // alignments at once, and only the bytes where one of them matches are
+    // verified
+    struct Anchors {
+        uint8_t first[8];
+        uint8_t second[8];
+        uint8_t secondMask[8];
+        // Second byte: 0 or 2
+        size_t secondIndex[8];
+
+        explicit Anchors(const BitPattern& pattern) {
+            for (unsigned shift = 0; shift < 8; shift++) {
+                uint8_t mask, before, after, beforeMask, afterMask;
+                first[shift] = pattern.shiftedByte(1, shift, mask);
+                before = pattern.shiftedByte(0, shift, beforeMask);
+                after = pattern.shiftedByte(2, shift, afterMask);
+                bool useAfter = __builtin_popcount(afterMask) >= __builtin_popcount(beforeMask);
+                second[shift] = useAfter ? after : before;
+                secondMask[shift] = useAfter ? afterMask : beforeMask;
+                secondIndex[shift] = useAfter ? 2 : 0;
+            }
+        }
+    };
+
+    // Both return the first byte not scanned
+    size_t scanSse2(const uint8_t* data, size_t size, const BitPattern& pattern, size_t firstByte, size_t lastByte, size_t from, size_t to,
+                    std::vector<size_t>& positions) {
+        Anchors anchors(pattern);
+        __m128i first[8], second[8], secondMask[8];
+        for (unsigned shift = 0; shift < 8; shift++) {
+            first[shift] = _mm_set1_epi8(static_cast<char>(anchors.first[shift]));
+            second[shift] = _mm_set1_epi8(static_cast<char>(anchors.second[shift]));
+            secondMask[shift] = _mm_set1_epi8(static_cast<char>(anchors.secondMask[shift]));
+        }
+        size_t byte = firstByte;
+        for (; byte + 16 <= lastByte && byte + 2 + 16 <= size; byte += 16) {
+            __m128i bytes[3];
+            for (size_t i = 0; i < 3; i++) {
+                bytes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + byte + i));
+            }
+            __m128i candidates = _mm_setzero_si128();
+            for (unsigned shift = 0; shift < 8; shift++) {
+                __m128i match = _mm_cmpeq_epi8(bytes[1], first[shift]);
+                __m128i other = _mm_and_si128(bytes[anchors.secondIndex[shift]], secondMask[shift]);
+                candidates = _mm_or_si128(candidates, _mm_and_si128(match, _mm_cmpeq_epi8(other, second[shift])));
+            }
+            for (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(candidates)); mask; mask &= mask - 1) {
+                pattern.matchByte(data, size, byte + __builtin_ctz(mask), from, to, positions);
+            }
+        }
+        return byte;
+    }
 
-        for(int byteIndex = capacityInBytes-1; byteIndex>=0; byteIndex--){
+    __attribute__((target("avx2"))) size_t scanAvx2(const uint8_t* data, size_t size, const BitPattern& pattern, size_t firstByte, size_t lastByte,
+                                                    size_t from, size_t to, std::vector<size_t>& positions) {
+        Anchors anchors(pattern);
+        __m256i first[8], second[8], secondMask[8];
+        for (unsigned shift = 0; shift < 8; shift++) {
+            first[shift] = _mm256_set1_epi8(static_cast<char>(anchors.first[shift]));
+            second[shift] = _mm256_set1_epi8(static_cast<char>(anchors.second[shift]));
+            secondMask[shift] = _mm256_set1_epi8(static_cast<char>(anchors.secondMask[shift]));
+        }
+        size_t byte = firstByte;
+        for (; byte + 32 <= lastByte && byte + 2 + 32 <= size; byte += 32) {
+            __m256i bytes[3];
+            for (size_t i = 0; i < 3; i++) {
+                bytes[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + byte + i));
+            }
+            __m256i candidates = _mm256_setzero_si256();
+            for (unsigned shift = 0; shift < 8; shift++) {
+                __m256i match = _mm256_cmpeq_epi8(bytes[1], first[shift]);
+                __m256i other = _mm256_and_si256(bytes[anchors.secondIndex[shift]], secondMask[shift]);
+                candidates = _mm256_or_si256(candidates, _mm256_and_si256(match, _mm256_cmpeq_epi8(other, second[shift])));
+            }
+            for (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(candidates)); mask; mask &= mask - 1) {
+                pattern.matchByte(data, size, byte + __builtin_ctz(mask), from, to, positions);
+            }
+        }
+        return byte;
+    }
 
-            if(byteIndex+shiftByte > capacityInBytes) continue;
+#endif
 
-            uint16_t aux16 = buffer[byteIndex];
-            aux16 <<= shiftBit;
-            uint8_t carry = (aux16 >> 8) & 0xFF;
-            uint8_t value = aux16 & 0xFF;
+}
 
-            tempBuffer[byteIndex+shiftByte] |= carry;
-            tempBuffer[byteIndex+shiftByte-1] = value;
-        }
+void BitStream::search(const uint8_t* pattern, size_t patternLength, std::vector<size_t>& positions, size_t from, size_t to) const {
+    if (!pattern || patternLength == 0) {
+        throw std::invalid_argument("BitStream::search - The pattern is invalid or empty");
     }
-    std::memcpy(buffer.get(), tempBuffer.get(), capacityInBytes); 
-    return 0;
+    if (patternLength > capacity) {
+        return;
+    }
+    // Start positions of the occurrences that end within the stream
+    to = std::min(to, capacity - patternLength + 1);
+    if (from >= to) {
+        return;
+    }
+    BitPattern bitPattern(pattern, patternLength);
+    const size_t size = (capacity + 7) / 8;
+    const size_t lastByte = (to - 1) / 8 + 1;
+    size_t byte = from / 8;
+#if defined(__x86_64__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (patternLength >= 16) {
+        byte = avx2 ? scanAvx2(buffer, size, bitPattern, byte, lastByte, from, to, positions)
+                    : scanSse2(buffer, size, bitPattern, byte, lastByte, from, to, positions);
+    }
+#endif
+    for (; byte < lastByte; byte++) {
+        bitPattern.matchByte(buffer, size, byte, from, to, positions);
+    }
+}
+
+std::vector<size_t> BitStream::search(const uint8_t* pattern, size_t patternLength, size_t from, size_t to) const {
+    std::vector<size_t> positions;
+    search(pattern, patternLength, positions, from, to);
+    return positions;
 }
 
 std::string BitStream::to_string() const {
     return to_string(buffer, capacity);
 }
 
-std::string BitStream::to_string(const std::unique_ptr<uint8_t[]>& stream, size_t lengthInBits) {
+std::string BitStream::to_string(const uint8_t* stream, size_t lengthInBits) {
     std::ostringstream oss;
     int lengthInBytes = (lengthInBits + 7) / 8;
     int bitsInLastByte = 8-(lengthInBits % 8);
@@ -273,7 +574,7 @@ std::string BitStream::to_string() const {
 */
 
 
-size_t BitStream::base64_decode(const std::string& encoded_string, std::unique_ptr<uint8_t[]>& decoded_data) {
+size_t BitStream::base64_decoded_length(std::string_view encoded_string) {
     size_t input_length = encoded_string.length();
     if (input_length % 4 != 0) {
         throw std::invalid_argument("Invalid Base64 string length.");
@@ -282,10 +583,10 @@ size_t BitStream::base64_decode(const std::string& encoded_string, std::unique_p
     size_t padding = 0;
     if (input_length > 0 && encoded_string[input_length - 1] == '=') padding++;
     if (input_length > 1 && encoded_string[input_length - 2] == '=') padding++;
-    size_t output_length = (input_length / 4) * 3 - padding;
-
-    decoded_data = std::make_unique<uint8_t[]>(output_length);
+    return (input_length / 4) * 3 - padding;
+}
 
+void BitStream::base64_decode(std::string_view encoded_string, uint8_t* decoded_data, size_t output_length) {
     size_t output_index = 0;
     uint32_t buffer = 0;
     int bits_collected = 0;
@@ -304,9 +605,8 @@ size_t BitStream::base64_decode(const std::string& encoded_string, std::unique_p
         }
     }
     if (output_index != output_length) {
-        throw std::runtime_error("Decoding error: output length mismatch.");
+        throw std::invalid_argument("Decoding error: output length mismatch.");
     }
-    return output_length;
 };
 
 std::string BitStream::base64_encode(const uint8_t* data, size_t input_length) {
@@ -316,18 +616,19 @@ std::string BitStream::base64_encode(const uint8_t* data, size_t input_length) {
     uint32_t buffer = 0;
 
     while (i < input_length) {
+        size_t remaining = input_length - i;
         buffer = data[i++] << 16; 
-        if (i < input_length) buffer |= data[i++] << 8; 
-        if (i < input_length) buffer |= data[i++];     
+        if (remaining > 1) buffer |= data[i++] << 8; 
+        if (remaining > 2) buffer |= data[i++];     
 
         encoded_string.push_back(base64_chars[(buffer >> 18) & 0x3F]);
         encoded_string.push_back(base64_chars[(buffer >> 12) & 0x3F]);
-        if ((i - 2) < input_length) {
+        if (remaining > 1) {
             encoded_string.push_back(base64_chars[(buffer >> 6) & 0x3F]);
         } else {
             encoded_string.push_back('='); // Padding
         }
-        if ((i - 1) < input_length) {
+        if (remaining > 2) {
             encoded_string.push_back(base64_chars[buffer & 0x3F]);
         } else {
             encoded_string.push_back('='); // Padding
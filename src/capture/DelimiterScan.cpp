@@ -0,0 +1,73 @@
+#include "../../include/capture/DelimiterScan.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace opencmd;
+
+namespace {
+
+    void scanScalar(const uint8_t* data, size_t begin, size_t size, uint8_t delimiter, std::vector<uint64_t>& positions) {
+        for (size_t i = begin; i < size; i++) {
+            if (data[i] == delimiter) {
+                positions.push_back(i);
+            }
+        }
+    }
+
+    // One bit per byte equal to the delimiter: the positions are the set
+    // bits, lowest first
+    inline void appendMask(uint64_t mask, size_t base, std::vector<uint64_t>& positions) {
+        while (mask) {
+            positions.push_back(base + __builtin_ctzll(mask));
+            mask &= mask - 1;
+        }
+    }
+
+#if defined(__x86_64__)
+
+    void scanSse2(const uint8_t* data, size_t size, uint8_t delimiter, std::vector<uint64_t>& positions) {
+        const __m128i pattern = _mm_set1_epi8(static_cast<char>(delimiter));
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, pattern))) |
+                            static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, pattern))) << 16;
+            appendMask(mask, i, positions);
+        }
+        scanScalar(data, i, size, delimiter, positions);
+    }
+
+    __attribute__((target("avx2"))) void scanAvx2(const uint8_t* data, size_t size, uint8_t delimiter, std::vector<uint64_t>& positions) {
+        const __m256i pattern = _mm256_set1_epi8(static_cast<char>(delimiter));
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64) {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern))) |
+                            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)))) << 32;
+            appendMask(mask, i, positions);
+        }
+        scanScalar(data, i, size, delimiter, positions);
+    }
+
+#endif
+
+}
+
+void opencmd::findDelimiters(const uint8_t* data, size_t size, uint8_t delimiter, std::vector<uint64_t>& positions) {
+#if defined(__x86_64__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        scanAvx2(data, size, delimiter, positions);
+    } else {
+        scanSse2(data, size, delimiter, positions);
+    }
+#else
+    scanScalar(data, 0, size, delimiter, positions);
+#endif
+}
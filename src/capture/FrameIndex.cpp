@@ -0,0 +1,408 @@
+#include "../../include/capture/FrameIndex.hpp"
+#include "../../include/capture/DelimiterScan.hpp"
+#include "../../include/bitstream/BitStream.hpp"
+#include "../../include/catalog/SchemaCatalog.hpp"
+#include "../../include/catalog/SchemaSnapshot.hpp"
+#include "../../include/logger/Logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace opencmd;
+
+namespace {
+
+    constexpr char INDEX_MAGIC[8] = {'O','C','M','D','F','I','D','X'};
+    // Bytes before the end of the indexed part compared on update
+    constexpr size_t TAIL_BYTES = 4096;
+    // Newlines looked for at once
+    constexpr size_t SCAN_BLOCK = 4 << 20;
+
+    constexpr uint32_t FLAG_CLASSIFIED = 1;
+
+    struct IndexHeader {
+        char magic[8];
+        uint32_t formatVersion;
+        uint32_t captureType;
+        uint64_t frameSize;
+        uint64_t indexedBytes;
+        uint64_t tailChecksum;
+        uint64_t frameCount;
+        uint32_t schemaCount;
+        uint32_t flags;
+    };
+
+    static_assert(sizeof(FrameIndex::Entry) == 16, "FrameIndex::Entry is written as is");
+
+    uint32_t readLittleEndian32(const uint8_t* bytes) {
+        return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    }
+
+    bool isBlank(uint8_t c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+}
+
+void FrameIndex::clear() {
+    entries.clear();
+    timestamps.clear();
+    schemaNames.clear();
+    schemaNumbers.clear();
+    indexedBytes = 0;
+    tailChecksum = 0;
+}
+
+uint64_t FrameIndex::checksumTail(const uint8_t* data, size_t end) {
+    size_t begin = end > TAIL_BYTES ? end - TAIL_BYTES : 0;
+    return SchemaSnapshot::checksum(data + begin, end - begin);
+}
+
+uint16_t FrameIndex::schemaNumber(const std::string& name) {
+    auto found = schemaNumbers.find(name);
+    if (found != schemaNumbers.end()) {
+        return found->second;
+    }
+    if (schemaNames.size() >= UINT16_MAX) {
+        return NO_SCHEMA;
+    }
+    schemaNames.push_back(name);
+    uint16_t number = static_cast<uint16_t>(schemaNames.size());
+    schemaNumbers.emplace(name, number);
+    return number;
+}
+
+void FrameIndex::add(const CaptureFrame& frame, uint64_t bitLength, const uint8_t* bits) {
+    uint16_t schema = NO_SCHEMA;
+    if (classified && bits) {
+        BitStream bitStream = BitStream::view(bits, bitLength);
+        auto candidates = SchemaCatalog::getInstance().classify(bitStream);
+        if (candidates.size() == 1) {
+            auto found = SchemaCatalog::getInstance().getSchema(candidates.front());
+            if (found) {
+                schema = schemaNumber(found->getCatalogName());
+            }
+        }
+    }
+    entries.push_back({frame.offset, static_cast<uint32_t>(bitLength), schema, 0});
+    if (format.type == CaptureFormat::Type::CANDUMP) {
+        int64_t timestamp = parseTimestamp(frame.timestamp);
+        if (timestamp == 0 && !timestamps.empty()) {
+            timestamp = timestamps.back();
+        }
+        timestamps.push_back(timestamp);
+    }
+}
+
+size_t FrameIndex::update(const uint8_t* data, size_t size) {
+    if (indexedBytes > size || (indexedBytes > 0 && checksumTail(data, indexedBytes) != tailChecksum)) {
+        Logger::getInstance().info("Capture changed before the end of its index, indexing it again");
+        clear();
+    }
+    scanStart = indexedBytes;
+    size_t invalid;
+    switch (format.type) {
+        case CaptureFormat::Type::RAW:
+            invalid = scanRaw(data, size);
+            break;
+        case CaptureFormat::Type::LENGTH_PREFIXED:
+            invalid = scanLengthPrefixed(data, size);
+            break;
+        case CaptureFormat::Type::SYNC:
+            // Frames at bit positions: not indexed
+            invalid = 0;
+            break;
+        default:
+            invalid = scanLines(data, size);
+            break;
+    }
+    tailChecksum = checksumTail(data, indexedBytes);
+    return invalid;
+}
+
+size_t FrameIndex::scanRaw(const uint8_t* data, size_t size) {
+    if (format.frameSize == 0) {
+        return 0;
+    }
+    entries.reserve(entries.size() + (size - indexedBytes) / format.frameSize);
+    CaptureFrame frame;
+    for (size_t position = indexedBytes; size - position >= format.frameSize; position += format.frameSize) {
+        frame.offset = position;
+        add(frame, format.frameSize * 8, data + position);
+        indexedBytes = position + format.frameSize;
+    }
+    return 0;
+}
+
+size_t FrameIndex::scanLengthPrefixed(const uint8_t* data, size_t size) {
+    // Each prefix says where the next one is: nothing to search for, the
+    // frames are hopped over
+    size_t invalid = 0;
+    size_t position = indexedBytes;
+    CaptureFrame frame;
+    while (size - position >= 4) {
+        size_t bitLength = readLittleEndian32(data + position);
+        size_t byteLength = (bitLength + 7) / 8;
+        if (byteLength > size - position - 4) {
+            // Not completely written yet
+            break;
+        }
+        if (bitLength == 0) {
+            invalid++;
+        } else {
+            frame.offset = position;
+            add(frame, bitLength, data + position + 4);
+        }
+        position += 4 + byteLength;
+    }
+    indexedBytes = position;
+    return invalid;
+}
+
+size_t FrameIndex::scanLines(const uint8_t* data, size_t size) {
+    // Base64 frames not classified are not decoded: the length of a frame
+    // follows from the length of its line (the characters are checked when
+    // the frame is decoded). Candump lines, and frames to classify, are
+    // parsed by a FrameReader. A line without its newline is not complete
+    // yet, it is indexed by the next update
+    const bool parse = classified || format.type == CaptureFormat::Type::CANDUMP;
+    size_t invalid = 0;
+    size_t lineStart = indexedBytes;
+    std::vector<uint64_t> newlines;
+    CaptureFrame frame;
+    for (size_t block = indexedBytes; block < size; block += SCAN_BLOCK) {
+        size_t blockSize = std::min(SCAN_BLOCK, size - block);
+        newlines.clear();
+        findDelimiters(data + block, blockSize, '\n', newlines);
+        if (entries.capacity() < entries.size() + newlines.size()) {
+            // Room for the rest of the capture, if its lines are like these
+            size_t expected = entries.size() + newlines.size() + newlines.size() * (size - block - blockSize) / blockSize;
+            entries.reserve(std::max(expected, 2 * entries.capacity()));
+        }
+        for (uint64_t newline : newlines) {
+            size_t lineEnd = block + newline;
+            if (parse) {
+                FrameReader reader(data, lineStart, lineEnd + 1, format);
+                int retVal = reader.next(frame);
+                if (retVal == FrameReader::STATUS_OK) {
+                    add(frame, frame.bitLength, frame.data);
+                } else if (retVal != FrameReader::END_OF_RANGE) {
+                    invalid++;
+                }
+            } else {
+                size_t begin = lineStart;
+                size_t end = lineEnd;
+                while (end > begin && isBlank(data[end - 1])) {
+                    end--;
+                }
+                while (begin < end && isBlank(data[begin])) {
+                    begin++;
+                }
+                size_t length = end - begin;
+                size_t padding = 0;
+                while (padding < 2 && padding < length && data[end - 1 - padding] == '=') {
+                    padding++;
+                }
+                if (length > 0 && (length % 4 != 0 || length / 4 * 3 == padding)) {
+                    invalid++;
+                } else if (length > 0) {
+                    frame.offset = lineStart;
+                    add(frame, (length / 4 * 3 - padding) * 8, nullptr);
+                }
+            }
+            lineStart = lineEnd + 1;
+        }
+    }
+    indexedBytes = lineStart;
+    return invalid;
+}
+
+std::string_view FrameIndex::getSchemaName(const Entry& entry) const {
+    if (entry.schema == NO_SCHEMA || entry.schema > schemaNames.size()) {
+        return std::string_view();
+    }
+    return schemaNames[entry.schema - 1];
+}
+
+size_t FrameIndex::findOffset(uint64_t offset) const {
+    auto found = std::lower_bound(entries.begin(), entries.end(), offset,
+                                  [](const Entry& entry, uint64_t value) { return entry.offset < value; });
+    return static_cast<size_t>(found - entries.begin());
+}
+
+size_t FrameIndex::findTime(int64_t microseconds) const {
+    if (timestamps.empty()) {
+        return entries.size();
+    }
+    return static_cast<size_t>(std::lower_bound(timestamps.begin(), timestamps.end(), microseconds) - timestamps.begin());
+}
+
+uint64_t FrameIndex::frameEnd(size_t frame) const {
+    const Entry& entry = entries[frame];
+    switch (format.type) {
+        case CaptureFormat::Type::RAW:
+            return entry.offset + format.frameSize;
+        case CaptureFormat::Type::LENGTH_PREFIXED:
+            return entry.offset + 4 + (uint64_t(entry.bitLength) + 7) / 8;
+        default:
+            return frame + 1 < entries.size() ? entries[frame + 1].offset : indexedBytes;
+    }
+}
+
+std::vector<size_t> FrameIndex::chunkBoundaries(size_t first, size_t last, size_t chunkBytes) const {
+    last = std::min(last, entries.size());
+    if (first >= last) {
+        return {first < entries.size() ? entries[first].offset : indexedBytes};
+    }
+    chunkBytes = std::max<size_t>(chunkBytes, 1);
+    std::vector<size_t> boundaries{entries[first].offset};
+    for (size_t frame = first + 1; frame < last; frame++) {
+        if (entries[frame].offset - boundaries.back() >= chunkBytes) {
+            boundaries.push_back(entries[frame].offset);
+        }
+    }
+    boundaries.push_back(frameEnd(last - 1));
+    return boundaries;
+}
+
+int64_t FrameIndex::parseTimestamp(std::string_view text) {
+    int64_t seconds = 0;
+    int64_t fraction = 0;
+    size_t position = 0;
+    if (text.empty()) {
+        return 0;
+    }
+    for (; position < text.size() && text[position] != '.'; position++) {
+        if (text[position] < '0' || text[position] > '9') {
+            return 0;
+        }
+        seconds = seconds * 10 + (text[position] - '0');
+    }
+    int digits = 0;
+    for (position++; position < text.size(); position++) {
+        if (text[position] < '0' || text[position] > '9') {
+            return 0;
+        }
+        if (digits < 6) {
+            fraction = fraction * 10 + (text[position] - '0');
+            digits++;
+        }
+    }
+    for (; digits < 6; digits++) {
+        fraction *= 10;
+    }
+    return seconds * 1000000 + fraction;
+}
+
+int FrameIndex::write(const std::string& path) const {
+    IndexHeader header;
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.formatVersion = FORMAT_VERSION;
+    header.captureType = static_cast<uint32_t>(format.type);
+    header.frameSize = format.frameSize;
+    header.indexedBytes = indexedBytes;
+    header.tailChecksum = tailChecksum;
+    header.frameCount = entries.size();
+    header.schemaCount = static_cast<uint32_t>(schemaNames.size());
+    header.flags = classified ? FLAG_CLASSIFIED : 0;
+
+    std::string content;
+    content.reserve(sizeof(header) + entries.size() * sizeof(Entry) + timestamps.size() * sizeof(int64_t) + sizeof(uint64_t));
+    content.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    content.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    content.append(reinterpret_cast<const char*>(timestamps.data()), timestamps.size() * sizeof(int64_t));
+    for (const auto& name : schemaNames) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        content.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        content.append(name);
+    }
+    uint64_t checksum = SchemaSnapshot::checksum(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+    content.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+    // Written whole to a temporary file and renamed: a reader never sees a
+    // partial index, even while the capture is indexed again
+    std::string tempPath = path + ".tmp";
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        Logger::getInstance().error("Impossible to open index file <" + tempPath + "> for writing");
+        return ERROR_OPEN;
+    }
+    output.write(content.data(), content.size());
+    output.close();
+    if (!output || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        Logger::getInstance().error("Error writing index file <" + path + ">");
+        std::remove(tempPath.c_str());
+        return ERROR_WRITE;
+    }
+    return STATUS_OK;
+}
+
+int FrameIndex::read(const std::string& path, const CaptureFormat& expected) {
+    format = expected;
+    clear();
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        Logger::getInstance().info("Index file <" + path + "> not available");
+        return ERROR_OPEN;
+    }
+    std::string content(static_cast<size_t>(input.tellg()), '\0');
+    input.seekg(0);
+    input.read(content.data(), content.size());
+
+    IndexHeader header;
+    uint64_t checksum = 0;
+    if (!input || content.size() < sizeof(header) + sizeof(checksum)) {
+        Logger::getInstance().warning("Index file <" + path + "> is truncated");
+        return ERROR_INVALID_INDEX;
+    }
+    std::memcpy(&header, content.data(), sizeof(header));
+    std::memcpy(&checksum, content.data() + content.size() - sizeof(checksum), sizeof(checksum));
+    const uint8_t* cursor = reinterpret_cast<const uint8_t*>(content.data()) + sizeof(header);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(content.data()) + content.size() - sizeof(checksum);
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0 || header.formatVersion != FORMAT_VERSION) {
+        Logger::getInstance().warning("Index file <" + path + "> has an unknown format");
+        return ERROR_INVALID_INDEX;
+    }
+    if (SchemaSnapshot::checksum(reinterpret_cast<const uint8_t*>(content.data()), content.size() - sizeof(checksum)) != checksum) {
+        Logger::getInstance().warning("Index file <" + path + "> is corrupted (checksum mismatch)");
+        return ERROR_INVALID_INDEX;
+    }
+    if (header.captureType != static_cast<uint32_t>(expected.type) || header.frameSize != expected.frameSize) {
+        Logger::getInstance().info("Index file <" + path + "> is of another capture format");
+        return ERROR_INVALID_INDEX;
+    }
+
+    size_t timestampCount = expected.type == CaptureFormat::Type::CANDUMP ? header.frameCount : 0;
+    size_t fixedBytes = header.frameCount * sizeof(Entry) + timestampCount * sizeof(int64_t);
+    if (header.frameCount > static_cast<size_t>(end - cursor) / sizeof(Entry) || fixedBytes > static_cast<size_t>(end - cursor)) {
+        Logger::getInstance().warning("Index file <" + path + "> is truncated");
+        return ERROR_INVALID_INDEX;
+    }
+    classified = (header.flags & FLAG_CLASSIFIED) != 0;
+    entries.resize(header.frameCount);
+    std::memcpy(entries.data(), cursor, entries.size() * sizeof(Entry));
+    cursor += entries.size() * sizeof(Entry);
+    timestamps.resize(timestampCount);
+    std::memcpy(timestamps.data(), cursor, timestamps.size() * sizeof(int64_t));
+    cursor += timestamps.size() * sizeof(int64_t);
+    for (uint32_t i = 0; i < header.schemaCount; i++) {
+        uint32_t length = 0;
+        if (static_cast<size_t>(end - cursor) < sizeof(length)) {
+            clear();
+            return ERROR_INVALID_INDEX;
+        }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (static_cast<size_t>(end - cursor) < length) {
+            clear();
+            return ERROR_INVALID_INDEX;
+        }
+        schemaNumber(std::string(reinterpret_cast<const char*>(cursor), length));
+        cursor += length;
+    }
+    indexedBytes = header.indexedBytes;
+    tailChecksum = header.tailChecksum;
+    return STATUS_OK;
+}
@@ -0,0 +1,435 @@
+#include "../../include/capture/FrameReader.hpp"
+#include "../../include/bitstream/BitStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace opencmd;
+
+namespace {
+
+    int hexDigit(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool parseHexNumber(std::string_view text, uint32_t& value) {
+        if (text.empty() || text.size() > 8) {
+            return false;
+        }
+        value = 0;
+        for (char c : text) {
+            int digit = hexDigit(c);
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    // Next token separated by blanks, advancing <position>
+    std::string_view nextToken(std::string_view line, size_t& position) {
+        while (position < line.size() && (line[position] == ' ' || line[position] == '\t')) {
+            position++;
+        }
+        size_t start = position;
+        while (position < line.size() && line[position] != ' ' && line[position] != '\t') {
+            position++;
+        }
+        return line.substr(start, position - start);
+    }
+
+    uint32_t readLittleEndian32(const uint8_t* bytes) {
+        return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    }
+
+    // Sync words looked for at once, in bits
+    constexpr size_t SYNC_WINDOW = size_t(8) << 20;
+
+    // Bits [bitStart, bitStart + bitLength) of <data> (<size> bytes), byte
+    // aligned into <output>
+    void copyBits(const uint8_t* data, size_t size, size_t bitStart, size_t bitLength, std::vector<uint8_t>& output) {
+        size_t bytes = (bitLength + 7) / 8;
+        size_t first = bitStart / 8;
+        unsigned shift = bitStart % 8;
+        output.resize(bytes);
+        for (size_t i = 0; i < bytes; i++) {
+            uint8_t high = static_cast<uint8_t>(data[first + i] << shift);
+            uint8_t low = shift && first + i + 1 < size ? static_cast<uint8_t>(data[first + i + 1] >> (8 - shift)) : 0;
+            output[i] = high | low;
+        }
+        if (bitLength % 8) {
+            output[bytes - 1] &= static_cast<uint8_t>(0xFF << (8 - bitLength % 8));
+        }
+    }
+
+}
+
+std::optional<CaptureFormat::Type> CaptureFormat::parse(const std::string& name) {
+    if (name == "raw") {
+        return Type::RAW;
+    }
+    if (name == "length-prefixed") {
+        return Type::LENGTH_PREFIXED;
+    }
+    if (name == "base64") {
+        return Type::BASE64_LINES;
+    }
+    if (name == "candump") {
+        return Type::CANDUMP;
+    }
+    if (name == "sync") {
+        return Type::SYNC;
+    }
+    return std::nullopt;
+}
+
+bool CaptureFormat::parseSyncWord(const std::string& text) {
+    size_t slash = text.find('/');
+    std::string_view digits = std::string_view(text).substr(0, slash);
+    if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        digits.remove_prefix(2);
+    }
+    if (digits.empty()) {
+        return false;
+    }
+    std::vector<uint8_t> bytes((digits.size() + 1) / 2, 0);
+    for (size_t i = 0; i < digits.size(); i++) {
+        int digit = hexDigit(digits[i]);
+        if (digit < 0) {
+            return false;
+        }
+        bytes[i / 2] |= static_cast<uint8_t>(i % 2 ? digit : digit << 4);
+    }
+    size_t bits = digits.size() * 4;
+    if (slash != std::string::npos) {
+        size_t length = 0;
+        for (char c : text.substr(slash + 1)) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            length = length * 10 + (c - '0');
+        }
+        if (length == 0 || length > bits) {
+            return false;
+        }
+        bits = length;
+    }
+    syncWord = std::move(bytes);
+    syncBits = bits;
+    return true;
+}
+
+FrameReader::FrameReader(const uint8_t* data, size_t begin, size_t end, const CaptureFormat& format, size_t limit)
+    : data(data), position(begin), end(end), limit(std::max(limit, end)), format(format), bitPosition(begin * 8), syncSearched(begin * 8) {}
+
+int FrameReader::next(CaptureFrame& frame) {
+    switch (format.type) {
+        case CaptureFormat::Type::RAW:
+            return nextRaw(frame);
+        case CaptureFormat::Type::LENGTH_PREFIXED:
+            return nextLengthPrefixed(frame);
+        case CaptureFormat::Type::SYNC:
+            return nextSync(frame);
+        default:
+            return nextLine(frame);
+    }
+}
+
+int FrameReader::nextRaw(CaptureFrame& frame) {
+    if (position >= end) {
+        return END_OF_RANGE;
+    }
+    frame.offset = position;
+    if (format.frameSize == 0 || end - position < format.frameSize) {
+        // Truncated last frame
+        position = end;
+        return ERROR_INVALID_FRAME;
+    }
+    frame.data = data + position;
+    frame.bitLength = format.frameSize * 8;
+    position += format.frameSize;
+    return STATUS_OK;
+}
+
+int FrameReader::nextLengthPrefixed(CaptureFrame& frame) {
+    if (position >= end) {
+        return END_OF_RANGE;
+    }
+    frame.offset = position;
+    if (end - position < 4) {
+        position = end;
+        return ERROR_INVALID_FRAME;
+    }
+    size_t bitLength = readLittleEndian32(data + position);
+    size_t byteLength = (bitLength + 7) / 8;
+    if (byteLength > end - position - 4) {
+        position = end;
+        return ERROR_INVALID_FRAME;
+    }
+    position += 4 + byteLength;
+    if (bitLength == 0) {
+        return ERROR_INVALID_FRAME;
+    }
+    frame.data = data + frame.offset + 4;
+    frame.bitLength = bitLength;
+    return STATUS_OK;
+}
+
+int FrameReader::nextLine(CaptureFrame& frame) {
+    while (position < end) {
+        const char* start = reinterpret_cast<const char*>(data + position);
+        const void* newline = std::memchr(start, '\n', end - position);
+        size_t length = newline ? static_cast<const char*>(newline) - start : end - position;
+        std::string_view line(start, length);
+        frame.offset = position;
+        position += newline ? length + 1 : length;
+
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.remove_suffix(1);
+        }
+        while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+            line.remove_prefix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        return format.type == CaptureFormat::Type::CANDUMP ? parseCandump(line, frame) : parseBase64(line, frame);
+    }
+    return END_OF_RANGE;
+}
+
+int FrameReader::parseBase64(std::string_view line, CaptureFrame& frame) {
+    try {
+        payload.resize(BitStream::base64_decoded_length(line));
+        BitStream::base64_decode(line, payload.data(), payload.size());
+    } catch (const std::exception&) {
+        return ERROR_INVALID_FRAME;
+    }
+    if (payload.empty()) {
+        return ERROR_INVALID_FRAME;
+    }
+    frame.data = payload.data();
+    frame.bitLength = payload.size() * 8;
+    return STATUS_OK;
+}
+
+int FrameReader::parseCandump(std::string_view line, CaptureFrame& frame) {
+    size_t cursor = 0;
+    frame.timestamp = std::string_view();
+    if (line.front() == '(') {
+        size_t close = line.find(')');
+        if (close == std::string_view::npos) {
+            return ERROR_INVALID_FRAME;
+        }
+        frame.timestamp = line.substr(1, close - 1);
+        cursor = close + 1;
+    }
+    frame.interface = nextToken(line, cursor);
+    std::string_view identifier = nextToken(line, cursor);
+    payload.clear();
+
+    size_t hash = identifier.find('#');
+    if (hash != std::string_view::npos) {
+        // Log format: <id>#<data>, or <id>##<flags><data> for CAN FD
+        std::string_view bytes = identifier.substr(hash + 1);
+        identifier = identifier.substr(0, hash);
+        if (!bytes.empty() && bytes.front() == '#') {
+            if (bytes.size() < 2) {
+                return ERROR_INVALID_FRAME;
+            }
+            bytes.remove_prefix(2);
+        }
+        int high = -1;
+        for (char c : bytes) {
+            if (c == '.') {
+                continue;
+            }
+            int digit = hexDigit(c);
+            if (digit < 0) {
+                // Remote request (R) or garbage
+                return ERROR_INVALID_FRAME;
+            }
+            if (high < 0) {
+                high = digit;
+            } else {
+                payload.push_back(static_cast<uint8_t>(high << 4 | digit));
+                high = -1;
+            }
+        }
+        if (high >= 0) {
+            return ERROR_INVALID_FRAME;
+        }
+    } else {
+        // Screen format: <id> [<length>] <byte> <byte> ...
+        std::string_view length = nextToken(line, cursor);
+        if (length.size() < 3 || length.front() != '[' || length.back() != ']') {
+            return ERROR_INVALID_FRAME;
+        }
+        size_t count = 0;
+        for (char c : length.substr(1, length.size() - 2)) {
+            if (c < '0' || c > '9') {
+                return ERROR_INVALID_FRAME;
+            }
+            count = count * 10 + (c - '0');
+        }
+        for (size_t i = 0; i < count; i++) {
+            std::string_view byte = nextToken(line, cursor);
+            uint32_t value = 0;
+            if (byte.size() != 2 || !parseHexNumber(byte, value)) {
+                return ERROR_INVALID_FRAME;
+            }
+            payload.push_back(static_cast<uint8_t>(value));
+        }
+    }
+    if (!parseHexNumber(identifier, frame.canId) || payload.empty()) {
+        return ERROR_INVALID_FRAME;
+    }
+    frame.data = payload.data();
+    frame.bitLength = payload.size() * 8;
+    return STATUS_OK;
+}
+
+size_t FrameReader::findSync(size_t from) {
+    const size_t limitBits = limit * 8;
+    while (true) {
+        while (syncCursor < syncPositions.size() && syncPositions[syncCursor] < from) {
+            syncCursor++;
+        }
+        if (syncCursor < syncPositions.size()) {
+            return syncPositions[syncCursor];
+        }
+        if (syncSearched >= limitBits || format.syncBits == 0) {
+            return NO_SYNC;
+        }
+        // Up to the end of the range, then (the end of its last frame)
+        // windows growing from a few bytes
+        size_t searchFrom = std::max(syncSearched, from);
+        size_t searchTo = searchFrom < end * 8 ? std::min(end * 8, searchFrom + SYNC_WINDOW)
+                                               : searchFrom + std::min(SYNC_WINDOW, std::max<size_t>(4096, searchFrom - end * 8));
+        syncSearched = std::min(limitBits, searchTo);
+        syncPositions.clear();
+        syncCursor = 0;
+        BitStream::view(data, limitBits).search(format.syncWord.data(), format.syncBits, syncPositions, searchFrom, syncSearched);
+    }
+}
+
+int FrameReader::locateSync(size_t& sync, size_t& bitStart, size_t& bitEnd) {
+    const size_t limitBits = limit * 8;
+    sync = bitPosition < end * 8 ? findSync(bitPosition) : NO_SYNC;
+    if (sync == NO_SYNC || sync >= end * 8) {
+        bitPosition = std::max(bitPosition, end * 8);
+        position = end;
+        return END_OF_RANGE;
+    }
+    bitStart = format.keepSync ? sync : sync + format.syncBits;
+    if (format.frameBits) {
+        bitEnd = bitStart + format.frameBits;
+    } else {
+        // Up to the next sync word (not one overlapping this one)
+        size_t next = findSync(sync + format.syncBits);
+        bitEnd = next == NO_SYNC ? limitBits : next;
+    }
+    // The next sync word after the frame
+    bitPosition = bitEnd;
+    position = std::min(end, (bitPosition + 7) / 8);
+    if (bitEnd > limitBits || bitEnd <= bitStart) {
+        // Truncated, or nothing after the sync word
+        return ERROR_INVALID_FRAME;
+    }
+    return STATUS_OK;
+}
+
+int FrameReader::nextSync(CaptureFrame& frame) {
+    size_t sync, bitStart, bitEnd;
+    int retVal = locateSync(sync, bitStart, bitEnd);
+    if (retVal == END_OF_RANGE) {
+        return retVal;
+    }
+    frame.offset = sync;
+    if (retVal != STATUS_OK) {
+        return retVal;
+    }
+    copyBits(data, limit, bitStart, bitEnd - bitStart, payload);
+    frame.data = payload.data();
+    frame.bitLength = bitEnd - bitStart;
+    return STATUS_OK;
+}
+
+std::vector<size_t> FrameReader::chunkBoundaries(const uint8_t* data, size_t size, size_t chunkBytes, const CaptureFormat& format) {
+    std::vector<size_t> boundaries{0};
+    if (size == 0) {
+        return boundaries;
+    }
+    chunkBytes = std::max<size_t>(chunkBytes, 1);
+    switch (format.type) {
+        case CaptureFormat::Type::RAW: {
+            size_t step = format.frameSize == 0 ? size : std::max(format.frameSize, chunkBytes / format.frameSize * format.frameSize);
+            for (size_t boundary = step; boundary < size; boundary += step) {
+                boundaries.push_back(boundary);
+            }
+            break;
+        }
+        case CaptureFormat::Type::LENGTH_PREFIXED: {
+            // Only the prefixes are read, from frame to frame
+            size_t position = 0;
+            size_t chunkStart = 0;
+            while (size - position >= 4) {
+                size_t next = position + 4 + (readLittleEndian32(data + position) + size_t(7)) / 8;
+                if (next >= size) {
+                    break;
+                }
+                position = next;
+                if (position - chunkStart >= chunkBytes) {
+                    boundaries.push_back(position);
+                    chunkStart = position;
+                }
+            }
+            break;
+        }
+        case CaptureFormat::Type::SYNC: {
+            // On the byte of a sync word starting a frame, when no other
+            // sync word starts in that byte before it: the reader of the
+            // next chunk starts from the same frame
+            FrameReader reader(data, 0, size, format);
+            size_t chunkStart = 0;
+            size_t sync, bitStart, bitEnd;
+            while (reader.locateSync(sync, bitStart, bitEnd) != END_OF_RANGE) {
+                size_t boundary = sync / 8;
+                if (boundary - chunkStart >= chunkBytes && boundary > chunkStart &&
+                    BitStream::view(data, size * 8).search(format.syncWord.data(), format.syncBits, boundary * 8, sync).empty()) {
+                    boundaries.push_back(boundary);
+                    chunkStart = boundary;
+                }
+            }
+            break;
+        }
+        default: {
+            // After the first newline past every <chunkBytes> bytes
+            size_t boundary = 0;
+            while (size - boundary > chunkBytes) {
+                const void* newline = std::memchr(data + boundary + chunkBytes, '\n', size - boundary - chunkBytes);
+                if (!newline) {
+                    break;
+                }
+                boundary = static_cast<const uint8_t*>(newline) - data + 1;
+                if (boundary >= size) {
+                    break;
+                }
+                boundaries.push_back(boundary);
+            }
+            break;
+        }
+    }
+    boundaries.push_back(size);
+    return boundaries;
+}
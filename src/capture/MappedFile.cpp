@@ -0,0 +1,60 @@
+#include "../../include/capture/MappedFile.hpp"
+#include "../../include/logger/Logger.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+int MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Logger::getInstance().error("Impossible to open <" + path + ">");
+        return ERROR_OPEN;
+    }
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0) {
+        Logger::getInstance().error("Impossible to read the size of <" + path + ">");
+        ::close(fd);
+        return ERROR_OPEN;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    if (fileSize == 0) {
+        ::close(fd);
+        return STATUS_OK;
+    }
+    void* mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        Logger::getInstance().error("Impossible to map <" + path + ">");
+        return ERROR_MAP;
+    }
+    // Read front to back, by chunks: a larger read ahead
+    ::madvise(mapped, fileSize, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(mapped);
+    size = fileSize;
+    return STATUS_OK;
+}
+
+void MappedFile::close() {
+    if (data) {
+        ::munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::release(size_t begin, size_t end) const {
+    // Whole pages inside the range only
+    size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t first = (begin + pageSize - 1) / pageSize * pageSize;
+    size_t last = std::min(end, size) / pageSize * pageSize;
+    if (data && first < last) {
+        ::madvise(const_cast<uint8_t*>(data) + first, last - first, MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,83 @@
+#include "../../include/catalog/CatalogWatcher.hpp"
+#include "../../include/catalog/SchemaCatalog.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+namespace {
+    constexpr int POLL_INTERVAL_MS = 100;
+}
+
+int CatalogWatcher::start() {
+    if (running) {
+        return 0;
+    }
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        Logger::getInstance().error("Impossible to initialize inotify: " + std::string(std::strerror(errno)));
+        return 1;
+    }
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+    if (inotify_add_watch(inotifyFd, directory.c_str(), mask) < 0) {
+        Logger::getInstance().error("Impossible to watch catalog directory <" + directory + ">: " + std::string(std::strerror(errno)));
+        close(inotifyFd);
+        inotifyFd = -1;
+        return 2;
+    }
+    running = true;
+    watcherThread = std::thread(&CatalogWatcher::run, this);
+    Logger::getInstance().info("Watching catalog directory <" + directory + "> for changes");
+    return 0;
+}
+
+void CatalogWatcher::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (watcherThread.joinable()) {
+        watcherThread.join();
+    }
+    close(inotifyFd);
+    inotifyFd = -1;
+}
+
+void CatalogWatcher::run() {
+    alignas(struct inotify_event) char buffer[4096];
+    bool pendingReload = false;
+    auto lastEvent = std::chrono::steady_clock::now();
+
+    while (running) {
+        struct pollfd pfd = { inotifyFd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (ready > 0 && (pfd.revents & POLLIN)) {
+            ssize_t length;
+            while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + length; ) {
+                    auto event = reinterpret_cast<const struct inotify_event*>(ptr);
+                    // Only schema files matter (snapshots or editor swap
+                    // files written in the same directory are ignored)
+                    std::string fileName = event->len ? std::string(event->name) : std::string();
+                    if (fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0) {
+                        OPENCMD_LOG_DEBUG("Catalog file <" + fileName + "> changed");
+                        pendingReload = true;
+                        lastEvent = std::chrono::steady_clock::now();
+                    }
+                    ptr += sizeof(struct inotify_event) + event->len;
+                }
+            }
+        } else if (ready < 0 && errno != EINTR) {
+            Logger::getInstance().error("Error polling the catalog directory watcher: " + std::string(std::strerror(errno)));
+            break;
+        }
+
+        if (pendingReload && std::chrono::steady_clock::now() - lastEvent >= debounce) {
+            pendingReload = false;
+            SchemaCatalog::getInstance().reload();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "../../include/catalog/DecoderContext.hpp"
+
+using namespace opencmd;
+
+TreeNode* DecoderContext::acquireTree(SchemaId id) {
+    if (id == INVALID_SCHEMA_ID) {
+        return nullptr;
+    }
+    if (id >= trees.size()) {
+        // The id comes from the client: the cache grows only for the ids of
+        // the catalog (assigned densely)
+        if (!SchemaCatalog::getInstance().getSchema(id)) {
+            return nullptr;
+        }
+        trees.resize(id + 1);
+    }
+    CachedTree& cached = trees[id];
+
+    // Fast path: the catalog has not changed since the last message
+    uint64_t generation = SchemaCatalog::getInstance().getGeneration();
+    if (cached.tree && cached.generation == generation) {
+        return cached.tree.get();
+    }
+
+    auto schema = SchemaCatalog::getInstance().getSchema(id);
+    if (!schema) {
+        cached = CachedTree();
+        return nullptr;
+    }
+    if (schema != cached.schema) {
+        cached.tree = schema->getAbstractTree()->clone();
+        cached.pathTable.reset();
+        cached.schema = schema;
+    }
+    cached.generation = generation;
+    return cached.tree.get();
+}
+
+const PathTable* DecoderContext::acquirePathTable(SchemaId id) {
+    TreeNode* tree = acquireTree(id);
+    if (!tree) {
+        return nullptr;
+    }
+    CachedTree& cached = trees[id];
+    if (!cached.pathTable) {
+        cached.pathTable = std::make_unique<PathTable>(PathTable::build(*cached.schema->getAbstractTree()));
+    }
+    return cached.pathTable.get();
+}
+
+int DecoderContext::bitstream_to_json(SchemaId id, BitStream& bitStream, nlohmann::ordered_json& outputJson) {
+    // Input errors of the tree are reported against the schema
+    ErrorReporter::SchemaScope scope(id);
+    TreeNode* tree = acquireTree(id);
+    if (!tree) {
+        OPENCMD_REPORT_WARNING("Unknown schema id", "Requested schema id <" + std::to_string(id) + "> does not exist in the loaded catalog");
+        return ERROR_UNKNOWN_SCHEMA;
+    }
+    if (NodeProfiler::sample()) {
+        NodeProfiler::MessageScope profile(id, trees[id].schema->getCatalogName(), NodeProfiler::Operation::DECODE, bitStream);
+        return tree->bitstream_to_json(bitStream, outputJson);
+    }
+    return tree->bitstream_to_json(bitStream, outputJson);
+}
+
+int DecoderContext::json_to_bitstream(SchemaId id, const nlohmann::json& inputJson, BitStream& bitStream) {
+    ErrorReporter::SchemaScope scope(id);
+    TreeNode* tree = acquireTree(id);
+    if (!tree) {
+        OPENCMD_REPORT_WARNING("Unknown schema id", "Requested schema id <" + std::to_string(id) + "> does not exist in the loaded catalog");
+        return ERROR_UNKNOWN_SCHEMA;
+    }
+    if (NodeProfiler::sample()) {
+        NodeProfiler::MessageScope profile(id, trees[id].schema->getCatalogName(), NodeProfiler::Operation::ENCODE, bitStream);
+        return tree->json_to_bitstream(inputJson, bitStream);
+    }
+    return tree->json_to_bitstream(inputJson, bitStream);
+}
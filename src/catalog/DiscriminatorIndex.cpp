@@ -0,0 +1,177 @@
+#include "../../include/catalog/DiscriminatorIndex.hpp"
+
+#include <algorithm>
+
+using namespace opencmd;
+
+void DiscriminatorIndex::collectConstraints(const TreeNode& root, SchemaConstraints& schemaConstraints) {
+    // Only the fields before the first variable length node have a fixed
+    // offset in every message of the schema
+    size_t bitOffset = 0;
+    for (const auto& child : root.getChildren()) {
+        auto integerNode = std::dynamic_pointer_cast<const NodeUnsignedInteger>(child);
+        if (integerNode && !integerNode->getAllowedValues().empty() && integerNode->getBitLength() > 0) {
+            Constraint constraint;
+            constraint.key.bitOffset = bitOffset;
+            constraint.key.bitLength = integerNode->getBitLength();
+            constraint.key.endianness = integerNode->getEndianness();
+            constraint.values = integerNode->getAllowedValues();
+            schemaConstraints.constraints.push_back(constraint);
+        }
+        auto childLength = child->getFixedBitLength();
+        if (!childLength) {
+            break;
+        }
+        bitOffset += childLength.value();
+    }
+}
+
+DiscriminatorIndex DiscriminatorIndex::build(const std::vector<std::shared_ptr<const Schema>>& schemasById) {
+    std::vector<SchemaConstraints> allConstraints;
+    for (const auto& schema : schemasById) {
+        if (!schema || !schema->getAbstractTree()) {
+            continue;
+        }
+        SchemaConstraints schemaConstraints;
+        schemaConstraints.id = schema->getId();
+        collectConstraints(*schema->getAbstractTree(), schemaConstraints);
+        allConstraints.push_back(schemaConstraints);
+    }
+
+    DiscriminatorIndex index;
+    if (allConstraints.empty()) {
+        return index;
+    }
+
+    // The most specific schemas come first among the candidates
+    std::stable_sort(allConstraints.begin(), allConstraints.end(), [](const SchemaConstraints& a, const SchemaConstraints& b) {
+        return a.constraints.size() > b.constraints.size();
+    });
+    for (const auto& schemaConstraints : allConstraints) {
+        index.schemaOrder.push_back(schemaConstraints.id);
+    }
+    const size_t words = (allConstraints.size() + 63) / 64;
+
+    // Group the constraints by field
+    struct KeyUse {
+        FieldKey key;
+        size_t slot;
+        const Constraint* constraint;
+    };
+    std::vector<KeyUse> uses;
+    for (size_t slot = 0; slot < allConstraints.size(); slot++) {
+        for (const auto& constraint : allConstraints[slot].constraints) {
+            uses.push_back({constraint.key, slot, &constraint});
+        }
+    }
+    auto keyLess = [](const FieldKey& a, const FieldKey& b) {
+        if (a.bitOffset != b.bitOffset) {
+            return a.bitOffset < b.bitOffset;
+        }
+        if (a.bitLength != b.bitLength) {
+            return a.bitLength < b.bitLength;
+        }
+        return a.endianness < b.endianness;
+    };
+    std::stable_sort(uses.begin(), uses.end(), [&](const KeyUse& a, const KeyUse& b) { return keyLess(a.key, b.key); });
+
+    struct KeyGroup {
+        size_t begin;
+        size_t end;
+    };
+    std::vector<KeyGroup> groups;
+    for (size_t i = 0; i < uses.size();) {
+        size_t j = i + 1;
+        while (j < uses.size() && uses[j].key == uses[i].key) {
+            j++;
+        }
+        groups.push_back({i, j});
+        i = j;
+    }
+    // The fields constraining most schemas are indexed first
+    std::stable_sort(groups.begin(), groups.end(), [](const KeyGroup& a, const KeyGroup& b) {
+        return a.end - a.begin > b.end - b.begin;
+    });
+
+    size_t entries = 0;
+    for (const auto& group : groups) {
+        if (index.tables.size() == MAX_KEYS) {
+            break;
+        }
+        KeyTable table;
+        table.key = uses[group.begin].key;
+        table.unconstrained.assign(words, 0);
+        for (size_t slot = 0; slot < allConstraints.size(); slot++) {
+            table.unconstrained[slot / 64] |= uint64_t(1) << (slot % 64);
+        }
+        for (size_t i = group.begin; i < group.end; i++) {
+            const size_t slot = uses[i].slot;
+            table.unconstrained[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+            for (uint64_t value : uses[i].constraint->values) {
+                auto& allowed = table.allowed[value];
+                if (allowed.empty()) {
+                    allowed.assign(words, 0);
+                }
+                allowed[slot / 64] |= uint64_t(1) << (slot % 64);
+            }
+        }
+        if (entries + table.allowed.size() > MAX_ENTRIES) {
+            continue;
+        }
+        entries += table.allowed.size();
+        // A value also lets through the schemas not constraining the field
+        for (auto& [value, allowed] : table.allowed) {
+            for (size_t word = 0; word < words; word++) {
+                allowed[word] |= table.unconstrained[word];
+            }
+        }
+        index.tables.push_back(std::move(table));
+    }
+    return index;
+}
+
+std::vector<SchemaId> DiscriminatorIndex::classify(const BitStream& bitStream) const {
+    if (schemaOrder.empty()) {
+        return {};
+    }
+    const size_t words = (schemaOrder.size() + 63) / 64;
+    SchemaSet candidates(words, ~uint64_t(0));
+    if (schemaOrder.size() % 64) {
+        candidates.back() = (uint64_t(1) << (schemaOrder.size() % 64)) - 1;
+    }
+
+    for (const auto& table : tables) {
+        // A field the message is too short for rules out the schemas
+        // constraining it
+        const SchemaSet* mask = &table.unconstrained;
+        if (table.key.bitOffset + table.key.bitLength <= bitStream.getCapacity()) {
+            uint8_t buffer[8];
+            bitStream.peek(table.key.bitOffset, table.key.bitLength, buffer);
+            auto value = NodeUnsignedInteger::decodeValue(buffer, table.key.bitLength, table.key.endianness);
+            if (value) {
+                auto it = table.allowed.find(value.value());
+                if (it != table.allowed.end()) {
+                    mask = &it->second;
+                }
+            }
+        }
+        uint64_t remaining = 0;
+        for (size_t word = 0; word < words; word++) {
+            candidates[word] &= (*mask)[word];
+            remaining |= candidates[word];
+        }
+        if (!remaining) {
+            return {};
+        }
+    }
+
+    std::vector<SchemaId> result;
+    for (size_t word = 0; word < words; word++) {
+        uint64_t bits = candidates[word];
+        while (bits) {
+            result.push_back(schemaOrder[word * 64 + __builtin_ctzll(bits)]);
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
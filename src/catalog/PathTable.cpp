@@ -0,0 +1,80 @@
+#include "../../include/catalog/PathTable.hpp"
+#include "../../include/catalog/SchemaSnapshot.hpp"
+
+using namespace opencmd;
+
+PathTable PathTable::build(const TreeNode& root) {
+    PathTable table;
+    for (const auto& child : root.getChildren()) {
+        table.collect(*child, "");
+    }
+    std::string joined;
+    for (const auto& path : table.paths) {
+        joined += path;
+        joined += '\n';
+    }
+    table.version = SchemaSnapshot::checksum(reinterpret_cast<const uint8_t*>(joined.data()), joined.size());
+    return table;
+}
+
+void PathTable::collect(const TreeNode& node, const std::string& arrayPrefix) {
+    // Inside an array the items are renamed after their position: the
+    // template of an item is the (template of the) array path plus "/*"
+    if (dynamic_cast<const NodeArray*>(&node)) {
+        std::string itemPrefix = (arrayPrefix.empty() ? node.getFullName() : arrayPrefix + "/" + node.getName()) + "/*";
+        for (const auto& child : node.getChildren()) {
+            if (child->getChildren().empty()) {
+                add(itemPrefix, *child);
+            } else {
+                for (const auto& grandChild : child->getChildren()) {
+                    collect(*grandChild, itemPrefix);
+                }
+            }
+        }
+        return;
+    }
+    std::string path = arrayPrefix.empty() ? node.getFullName() : arrayPrefix + "/" + node.getName();
+    if (node.getChildren().empty()) {
+        add(path, node);
+        return;
+    }
+    for (const auto& child : node.getChildren()) {
+        collect(*child, arrayPrefix.empty() ? "" : path);
+    }
+}
+
+void PathTable::add(const std::string& path, const TreeNode& node) {
+    if (ids.count(path)) {
+        return;
+    }
+    paths.push_back(path);
+    ids[path] = static_cast<uint32_t>(paths.size());
+    unsignedPaths.push_back(dynamic_cast<const NodeUnsignedInteger*>(&node) != nullptr);
+}
+
+uint32_t PathTable::lookup(const std::string& key, std::string& templateBuffer, std::vector<uint32_t>& indices) const {
+    templateBuffer.clear();
+    indices.clear();
+    size_t position = 0;
+    while (position < key.size()) {
+        size_t end = key.find('/', position + 1);
+        if (end == std::string::npos) {
+            end = key.size();
+        }
+        // Segment [position, end) including its leading '/'
+        size_t digits = 0;
+        uint64_t index = 0;
+        for (size_t i = position + 1; i < end && key[i] >= '0' && key[i] <= '9'; i++, digits++) {
+            index = index * 10 + static_cast<uint64_t>(key[i] - '0');
+        }
+        if (digits > 0 && digits == end - position - 1) {
+            templateBuffer += "/*";
+            indices.push_back(static_cast<uint32_t>(index));
+        } else {
+            templateBuffer.append(key, position, end - position);
+        }
+        position = end;
+    }
+    auto it = ids.find(templateBuffer);
+    return it == ids.end() ? NO_PATH : it->second;
+}
@@ -0,0 +1,73 @@
+#include "../../include/catalog/Rcu.hpp"
+
+#include <thread>
+
+namespace opencmd {
+
+    // Per thread reader state: the claimed slot (released when the thread
+    // exits) and the nesting depth of the read-side sections
+    struct RcuThreadState {
+        RcuDomain::ReaderSlot* slot = nullptr;
+        size_t depth = 0;
+
+        ~RcuThreadState() {
+            if (slot) {
+                slot->epoch.store(0, std::memory_order_release);
+                slot->used.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static thread_local RcuThreadState threadState;
+
+    RcuDomain& RcuDomain::getInstance() {
+        static RcuDomain instance;
+        return instance;
+    }
+
+    RcuDomain::ReaderSlot* RcuDomain::claimSlot() {
+        while (true) {
+            for (auto& slot : slots) {
+                bool expected = false;
+                if (!slot.used.load(std::memory_order_relaxed) &&
+                    slot.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return &slot;
+                }
+            }
+            // More than MAX_READERS live reader threads: wait for one to exit
+            std::this_thread::yield();
+        }
+    }
+
+    void RcuDomain::readLock() {
+        if (threadState.depth++ == 0) {
+            if (!threadState.slot) {
+                threadState.slot = claimSlot();
+            }
+            threadState.slot->epoch.store(globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+    }
+
+    void RcuDomain::readUnlock() {
+        if (--threadState.depth == 0) {
+            threadState.slot->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    void RcuDomain::synchronize() {
+        // Readers that announced an epoch older than the new one may still
+        // hold the previous version; readers announcing the new epoch (or
+        // announcing after the scan) are guaranteed to see the new version
+        uint64_t newEpoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        for (auto& slot : slots) {
+            while (true) {
+                uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+                if (epoch == 0 || epoch >= newEpoch) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+}
@@ -1,24 +1,249 @@
 #include "../../include/catalog/SchemaCatalog.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
 using namespace opencmd;
 
+std::optional<SchemaId> SchemaCatalog::resolve(const std::string& schemaName) const {
+    auto currentVersion = catalogVersion.read();
+    auto it = currentVersion->schemas.find(schemaName);
+    if (it != currentVersion->schemas.end()) {
+        return it->second->getId();
+    }
+    return std::nullopt;
+}
+
+std::shared_ptr<const Schema> SchemaCatalog::getSchema(const std::string& schemaName) const {
+    auto currentVersion = catalogVersion.read();
+    auto it = currentVersion->schemas.find(schemaName);
+    if (it != currentVersion->schemas.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const Schema> SchemaCatalog::getSchema(SchemaId id) const {
+    auto currentVersion = catalogVersion.read();
+    if (id < currentVersion->schemasById.size()) {
+        return currentVersion->schemasById[id];
+    }
+    return nullptr;
+}
+
+std::vector<SchemaId> SchemaCatalog::classify(const BitStream& bitStream) const {
+    auto currentVersion = catalogVersion.read();
+    return currentVersion->discriminatorIndex.classify(bitStream);
+}
+
 std::shared_ptr<TreeNode> SchemaCatalog::cloneAbstractTree(const std::string& schemaName) const {
-    auto it = schemaMap.find(schemaName);
-    if (it != schemaMap.end()) {
-        return it->second.getAbstractTree()->clone();
+    // The schema is kept alive by the returned shared pointer even if a
+    // reload replaces it while the tree is being cloned
+    auto schema = getSchema(schemaName);
+    if (schema) {
+        return schema->getAbstractTree()->clone();
     } else {
         Logger::getInstance().log("Requested schema <" + schemaName + "> does not exist in the loaded catalog", Logger::Level::WARNING);
     }
     return nullptr;
 }
 
+SchemaId SchemaCatalog::assignId(const std::string& schemaName) {
+    std::lock_guard<std::mutex> lock(idMutex);
+    auto it = assignedIds.find(schemaName);
+    if (it != assignedIds.end()) {
+        return it->second;
+    }
+    SchemaId id = static_cast<SchemaId>(assignedIds.size() + 1);
+    assignedIds[schemaName] = id;
+    return id;
+}
+
+void SchemaCatalog::publish(std::function<void(SchemaMap&)> updateMap) {
+    catalogVersion.update([&](const CatalogVersion& currentVersion) {
+        auto nextVersion = std::make_unique<CatalogVersion>();
+        nextVersion->schemas = currentVersion.schemas;
+        updateMap(nextVersion->schemas);
+        for (const auto& [name, schema] : nextVersion->schemas) {
+            if (schema->getId() >= nextVersion->schemasById.size()) {
+                nextVersion->schemasById.resize(schema->getId() + 1);
+            }
+            nextVersion->schemasById[schema->getId()] = schema;
+        }
+        nextVersion->discriminatorIndex = DiscriminatorIndex::build(nextVersion->schemasById);
+        return nextVersion;
+    });
+    generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
 int SchemaCatalog::parseSchema(const std::string& name, const nlohmann::json& jsonSchema) {
-    Schema schema;
+    auto schema = std::make_shared<Schema>();
+    int retVal = compileSchema(name, jsonSchema, *schema);
+    if(retVal){
+        return retVal;
+    }
+    schema->setId(assignId(name));
+    publish([&](SchemaMap& nextMap) { nextMap[name] = schema; });
+    return 0;
+}
+
+int SchemaCatalog::loadCatalog(const std::string& directory, const std::string& snapshotPath, size_t threads) {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    catalogDirectory = directory;
+    catalogSnapshotPath = snapshotPath;
+    catalogThreads = threads;
+    return loadCatalogLocked();
+}
+
+int SchemaCatalog::reload() {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    if(catalogDirectory.empty()){
+        Logger::getInstance().error("Reload requested but no catalog directory has been loaded");
+        return 1;
+    }
+    Logger::getInstance().info("Reloading catalog <" + catalogDirectory + ">");
+    return loadCatalogLocked();
+}
+
+int SchemaCatalog::loadCatalogLocked() {
+    namespace fs = std::filesystem;
+    const std::string& directory = catalogDirectory;
+    const std::string& snapshotPath = catalogSnapshotPath;
+    size_t threads = catalogThreads;
+
+    std::error_code ec;
+    if(!fs::is_directory(directory, ec)){
+        Logger::getInstance().error("Catalog directory <" + directory + "> does not exist or is not a directory");
+        return 1;
+    }
+
+    // Every *.json file in the directory is a schema, named after the file
+    std::vector<std::string> files;
+    for(const auto& entry : fs::directory_iterator(directory, ec)){
+        if(entry.is_regular_file() && entry.path().extension() == ".json"){
+            files.push_back(entry.path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    std::string catalogFingerprint = fingerprint(files);
+
+    // Warm restart: the snapshot has been built from the very same files
+    if(!snapshotPath.empty()){
+        std::vector<Schema> schemas;
+        if(!SchemaSnapshot::read(snapshotPath, catalogFingerprint, schemas)){
+            publish([&](SchemaMap& nextMap) {
+                nextMap.clear();
+                for(const auto& schema : schemas){
+                    auto loaded = std::make_shared<Schema>(schema);
+                    loaded->setId(assignId(schema.getCatalogName()));
+                    nextMap[schema.getCatalogName()] = loaded;
+                }
+            });
+            Logger::getInstance().info("Catalog loaded from snapshot <" + snapshotPath + "> (" + std::to_string(schemas.size()) + " schemas)");
+            return 0;
+        }
+    }
+
+    // Cold start: parse and compile the JSON files on a pool of workers,
+    // each one picking the next file to be processed
+    if(threads == 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, std::max<size_t>(files.size(), 1));
+
+    std::vector<Schema> schemas(files.size());
+    std::vector<std::string> schemaNames(files.size());
+    std::vector<int> results(files.size(), 0);
+    std::atomic<size_t> nextFile{0};
+    auto worker = [&]() {
+        for(size_t index = nextFile++; index < files.size(); index = nextFile++){
+            const std::string& fileName = files[index];
+            schemaNames[index] = fs::path(fileName).stem().string();
+            std::ifstream inputFile(fileName);
+            if(!inputFile.is_open()){
+                Logger::getInstance().error("Impossible to open catalog file <" + fileName + ">");
+                results[index] = -1;
+                continue;
+            }
+            nlohmann::json jsonData;
+            try {
+                inputFile >> jsonData;
+            } catch (const nlohmann::json::parse_error& e) {
+                Logger::getInstance().error("Catalog file <" + fileName + "> not correctly parsed: " + std::string(e.what()));
+                results[index] = -2;
+                continue;
+            }
+            results[index] = compileSchema(schemaNames[index], jsonData, schemas[index]);
+            if(results[index]){
+                Logger::getInstance().error("Error in parsing the schema <" + schemaNames[index] + "> from file <" + fileName + ">");
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for(size_t i = 0; i < threads; i++){
+        pool.emplace_back(worker);
+    }
+    for(auto& thread : pool){
+        thread.join();
+    }
+
+    // The new version of the catalog reflects the directory content; a
+    // schema whose file is now broken keeps serving its previous version
+    size_t failures = 0;
+    std::vector<Schema> compiled;
+    compiled.reserve(files.size());
+    publish([&](SchemaMap& nextMap) {
+        SchemaMap previousMap;
+        previousMap.swap(nextMap);
+        for(size_t index = 0; index < files.size(); index++){
+            if(results[index]){
+                failures++;
+                auto previous = previousMap.find(schemaNames[index]);
+                if(previous != previousMap.end()){
+                    Logger::getInstance().warning("Schema <" + schemaNames[index] + "> keeps its previous version");
+                    nextMap[schemaNames[index]] = previous->second;
+                }
+                continue;
+            }
+            schemas[index].setId(assignId(schemaNames[index]));
+            compiled.push_back(schemas[index]);
+            nextMap[schemaNames[index]] = std::make_shared<Schema>(std::move(schemas[index]));
+        }
+    });
+    Logger::getInstance().info("Catalog <" + directory + "> loaded (" + std::to_string(compiled.size()) + " schemas, " + std::to_string(failures) + " failures)");
+
+    if(failures){
+        return 2;
+    }
+    // A snapshot is written only for a fully valid catalog
+    if(!snapshotPath.empty() && SchemaSnapshot::write(snapshotPath, catalogFingerprint, compiled)){
+        Logger::getInstance().warning("Impossible to write the catalog snapshot <" + snapshotPath + ">");
+    }
+    return 0;
+}
+
+std::string SchemaCatalog::fingerprint(const std::vector<std::string>& files) {
+    namespace fs = std::filesystem;
+    std::ostringstream oss;
+    for(const auto& fileName : files){
+        std::error_code ec;
+        auto size = fs::file_size(fileName, ec);
+        auto lastWrite = fs::last_write_time(fileName, ec).time_since_epoch().count();
+        oss << fs::path(fileName).filename().string() << ':' << size << ':' << lastWrite << ';';
+    }
+    return oss.str();
+}
+
+int SchemaCatalog::compileSchema(const std::string& name, const nlohmann::json& jsonSchema, Schema& schema) {
     schema.setCatalogName(name);
+    schema.arena = std::make_shared<Arena>();
     if(jsonSchema.is_object()){
        for (const auto& [key, val] : jsonSchema.items()) {
             if(key=="structure" && val.type() == nlohmann::json::value_t::array){
-                auto rootNode = evalArray(val);
+                auto rootNode = evalArray(val, *schema.arena);
                 if(!rootNode){
                     Logger::getInstance().log("Error in parsing structure '/'", Logger::Level::ERROR);
                     return 4;
@@ -26,7 +251,7 @@ int SchemaCatalog::parseSchema(const std::string& name, const nlohmann::json& js
                 rootNode.value()->setName("/");
                 rootNode.value()->setParentName("");
                 schema.abstractTree = std::dynamic_pointer_cast<NodeRoot>(rootNode.value());
-                std::cout << " TREE: " << schema.abstractTree->to_string() << std::endl;
+                OPENCMD_LOG_DEBUG("Schema <" + name + "> tree: " + schema.abstractTree->to_string());
             } else if(key=="metadata" && val.type() == nlohmann::json::value_t::object){
                 std::map<std::string, std::string> metadata;
                 for(auto& [key, val] : val.items()){
@@ -50,18 +275,17 @@ int SchemaCatalog::parseSchema(const std::string& name, const nlohmann::json& js
         return 1;
     } 
 
-    schemaMap[name] = schema;
     return 0;
 }
 
-std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalArray(const nlohmann::json& jsonArray){
-    std::shared_ptr<NodeRoot> thisNode = std::make_shared<NodeRoot>();
+std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalArray(const nlohmann::json& jsonArray, Arena& arena){
+    std::shared_ptr<NodeRoot> thisNode = std::allocate_shared<NodeRoot>(ArenaAllocator<NodeRoot>(arena));
     for (const auto &entry : jsonArray) {
         if(entry.type() == nlohmann::json::value_t::array){
             Logger::getInstance().log("Error not expected an array in array", Logger::Level::ERROR);
             return std::nullopt;
         } else {
-            auto child = evalObject(entry);
+            auto child = evalObject(entry, arena);
             if(!child){
                 Logger::getInstance().log("Error in parsing structure '/'", Logger::Level::ERROR);
                 return std::nullopt;
@@ -72,7 +296,7 @@ std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalArray(const nlohmann
     return thisNode;
 }
 
-std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohmann::json& jsonObject){
+std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohmann::json& jsonObject, Arena& arena){
     
     // Type
     std::string type;
@@ -84,12 +308,12 @@ std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohman
     }
 
     // Instantiate object
-    auto thisNode = TreeFactory::getInstance().create(type);
+    auto thisNode = TreeFactory::getInstance().create(type, arena);
     if(!thisNode){
         Logger::getInstance().log("Node creation failed for type: " + type, Logger::Level::ERROR);
         return std::nullopt;
     }
-    Logger::getInstance().debug("Node created for type: " + type);
+    OPENCMD_LOG_DEBUG("Node created for type: " + type);
 
     // Name
     if(jsonObject.contains("name") && jsonObject.at("name").is_string()){
@@ -111,7 +335,7 @@ std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohman
                 Logger::getInstance().error("Invalid attribute with attribute name <"+attributeName+">");
                 return std::nullopt;
             }
-            thisNode->addAttribute(attributeName, *attribute.value());
+            thisNode->addAttribute(attributeName, attribute.value());
         }
     } 
 
@@ -121,7 +345,7 @@ std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohman
             Logger::getInstance().error("Invalid type for key 'structure', array expected");
             return std::nullopt;
         }
-        auto localRootNode = evalArray(jsonObject.at("structure"));
+        auto localRootNode = evalArray(jsonObject.at("structure"), arena);
         if(!localRootNode){
             Logger::getInstance().log("Error in parsing structure '...'", Logger::Level::ERROR);
             return std::nullopt;
@@ -136,19 +360,15 @@ std::optional<std::shared_ptr<TreeNode>> SchemaCatalog::evalObject(const nlohman
     return thisNode;
 }
 
-std::optional<std::shared_ptr<TreeNodeAttribute>> SchemaCatalog::evalAttribute(const nlohmann::json& jsonAttribute){
+std::optional<TreeNodeAttribute> SchemaCatalog::evalAttribute(const nlohmann::json& jsonAttribute){
     if(jsonAttribute.is_boolean()){
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(jsonAttribute.get<bool>());
-        return thisAttribute;
+        return TreeNodeAttribute(jsonAttribute.get<bool>());
     } else if(jsonAttribute.is_number_integer()){
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(jsonAttribute.get<int64_t>());
-        return thisAttribute;
+        return TreeNodeAttribute(jsonAttribute.get<int64_t>());
     } else if(jsonAttribute.is_number_float()){
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(jsonAttribute.get<double>());
-        return thisAttribute;
+        return TreeNodeAttribute(jsonAttribute.get<double>());
     } else if(jsonAttribute.is_string()){
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(jsonAttribute.get<std::string>());
-        return thisAttribute;
+        return TreeNodeAttribute(jsonAttribute.get<std::string>());
     } else if(jsonAttribute.is_array()){
         TreeNodeAttribute::TreeNodeAttributeArray attributeArray;
         attributeArray.reserve(jsonAttribute.size());
@@ -158,10 +378,9 @@ std::optional<std::shared_ptr<TreeNodeAttribute>> SchemaCatalog::evalAttribute(c
                 Logger::getInstance().error("Invalid attribute in array at position <"+attributeName+">");
                 return std::nullopt;
             }
-            attributeArray.emplace_back(*attribute.value());
+            attributeArray.emplace_back(std::move(attribute.value()));
         }
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(attributeArray);
-        return thisAttribute;
+        return TreeNodeAttribute(attributeArray);
     } else if(jsonAttribute.is_object()){
         TreeNodeAttribute::TreeNodeAttributeObject attributeObject;
         attributeObject.reserve(jsonAttribute.size());
@@ -171,11 +390,9 @@ std::optional<std::shared_ptr<TreeNodeAttribute>> SchemaCatalog::evalAttribute(c
                 Logger::getInstance().error("Invalid attribute with key <"+attributeName+">");
                 return std::nullopt;
             }
-            std::pair<std::string,TreeNodeAttribute> thisPair (attributeName, *attribute.value());
-            attributeObject.insert(thisPair);
+            attributeObject.emplace(attributeName, std::move(attribute.value()));
         }
-        std::shared_ptr<TreeNodeAttribute> thisAttribute = std::make_shared<TreeNodeAttribute>(attributeObject);
-        return thisAttribute;
+        return TreeNodeAttribute(attributeObject);
     }
     Logger::getInstance().error("Invalid attribute type");
     return std::nullopt;
@@ -0,0 +1,401 @@
+#include "../../include/catalog/SchemaSnapshot.hpp"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+namespace {
+
+    constexpr char SNAPSHOT_MAGIC[8] = {'O','C','M','D','S','N','A','P'};
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t formatVersion;
+        uint32_t reserved;
+        uint64_t payloadSize;
+        uint64_t checksum;
+    };
+
+    enum class AttributeTag : uint8_t {
+        NUL = 0,
+        BOOL = 1,
+        DECIMAL = 2,
+        INTEGER = 3,
+        STRING = 4,
+        OBJECT = 5,
+        ARRAY = 6
+    };
+
+    class SnapshotWriter {
+    private:
+        std::string payload;
+
+    public:
+        const std::string& getPayload() const { return payload; }
+
+        template <typename T>
+        void writeScalar(const T& value) {
+            payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void writeString(const std::string& value) {
+            writeScalar<uint32_t>(static_cast<uint32_t>(value.size()));
+            payload.append(value);
+        }
+
+        void writeAttribute(const TreeNodeAttribute& attribute) {
+            if (attribute.isNull()) {
+                writeScalar(AttributeTag::NUL);
+            } else if (attribute.isBool()) {
+                writeScalar(AttributeTag::BOOL);
+                writeScalar<uint8_t>(attribute.getBool().value() ? 1 : 0);
+            } else if (attribute.isDecimal()) {
+                writeScalar(AttributeTag::DECIMAL);
+                writeScalar<double>(attribute.getDecimal().value());
+            } else if (attribute.isInteger()) {
+                writeScalar(AttributeTag::INTEGER);
+                writeScalar<int64_t>(attribute.getInteger().value());
+            } else if (attribute.isString()) {
+                writeScalar(AttributeTag::STRING);
+                writeString(attribute.getString().value());
+            } else if (attribute.isObject()) {
+                auto object = attribute.getObject().value();
+                writeScalar(AttributeTag::OBJECT);
+                writeScalar<uint32_t>(static_cast<uint32_t>(object.size()));
+                for (const auto& [key, value] : object) {
+                    writeString(key);
+                    writeAttribute(value);
+                }
+            } else if (attribute.isArray()) {
+                auto array = attribute.getArray().value();
+                writeScalar(AttributeTag::ARRAY);
+                writeScalar<uint32_t>(static_cast<uint32_t>(array.size()));
+                for (const auto& item : array) {
+                    writeAttribute(item);
+                }
+            }
+        }
+
+        void writeNode(const TreeNode& node) {
+            writeString(node.getType());
+            writeString(node.getName());
+            writeScalar<uint32_t>(static_cast<uint32_t>(node.getAttributeMap().size()));
+            for (const auto& [key, attribute] : node.getAttributeMap()) {
+                writeString(key);
+                writeAttribute(attribute);
+            }
+            writeScalar<uint32_t>(static_cast<uint32_t>(node.getChildren().size()));
+            for (const auto& child : node.getChildren()) {
+                writeNode(*child);
+            }
+        }
+    };
+
+    class SnapshotReader {
+    private:
+        const uint8_t* cursor;
+        const uint8_t* end;
+
+    public:
+        SnapshotReader(const uint8_t* data, size_t length) : cursor(data), end(data + length) {}
+
+        bool atEnd() const { return cursor == end; }
+
+        template <typename T>
+        bool readScalar(T& value) {
+            if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, cursor, sizeof(T));
+            cursor += sizeof(T);
+            return true;
+        }
+
+        bool readString(std::string& value) {
+            uint32_t length = 0;
+            if (!readScalar(length) || static_cast<size_t>(end - cursor) < length) {
+                return false;
+            }
+            value.assign(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+            return true;
+        }
+
+        bool readAttribute(TreeNodeAttribute& attribute) {
+            AttributeTag tag;
+            if (!readScalar(tag)) {
+                return false;
+            }
+            switch (tag) {
+                case AttributeTag::NUL:
+                    attribute = TreeNodeAttribute();
+                    return true;
+                case AttributeTag::BOOL: {
+                    uint8_t value = 0;
+                    if (!readScalar(value)) return false;
+                    attribute = TreeNodeAttribute(value != 0);
+                    return true;
+                }
+                case AttributeTag::DECIMAL: {
+                    double value = 0;
+                    if (!readScalar(value)) return false;
+                    attribute = TreeNodeAttribute(value);
+                    return true;
+                }
+                case AttributeTag::INTEGER: {
+                    int64_t value = 0;
+                    if (!readScalar(value)) return false;
+                    attribute = TreeNodeAttribute(value);
+                    return true;
+                }
+                case AttributeTag::STRING: {
+                    std::string value;
+                    if (!readString(value)) return false;
+                    attribute = TreeNodeAttribute(value);
+                    return true;
+                }
+                case AttributeTag::OBJECT: {
+                    uint32_t size = 0;
+                    if (!readScalar(size)) return false;
+                    TreeNodeAttribute::TreeNodeAttributeObject object;
+                    for (uint32_t i = 0; i < size; i++) {
+                        std::string key;
+                        TreeNodeAttribute value;
+                        if (!readString(key) || !readAttribute(value)) return false;
+                        object.emplace(key, value);
+                    }
+                    attribute = TreeNodeAttribute(object);
+                    return true;
+                }
+                case AttributeTag::ARRAY: {
+                    uint32_t size = 0;
+                    if (!readScalar(size)) return false;
+                    TreeNodeAttribute::TreeNodeAttributeArray array;
+                    for (uint32_t i = 0; i < size; i++) {
+                        TreeNodeAttribute value;
+                        if (!readAttribute(value)) return false;
+                        array.emplace_back(value);
+                    }
+                    attribute = TreeNodeAttribute(array);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Nodes are rebuilt in the same order used by SchemaCatalog::evalObject
+        // (name, attributes, then children) so that the parent names and the
+        // attribute-driven fields of the subclasses end up identical
+        std::shared_ptr<TreeNode> readNode(Arena& arena) {
+            std::string type, name;
+            uint32_t attributeCount = 0;
+            if (!readString(type) || !readString(name) || !readScalar(attributeCount)) {
+                return nullptr;
+            }
+            std::shared_ptr<TreeNode> node = TreeFactory::getInstance().create(type, arena);
+            if (!node) {
+                return nullptr;
+            }
+            node->setName(name);
+            for (uint32_t i = 0; i < attributeCount; i++) {
+                std::string key;
+                TreeNodeAttribute attribute;
+                if (!readString(key) || !readAttribute(attribute)) {
+                    return nullptr;
+                }
+                node->addAttribute(key, attribute);
+            }
+            uint32_t childCount = 0;
+            if (!readScalar(childCount)) {
+                return nullptr;
+            }
+            for (uint32_t i = 0; i < childCount; i++) {
+                auto child = readNode(arena);
+                if (!child) {
+                    return nullptr;
+                }
+                node->addChild(child);
+            }
+            return node;
+        }
+    };
+
+}
+
+uint64_t SchemaSnapshot::checksum(const uint8_t* data, size_t length) {
+    // FNV-1a, 64 bits
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int SchemaSnapshot::write(const std::string& path, const std::string& fingerprint, const std::vector<Schema>& schemas) {
+    SnapshotWriter writer;
+    writer.writeString(fingerprint);
+    writer.writeScalar<uint32_t>(static_cast<uint32_t>(schemas.size()));
+    for (const auto& schema : schemas) {
+        if (!schema.getAbstractTree()) {
+            Logger::getInstance().error("Schema <" + schema.getCatalogName() + "> has no abstract tree, snapshot not written");
+            return 1;
+        }
+        writer.writeString(schema.getCatalogName());
+        writer.writeString(schema.getVersion());
+        auto metadata = schema.getMetadata();
+        writer.writeScalar<uint32_t>(static_cast<uint32_t>(metadata.size()));
+        for (const auto& [key, value] : metadata) {
+            writer.writeString(key);
+            writer.writeString(value);
+        }
+        const auto& children = schema.getAbstractTree()->getChildren();
+        writer.writeScalar<uint32_t>(static_cast<uint32_t>(children.size()));
+        for (const auto& child : children) {
+            writer.writeNode(*child);
+        }
+    }
+
+    const std::string& payload = writer.getPayload();
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.formatVersion = FORMAT_VERSION;
+    header.reserved = 0;
+    header.payloadSize = payload.size();
+    header.checksum = checksum(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+
+    // Write to a temporary file and rename it, so that a concurrent reader
+    // never maps a partially written snapshot
+    std::string tempPath = path + ".tmp";
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        Logger::getInstance().error("Impossible to open snapshot file <" + tempPath + "> for writing");
+        return 2;
+    }
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(payload.data(), payload.size());
+    output.close();
+    if (!output) {
+        Logger::getInstance().error("Error writing snapshot file <" + tempPath + ">");
+        std::remove(tempPath.c_str());
+        return 3;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        Logger::getInstance().error("Impossible to rename snapshot file <" + tempPath + "> to <" + path + ">");
+        std::remove(tempPath.c_str());
+        return 4;
+    }
+    return 0;
+}
+
+int SchemaSnapshot::read(const std::string& path, const std::string& fingerprint, std::vector<Schema>& schemas) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Logger::getInstance().info("Snapshot file <" + path + "> not available");
+        return 1;
+    }
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(SnapshotHeader)) {
+        Logger::getInstance().warning("Snapshot file <" + path + "> is truncated");
+        ::close(fd);
+        return 2;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void* mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        Logger::getInstance().warning("Impossible to map snapshot file <" + path + ">");
+        return 3;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(mapped);
+    int retVal = 0;
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const uint8_t* payload = data + sizeof(header);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        Logger::getInstance().warning("Snapshot file <" + path + "> has an invalid magic number");
+        retVal = 4;
+    } else if (header.formatVersion != FORMAT_VERSION) {
+        Logger::getInstance().warning("Snapshot file <" + path + "> has format version <" + std::to_string(header.formatVersion) + ">, expected <" + std::to_string(FORMAT_VERSION) + ">");
+        retVal = 5;
+    } else if (header.payloadSize != fileSize - sizeof(header)) {
+        Logger::getInstance().warning("Snapshot file <" + path + "> has an invalid payload size");
+        retVal = 6;
+    } else if (checksum(payload, header.payloadSize) != header.checksum) {
+        Logger::getInstance().warning("Snapshot file <" + path + "> is corrupted (checksum mismatch)");
+        retVal = 7;
+    }
+
+    if (!retVal) {
+        SnapshotReader reader(payload, header.payloadSize);
+        std::string storedFingerprint;
+        uint32_t schemaCount = 0;
+        if (!reader.readString(storedFingerprint) || storedFingerprint != fingerprint) {
+            Logger::getInstance().info("Snapshot file <" + path + "> is stale, the catalog has changed");
+            retVal = 8;
+        } else if (!reader.readScalar(schemaCount)) {
+            retVal = 9;
+        }
+        std::vector<Schema> loaded;
+        loaded.reserve(schemaCount);
+        for (uint32_t i = 0; !retVal && i < schemaCount; i++) {
+            Schema schema;
+            std::string name, version;
+            uint32_t metadataCount = 0;
+            if (!reader.readString(name) || !reader.readString(version) || !reader.readScalar(metadataCount)) {
+                retVal = 9;
+                break;
+            }
+            std::map<std::string, std::string> metadata;
+            for (uint32_t m = 0; !retVal && m < metadataCount; m++) {
+                std::string key, value;
+                if (!reader.readString(key) || !reader.readString(value)) {
+                    retVal = 9;
+                } else {
+                    metadata[key] = value;
+                }
+            }
+            uint32_t childCount = 0;
+            if (retVal || !reader.readScalar(childCount)) {
+                retVal = 9;
+                break;
+            }
+            auto arena = std::make_shared<Arena>();
+            auto rootNode = std::allocate_shared<NodeRoot>(ArenaAllocator<NodeRoot>(*arena));
+            for (uint32_t c = 0; c < childCount; c++) {
+                auto child = reader.readNode(*arena);
+                if (!child) {
+                    retVal = 9;
+                    break;
+                }
+                rootNode->addChild(child);
+            }
+            if (retVal) {
+                break;
+            }
+            schema.setCatalogName(name);
+            schema.setVersion(version);
+            schema.setMetadata(metadata);
+            schema.arena = arena;
+            schema.abstractTree = rootNode;
+            loaded.emplace_back(std::move(schema));
+        }
+        if (retVal == 9) {
+            Logger::getInstance().warning("Snapshot file <" + path + "> contains an invalid schema definition");
+        } else if (!retVal && !reader.atEnd()) {
+            Logger::getInstance().warning("Snapshot file <" + path + "> contains trailing data");
+            retVal = 10;
+        }
+        if (!retVal) {
+            schemas = std::move(loaded);
+        }
+    }
+
+    ::munmap(mapped, fileSize);
+    return retVal;
+}
@@ -0,0 +1,250 @@
+#include "../../include/executor/TaskPool.hpp"
+#include "../../include/logger/Logger.hpp"
+
+#include <algorithm>
+
+using namespace opencmd;
+
+namespace {
+
+    // Rounds of yielding before an idle worker goes to sleep
+    constexpr size_t SPIN_ROUNDS = 32;
+
+    class FunctionTask : public TaskPool::Task {
+        TaskPool::Function function;
+
+    public:
+        explicit FunctionTask(TaskPool::Function function) : function(std::move(function)) {}
+
+        void run(TaskPool&, TaskPool::Context& context) override {
+            function(context);
+        }
+    };
+
+    class RangeTask : public TaskPool::Task {
+        const TaskPool::RangeFunction& function;
+        size_t begin;
+        size_t end;
+        size_t grain;
+
+    public:
+        RangeTask(const TaskPool::RangeFunction& function, size_t begin, size_t end, size_t grain)
+            : function(function), begin(begin), end(end), grain(grain) {}
+
+        void run(TaskPool& pool, TaskPool::Context& context) override {
+            // Lazy binary splitting: the upper halves are left on the deque
+            // of the worker, for itself or for the thieves
+            while (end - begin > grain) {
+                size_t middle = begin + (end - begin) / 2;
+                auto* upper = new RangeTask(function, middle, end, grain);
+                upper->group = group;
+                group->add(1);
+                pool.push(upper);
+                end = middle;
+            }
+            function(context, begin, end);
+        }
+    };
+
+    uint64_t nextRandom(uint64_t& seed) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    }
+
+}
+
+thread_local TaskPool::Worker* TaskPool::currentWorker = nullptr;
+
+void TaskGroup::done() {
+    // Under the lock: the waiter, which checks the counter under the lock
+    // too, cannot return (and destroy the group) before this call is over
+    std::lock_guard<std::mutex> lock(doneMutex);
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        doneCondition.notify_all();
+    }
+}
+
+TaskPool::TaskPool(const TaskPoolOptions& options) {
+    size_t threadCount = options.threads;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        auto worker = std::make_unique<Worker>();
+        worker->pool = this;
+        worker->context.index = i;
+        workers.push_back(std::move(worker));
+    }
+    // Started once every worker exists: they steal from each other
+    for (auto& worker : workers) {
+        worker->thread = std::thread(&TaskPool::work, this, std::ref(*worker));
+        if (pinThread(worker->thread.native_handle(), options.pinning, worker->context.index)) {
+            Logger::getInstance().log("Unable to pin the task pool worker <" + std::to_string(worker->context.index) + ">", Logger::Level::WARNING);
+        }
+    }
+}
+
+TaskPool::~TaskPool() {
+    stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+TaskPool::Context* TaskPool::currentContext() {
+    return currentWorker ? &currentWorker->context : nullptr;
+}
+
+void TaskPool::push(Task* task) {
+    if (currentWorker && currentWorker->pool == this) {
+        currentWorker->deque.push(task);
+    } else {
+        std::lock_guard<std::mutex> lock(injectedMutex);
+        injected.push_back(task);
+        injectedCount.fetch_add(1, std::memory_order_release);
+    }
+    wake();
+}
+
+void TaskPool::wake() {
+    // Pairs with the fence of a worker going to sleep: either it sees the
+    // new task or this thread sees it among the sleepers
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+void TaskPool::submit(Function function, TaskGroup* group) {
+    auto* task = new FunctionTask(std::move(function));
+    task->group = group;
+    if (group) {
+        group->add(1);
+    }
+    push(task);
+}
+
+void TaskPool::parallelFor(size_t count, size_t grain, const RangeFunction& function) {
+    TaskGroup group;
+    parallelFor(count, grain, function, group);
+    wait(group);
+}
+
+void TaskPool::parallelFor(size_t count, size_t grain, const RangeFunction& function, TaskGroup& group) {
+    if (count == 0) {
+        return;
+    }
+    auto* task = new RangeTask(function, 0, count, std::max<size_t>(1, grain));
+    task->group = &group;
+    group.add(1);
+    push(task);
+}
+
+void TaskPool::wait(TaskGroup& group) {
+    Worker* worker = currentWorker && currentWorker->pool == this ? currentWorker : nullptr;
+    if (worker) {
+        // Blocking a worker could leave the tasks of the group without
+        // anyone to run them: it helps instead
+        uint64_t seed = worker->context.index * 0x9E3779B97F4A7C15ull + 1;
+        while (!group.isDone()) {
+            if (Task* task = findTask(worker, seed)) {
+                execute(task, worker->context);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        // The last done() may still hold the lock
+        std::lock_guard<std::mutex> lock(group.doneMutex);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(group.doneMutex);
+    group.doneCondition.wait(lock, [&group] { return group.isDone(); });
+}
+
+void TaskPool::execute(Task* task, Context& context) {
+    task->run(*this, context);
+    TaskGroup* group = task->group;
+    delete task;
+    if (group) {
+        group->done();
+    }
+}
+
+TaskPool::Task* TaskPool::findTask(Worker* worker, uint64_t& seed) {
+    if (worker) {
+        if (Task* task = worker->deque.pop()) {
+            return task;
+        }
+    }
+    if (injectedCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(injectedMutex);
+        if (!injected.empty()) {
+            Task* task = injected.front();
+            injected.pop_front();
+            injectedCount.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    size_t count = workers.size();
+    size_t start = nextRandom(seed) % count;
+    for (size_t i = 0; i < count; i++) {
+        Worker* victim = workers[(start + i) % count].get();
+        if (victim == worker) {
+            continue;
+        }
+        if (Task* task = victim->deque.steal()) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool TaskPool::hasTasks() {
+    if (injectedCount.load(std::memory_order_acquire) > 0) {
+        return true;
+    }
+    for (auto& worker : workers) {
+        if (!worker->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::work(Worker& worker) {
+    currentWorker = &worker;
+    uint64_t seed = worker.context.index * 0x9E3779B97F4A7C15ull + 1;
+    size_t idleRounds = 0;
+    while (true) {
+        if (Task* task = findTask(&worker, seed)) {
+            execute(task, worker.context);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasTasks()) {
+            if (stopping.load()) {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                break;
+            }
+            sleepCondition.wait(lock);
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        idleRounds = 0;
+    }
+    currentWorker = nullptr;
+}
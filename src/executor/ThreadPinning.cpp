@@ -0,0 +1,93 @@
+#include "../../include/executor/ThreadPinning.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+
+using namespace opencmd;
+
+// Parses a sysfs CPU list such as "0-3,8-11"
+static std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return {};
+        }
+    }
+    return cpus;
+}
+
+std::vector<std::vector<int>> opencmd::cpuTopology() {
+    std::vector<int> allowed;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                allowed.push_back(cpu);
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+    if (nodes.empty() && !allowed.empty()) {
+        nodes.push_back(std::move(allowed));
+    }
+    return nodes;
+}
+
+int opencmd::pinThread(pthread_t thread, PinningPolicy policy, size_t index) {
+    if (policy == PinningPolicy::NONE) {
+        return 0;
+    }
+    auto nodes = cpuTopology();
+    if (nodes.empty()) {
+        return 1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (policy == PinningPolicy::CORE) {
+        std::vector<int> cpus;
+        for (const auto& node : nodes) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+        CPU_SET(cpus[index % cpus.size()], &set);
+    } else {
+        for (int cpu : nodes[index % nodes.size()]) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0 ? 0 : 1;
+}
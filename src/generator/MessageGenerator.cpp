@@ -0,0 +1,251 @@
+#include "../../include/generator/MessageGenerator.hpp"
+#include "../../include/abstract_tree/NodeArray.hpp"
+#include "../../include/abstract_tree/NodeRouter.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace opencmd;
+
+MessageGenerator::MessageGenerator(const GeneratorOptions& options) : options(options), state(options.seed) {}
+
+uint64_t MessageGenerator::next() {
+    // splitmix64: one addition and three multiply-xorshifts per value
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t uniform(uint64_t random, uint64_t min, uint64_t max) {
+    uint64_t span = max - min;
+    if (span == std::numeric_limits<uint64_t>::max()) {
+        return random;
+    }
+    return min + random % (span + 1);
+}
+
+uint64_t MessageGenerator::draw(const Field& field) {
+    uint64_t random = next();
+    if (!field.allowedValues.empty()) {
+        return field.allowedValues[random % field.allowedValues.size()];
+    }
+    if (options.distribution == GeneratorOptions::Distribution::BOUNDARY && (random & 1)) {
+        switch ((random >> 1) & 3) {
+            case 0: return field.min;
+            case 1: return field.min < field.max ? field.min + 1 : field.min;
+            case 2: return field.max > field.min ? field.max - 1 : field.max;
+            default: return field.max;
+        }
+    }
+    if (options.distribution == GeneratorOptions::Distribution::BOUNDARY) {
+        random = next();
+    }
+    return uniform(random, field.min, field.max);
+}
+
+uint64_t MessageGenerator::drawRepetitions(const Field& field) {
+    if (!field.allowedValues.empty()) {
+        // The allowed values in the repetitions range, if any
+        std::vector<uint64_t> candidates;
+        for (uint64_t value : field.allowedValues) {
+            if (value >= options.minRepetitions && value <= options.maxRepetitions) {
+                candidates.push_back(value);
+            }
+        }
+        const auto& values = candidates.empty() ? field.allowedValues : candidates;
+        return values[next() % values.size()];
+    }
+    uint64_t max = std::min(options.maxRepetitions, field.max);
+    uint64_t min = std::min(std::max(options.minRepetitions, field.min), max);
+    return uniform(next(), min, max);
+}
+
+int MessageGenerator::load(const Schema& schema) {
+    if (!schema.getAbstractTree()) {
+        return ERROR_UNSUPPORTED_SCHEMA;
+    }
+    return load(*schema.getAbstractTree());
+}
+
+int MessageGenerator::load(const TreeNode& root) {
+    fields.clear();
+    steps.clear();
+    for (const auto& child : root.getChildren()) {
+        int retVal = compile(*child);
+        if (retVal) {
+            return retVal;
+        }
+    }
+    values.assign(fields.size(), 0);
+    return STATUS_OK;
+}
+
+int MessageGenerator::compileField(const TreeNode& node) {
+    auto integer = dynamic_cast<const NodeUnsignedInteger*>(&node);
+    if (!integer || integer->getBitLength() == 0 || integer->getEndianness() == NodeUnsignedInteger::Endianness::MIDDLE) {
+        Logger::getInstance().log("Node <" + node.getFullName() + "> of type <" + node.getType() + "> not supported by the generator", Logger::Level::ERROR);
+        return ERROR_UNSUPPORTED_SCHEMA;
+    }
+    Field field;
+    field.path = node.getFullName();
+    field.bitLength = integer->getBitLength();
+    field.endianness = integer->getEndianness();
+    field.allowedValues = integer->getAllowedValues();
+    field.min = 0;
+    field.max = field.bitLength >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << field.bitLength) - 1;
+    auto range = options.ranges.find(field.path);
+    if (range != options.ranges.end()) {
+        field.min = std::min(range->second.first, field.max);
+        field.max = std::max(field.min, std::min(range->second.second, field.max));
+    }
+    fields.push_back(std::move(field));
+    Step step;
+    step.kind = Step::Kind::FIELD;
+    step.field = fields.size() - 1;
+    steps.push_back(std::move(step));
+    return STATUS_OK;
+}
+
+int MessageGenerator::compile(const TreeNode& node) {
+    if (dynamic_cast<const NodeRouter*>(&node)) {
+        // Not evaluated by the decoder: no bits
+        return STATUS_OK;
+    }
+    auto array = dynamic_cast<const NodeArray*>(&node);
+    if (!array) {
+        if (node.getChildren().empty()) {
+            return compileField(node);
+        }
+        for (const auto& child : node.getChildren()) {
+            int retVal = compile(*child);
+            if (retVal) {
+                return retVal;
+            }
+        }
+        return STATUS_OK;
+    }
+
+    Step step;
+    step.kind = Step::Kind::ARRAY;
+    step.field = NO_FIELD;
+    step.itemsPerRepetition = array->getChildren().size();
+    step.itemPrefix = array->getFullName() + "/";
+    if (array->isArraySizeFixed()) {
+        step.repetitions = static_cast<uint64_t>(std::max(array->getRepetitions(), 0));
+    } else {
+        std::string reference = array->getRepetitionReference();
+        if (!array->isAbsoluteReference()) {
+            reference = array->getFullName() + reference;
+        }
+        // The reference precedes the array, out of any array
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (!fields[i].item && fields[i].path == reference) {
+                step.field = i;
+                fields[i].repetitionReference = true;
+                break;
+            }
+        }
+        if (step.field == NO_FIELD) {
+            Logger::getInstance().log("Repetition reference <" + reference + "> of <" + array->getFullName() + "> not supported by the generator",
+                                      Logger::Level::ERROR);
+            return ERROR_UNSUPPORTED_SCHEMA;
+        }
+    }
+    steps.push_back(std::move(step));
+    for (const auto& child : array->getChildren()) {
+        // The decoder moves the value of each item to its numbered key:
+        // only single fields can be items
+        if (!child->getChildren().empty()) {
+            Logger::getInstance().log("Nested structure in array <" + array->getFullName() + "> not supported by the generator", Logger::Level::ERROR);
+            return ERROR_UNSUPPORTED_SCHEMA;
+        }
+        int retVal = compileField(*child);
+        if (retVal) {
+            return retVal;
+        }
+        fields.back().item = true;
+    }
+    return STATUS_OK;
+}
+
+void MessageGenerator::writeBits(uint64_t bits, size_t length) {
+    if (length > 32) {
+        writeBits(bits >> 32, length - 32);
+        length = 32;
+    }
+    pending = (pending << length) | (bits & ((uint64_t(1) << length) - 1));
+    pendingBits += length;
+    while (pendingBits >= 8) {
+        pendingBits -= 8;
+        frame.push_back(static_cast<uint8_t>(pending >> pendingBits));
+    }
+    pending &= (uint64_t(1) << pendingBits) - 1;
+    frameBits += length;
+}
+
+uint64_t MessageGenerator::writeField(const Field& field, uint64_t value) {
+    if (field.endianness == NodeUnsignedInteger::Endianness::BIG) {
+        // The value, most significant bit first
+        writeBits(value, field.bitLength);
+        return value;
+    }
+    if (field.bitLength % 8 == 0) {
+        // Read back by the decoder as the least significant byte first
+        writeBits(__builtin_bswap64(value) >> (64 - field.bitLength), field.bitLength);
+        return value;
+    }
+    // Partial little endian bytes: written as the encoder does, the decoder
+    // reads the value back
+    uint8_t aligned[8];
+    NodeUnsignedInteger::encodeValue(value, field.bitLength, field.endianness, aligned);
+    size_t numberOfBytes = (field.bitLength + 7) >> 3;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < numberOfBytes; i++) {
+        bits = (bits << 8) | aligned[i];
+    }
+    writeBits(bits >> (numberOfBytes * 8 - field.bitLength), field.bitLength);
+    return value;
+}
+
+void MessageGenerator::generate(BitStream& bitStream, nlohmann::ordered_json* output) {
+    // The message is built in a local buffer and appended at once
+    frame.clear();
+    pending = 0;
+    pendingBits = 0;
+    frameBits = 0;
+    std::string key;
+    for (size_t s = 0; s < steps.size(); s++) {
+        const Step& step = steps[s];
+        if (step.kind == Step::Kind::FIELD) {
+            const Field& field = fields[step.field];
+            uint64_t value = writeField(field, field.repetitionReference ? drawRepetitions(field) : draw(field));
+            values[step.field] = value;
+            if (output) {
+                (*output)[field.path] = static_cast<int64_t>(value);
+            }
+            continue;
+        }
+        uint64_t repetitions = step.field == NO_FIELD ? step.repetitions : values[step.field];
+        size_t items = repetitions * step.itemsPerRepetition;
+        for (size_t i = 0; i < items; i++) {
+            const Field& field = fields[steps[s + 1 + i % step.itemsPerRepetition].field];
+            uint64_t value = writeField(field, draw(field));
+            if (output) {
+                key = step.itemPrefix;
+                key += std::to_string(i);
+                (*output)[key] = static_cast<int64_t>(value);
+            }
+        }
+        s += step.itemsPerRepetition;
+    }
+    if (pendingBits > 0) {
+        frame.push_back(static_cast<uint8_t>(pending << (8 - pendingBits)));
+    }
+    if (frameBits > 0 && bitStream.getCapacity() == 0) {
+        // Byte copy of the whole message
+        bitStream.set(frame.data(), frameBits);
+    } else if (frameBits > 0) {
+        bitStream.append(frame.data(), frameBits);
+    }
+}
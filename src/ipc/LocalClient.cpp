@@ -0,0 +1,132 @@
+#include "../../include/ipc/LocalClient.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+int LocalClient::connect(const std::string& socketPath) {
+    close();
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        return -1;
+    }
+    LocalHandshake handshake{};
+    int descriptors[LOCAL_HANDSHAKE_DESCRIPTORS];
+    if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        receiveDescriptors(socket, &handshake, sizeof(handshake), descriptors, LOCAL_HANDSHAKE_DESCRIPTORS) != 0) {
+        close();
+        return -1;
+    }
+    int memoryFd = descriptors[0];
+    std::copy(descriptors + 1, descriptors + LOCAL_HANDSHAKE_DESCRIPTORS, bells);
+    if (handshake.magic != LOCAL_PROTOCOL_MAGIC || handshake.version != LOCAL_PROTOCOL_VERSION) {
+        ::close(memoryFd);
+        close();
+        return -1;
+    }
+
+    size_t requestRegion = ShmRing::regionSize(handshake.requestCapacity);
+    memorySize = requestRegion + ShmRing::regionSize(handshake.responseCapacity);
+    memory = ::mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    ::close(memoryFd);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        close();
+        return -1;
+    }
+    requests = ShmRing(memory, requestRegion, Doorbells{bells[0], bells[1], socket});
+    responses = ShmRing(static_cast<uint8_t*>(memory) + requestRegion, memorySize - requestRegion, Doorbells{bells[2], bells[3], socket});
+    if (!requests.isValid() || !responses.isValid()) {
+        close();
+        return -1;
+    }
+    nextTag = 0;
+    holdingResult = false;
+    return 0;
+}
+
+void LocalClient::close() {
+    requests = ShmRing();
+    responses = ShmRing();
+    if (memory) {
+        ::munmap(memory, memorySize);
+        memory = nullptr;
+    }
+    for (int& bell : bells) {
+        if (bell >= 0) {
+            ::close(bell);
+            bell = -1;
+        }
+    }
+    if (socket >= 0) {
+        ::close(socket);
+        socket = -1;
+    }
+}
+
+bool LocalClient::send(uint32_t schemaId, const uint8_t* data, size_t bitLength, uint64_t* tag, int timeoutMs) {
+    if (bitLength == 0 || !data || bitLength > UINT32_MAX) {
+        return false;
+    }
+    size_t byteLength = (bitLength + 7) / 8;
+    size_t size = sizeof(LocalDecodeRequest) + byteLength;
+    uint8_t* record = requests.reserve(size);
+    if (!record) {
+        if (!requests.waitWritable(size, timeoutMs)) {
+            return false;
+        }
+        record = requests.reserve(size);
+    }
+    LocalDecodeRequest request{nextTag, schemaId, static_cast<uint32_t>(bitLength)};
+    std::memcpy(record, &request, sizeof(request));
+    std::memcpy(record + sizeof(request), data, byteLength);
+    requests.commit(size);
+    if (tag) {
+        *tag = nextTag;
+    }
+    nextTag++;
+    return true;
+}
+
+bool LocalClient::receive(Result& result, int timeoutMs) {
+    if (holdingResult) {
+        responses.release();
+        holdingResult = false;
+    }
+    size_t size;
+    const uint8_t* record = responses.peek(size);
+    if (!record) {
+        if (!responses.waitReadable(timeoutMs)) {
+            return false;
+        }
+        record = responses.peek(size);
+    }
+    if (!record) {
+        return false;
+    }
+    LocalDecodeResult header;
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, record, sizeof(header));
+    }
+    if (size < sizeof(header) || header.length > size - sizeof(header)) {
+        responses.release();
+        return false;
+    }
+    result.tag = header.tag;
+    result.status = header.status;
+    result.text = std::string_view(reinterpret_cast<const char*>(record) + sizeof(header), header.length);
+    holdingResult = true;
+    return true;
+}
@@ -0,0 +1,67 @@
+#include "../../include/ipc/LocalProtocol.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+int opencmd::sendDescriptors(int socket, const void* data, size_t size, const int* descriptors, size_t count) {
+    iovec payload{const_cast<void*>(data), size};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * LOCAL_HANDSHAKE_DESCRIPTORS)];
+    if (CMSG_SPACE(sizeof(int) * count) > sizeof(control)) {
+        return -1;
+    }
+
+    msghdr message{};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    std::memcpy(CMSG_DATA(header), descriptors, sizeof(int) * count);
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(size) ? 0 : -1;
+}
+
+int opencmd::receiveDescriptors(int socket, void* data, size_t size, int* descriptors, size_t count) {
+    iovec payload{data, size};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * LOCAL_HANDSHAKE_DESCRIPTORS)];
+    if (CMSG_SPACE(sizeof(int) * count) > sizeof(control)) {
+        return -1;
+    }
+
+    msghdr message{};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+    ssize_t received;
+    do {
+        received = ::recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+
+    cmsghdr* header = received > 0 ? CMSG_FIRSTHDR(&message) : nullptr;
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    size_t passed = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int* passedDescriptors = reinterpret_cast<int*>(CMSG_DATA(header));
+    if (passed != count || received != static_cast<ssize_t>(size) || (message.msg_flags & MSG_CTRUNC)) {
+        for (size_t i = 0; i < passed; i++) {
+            ::close(passedDescriptors[i]);
+        }
+        return -1;
+    }
+    std::memcpy(descriptors, passedDescriptors, sizeof(int) * count);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "../../include/ipc/ShmRing.hpp"
+
+#include <chrono>
+#include <new>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace opencmd;
+
+void ShmRing::initialize(void* memory, size_t capacity) {
+    Header* header = new (memory) Header();
+    header->magic = MAGIC;
+    header->reserved = 0;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->readerWaiting.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->writerWaiting.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+ShmRing::ShmRing(void* memory, size_t size, const Doorbells& bells) : bells(bells) {
+    auto* candidate = static_cast<Header*>(memory);
+    if (!memory || size < sizeof(Header) || candidate->magic != MAGIC) {
+        return;
+    }
+    uint64_t capacity = candidate->capacity;
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0 || capacity > size - sizeof(Header)) {
+        return;
+    }
+    header = candidate;
+    buffer = static_cast<uint8_t*>(memory) + sizeof(Header);
+    mask = capacity - 1;
+    writePosition = header->tail.load(std::memory_order_acquire);
+    readPosition = header->head.load(std::memory_order_acquire);
+    cachedHead = readPosition;
+    cachedTail = writePosition;
+}
+
+void ShmRing::ring(int bell) {
+    uint64_t one = 1;
+    // A full eventfd counter (EAGAIN) already wakes the peer
+    ssize_t written = ::write(bell, &one, sizeof(one));
+    (void)written;
+}
+
+bool ShmRing::writable(size_t size) {
+    uint64_t needed = recordSize(size);
+    uint64_t toEnd = (mask + 1) - (writePosition & mask);
+    uint64_t skip = toEnd < needed ? toEnd : 0;
+    if (writePosition + skip + needed - cachedHead > mask + 1) {
+        cachedHead = header->head.load(std::memory_order_acquire);
+    }
+    return writePosition + skip + needed - cachedHead <= mask + 1;
+}
+
+bool ShmRing::readable(size_t) {
+    if (readPosition == cachedTail) {
+        cachedTail = header->tail.load(std::memory_order_acquire);
+    }
+    return readPosition != cachedTail;
+}
+
+uint8_t* ShmRing::reserve(size_t size) {
+    if (!header || size > maxPayloadSize() || !writable(size)) {
+        return nullptr;
+    }
+    uint64_t offset = writePosition & mask;
+    reservedPosition = writePosition;
+    if ((mask + 1) - offset < recordSize(size)) {
+        // The record goes to the beginning of the buffer
+        *reinterpret_cast<uint32_t*>(buffer + offset) = SKIP_MARKER;
+        reservedPosition += (mask + 1) - offset;
+        offset = 0;
+    }
+    return buffer + offset + RECORD_HEADER_SIZE;
+}
+
+void ShmRing::commit(size_t size) {
+    *reinterpret_cast<uint32_t*>(buffer + (reservedPosition & mask)) = static_cast<uint32_t>(size);
+    writePosition = reservedPosition + recordSize(size);
+    header->tail.store(writePosition, std::memory_order_release);
+    // Pairs with the fence of sleep(): either the consumer sees the new tail
+    // or this side sees its waiting flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->readerWaiting.load(std::memory_order_relaxed)) {
+        ring(bells.reader);
+    }
+}
+
+const uint8_t* ShmRing::peek(size_t& size) {
+    if (!header) {
+        return nullptr;
+    }
+    while (readable(0)) {
+        uint64_t offset = readPosition & mask;
+        uint32_t length = *reinterpret_cast<const uint32_t*>(buffer + offset);
+        if (length == SKIP_MARKER) {
+            readPosition += (mask + 1) - offset;
+            continue;
+        }
+        if (length > maxPayloadSize() || offset + recordSize(length) > mask + 1) {
+            // Corrupted by the peer: the ring is not used anymore
+            header = nullptr;
+            return nullptr;
+        }
+        peekedSize = recordSize(length);
+        size = length;
+        return buffer + offset + RECORD_HEADER_SIZE;
+    }
+    return nullptr;
+}
+
+void ShmRing::release() {
+    readPosition += peekedSize;
+    peekedSize = 0;
+    header->head.store(readPosition, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->writerWaiting.load(std::memory_order_relaxed)) {
+        ring(bells.writer);
+    }
+}
+
+bool ShmRing::sleep(int bell, std::atomic<uint32_t>& waitingFlag, bool (ShmRing::*ready)(size_t), size_t size, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (header) {
+        waitingFlag.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((this->*ready)(size)) {
+            waitingFlag.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        int wait = -1;
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            wait = left > 0 ? static_cast<int>(left) : 0;
+        }
+        pollfd fds[2] = {{bell, POLLIN, 0}, {bells.peer, POLLRDHUP, 0}};
+        int events = ::poll(fds, bells.peer >= 0 ? 2 : 1, wait);
+        waitingFlag.store(0, std::memory_order_relaxed);
+        if (events > 0 && (fds[0].revents & POLLIN)) {
+            uint64_t value;
+            ssize_t count = ::read(bell, &value, sizeof(value));
+            (void)count;
+        }
+        if (bells.peer >= 0 && (fds[1].revents & (POLLRDHUP | POLLHUP | POLLERR))) {
+            return (this->*ready)(size);
+        }
+        if (events == 0 && timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline) {
+            return (this->*ready)(size);
+        }
+        // Spurious wake up (e.g. a bell rung before the flag was cleared): check again
+    }
+    return false;
+}
+
+bool ShmRing::waitWritable(size_t size, int timeoutMs) {
+    if (!header || size > maxPayloadSize()) {
+        return false;
+    }
+    return sleep(bells.writer, header->writerWaiting, &ShmRing::writable, size, timeoutMs);
+}
+
+bool ShmRing::waitReadable(int timeoutMs) {
+    if (!header) {
+        return false;
+    }
+    return sleep(bells.reader, header->readerWaiting, &ShmRing::readable, 0, timeoutMs);
+}
@@ -0,0 +1,143 @@
+#include "../../include/logger/ErrorReporter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace opencmd {
+    ErrorSite::ErrorSite(const char* name, Logger::Level level) : name(name), level(level) {
+        for (auto& block : blocks) {
+            block.store(nullptr, std::memory_order_relaxed);
+        }
+        ErrorReporter::getInstance().registerSite(this);
+    }
+
+    ErrorSite::Counters& ErrorSite::counters(uint32_t schema) {
+        // Schemas beyond the table share its last counters
+        size_t index = std::min<size_t>(schema, BLOCKS * BLOCK_SIZE - 1);
+        auto& slot = blocks[index / BLOCK_SIZE];
+        Block* block = slot.load(std::memory_order_acquire);
+        if (!block) {
+            auto* created = new Block();
+            int64_t tokens = ErrorReporter::getInstance().getDetailsPerPeriod();
+            for (auto& counters : created->counters) {
+                counters.tokens.store(tokens, std::memory_order_relaxed);
+            }
+            if (slot.compare_exchange_strong(block, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                block = created;
+            } else {
+                delete created;
+            }
+        }
+        return block->counters[index % BLOCK_SIZE];
+    }
+
+    void ErrorSite::forEach(const std::function<void(uint32_t schema, Counters&)>& function) {
+        for (size_t i = 0; i < BLOCKS; i++) {
+            Block* block = blocks[i].load(std::memory_order_acquire);
+            if (!block) {
+                continue;
+            }
+            for (size_t j = 0; j < BLOCK_SIZE; j++) {
+                Counters& counters = block->counters[j];
+                if (counters.occurrences.load(std::memory_order_relaxed) > 0) {
+                    function(static_cast<uint32_t>(i * BLOCK_SIZE + j), counters);
+                }
+            }
+        }
+    }
+
+    ErrorReporter& ErrorReporter::getInstance() {
+        // Never destroyed, like the Logger. The pending summaries are logged
+        // at exit
+        static ErrorReporter* instance = [] {
+            auto* reporter = new ErrorReporter();
+            std::atexit([] { getInstance().stop(); });
+            return reporter;
+        }();
+        return *instance;
+    }
+
+    ErrorReporter::ErrorReporter() {
+        // The logger outlives the reporter: its exit handler runs after ours
+        Logger::getInstance();
+        ErrorReportOptions options;
+        detailsPerPeriod.store(options.detailsPerPeriod);
+        summaryPeriod = options.summaryPeriod;
+        summarizer = std::thread(&ErrorReporter::summarizeLoop, this);
+    }
+
+    void ErrorReporter::setOptions(const ErrorReportOptions& options) {
+        detailsPerPeriod.store(options.detailsPerPeriod, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(summarizerMutex);
+            summaryPeriod = options.summaryPeriod;
+            periodChanged = true;
+        }
+        summarizerCondition.notify_all();
+    }
+
+    void ErrorReporter::registerSite(ErrorSite* site) {
+        std::lock_guard<std::mutex> lock(sitesMutex);
+        sites.push_back(site);
+    }
+
+    void ErrorReporter::summarize() {
+        std::lock_guard<std::mutex> lock(sitesMutex);
+        int64_t tokens = detailsPerPeriod.load(std::memory_order_relaxed);
+        for (ErrorSite* site : sites) {
+            site->forEach([&](uint32_t schema, ErrorSite::Counters& counters) {
+                uint64_t occurrences = counters.occurrences.load(std::memory_order_relaxed);
+                int64_t left = counters.tokens.exchange(tokens, std::memory_order_relaxed);
+                uint64_t detailed = static_cast<uint64_t>(std::max<int64_t>(0, tokens - std::max<int64_t>(0, left)));
+                uint64_t period = occurrences - counters.summarized;
+                counters.summarized = occurrences;
+                if (period > detailed) {
+                    Logger::getInstance().log(std::string(site->getName()) + ": " + std::to_string(period - detailed) + " occurrences not logged" +
+                                                  (schema == ErrorSite::NO_SCHEMA ? std::string() : " for schema id <" + std::to_string(schema) + ">") +
+                                                  " (" + std::to_string(occurrences) + " in total)",
+                                              site->getLevel());
+                }
+            });
+        }
+    }
+
+    void ErrorReporter::forEach(const std::function<void(const ErrorSite&, uint32_t schema, uint64_t occurrences)>& function) {
+        std::lock_guard<std::mutex> lock(sitesMutex);
+        for (ErrorSite* site : sites) {
+            site->forEach([&](uint32_t schema, ErrorSite::Counters& counters) {
+                function(*site, schema, counters.occurrences.load(std::memory_order_relaxed));
+            });
+        }
+    }
+
+    void ErrorReporter::summarizeLoop() {
+        std::unique_lock<std::mutex> lock(summarizerMutex);
+        while (true) {
+            summarizerCondition.wait_for(lock, summaryPeriod, [this] { return stopping || periodChanged; });
+            if (stopping) {
+                break;
+            }
+            if (periodChanged) {
+                // Restarted with the new period
+                periodChanged = false;
+                continue;
+            }
+            lock.unlock();
+            summarize();
+            lock.lock();
+        }
+    }
+
+    void ErrorReporter::stop() {
+        {
+            std::lock_guard<std::mutex> lock(summarizerMutex);
+            stopping = true;
+        }
+        summarizerCondition.notify_all();
+        if (summarizer.joinable()) {
+            summarizer.join();
+        }
+        summarize();
+    }
+}
@@ -1,58 +1,314 @@
 #include "../../include/logger/Logger.hpp"
 
-#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
-#include <sstream>
 #include <stdexcept>
 
 namespace opencmd {
+    namespace {
+        // Longest sleep of the flusher when nobody asks for a flush
+        constexpr std::chrono::milliseconds FLUSH_PERIOD{10};
+
+        struct RecordHeader {
+            int64_t micros;
+            uint32_t length;
+            uint32_t level;
+        };
+
+        int64_t nowMicros() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        const char* levelName(Logger::Level level) {
+            switch (level) {
+                case Logger::Level::DEBUG:
+                    return "debug";
+                case Logger::Level::INFO:
+                    return "info";
+                case Logger::Level::WARNING:
+                    return "warning";
+                case Logger::Level::ERROR:
+                    return "error";
+                case Logger::Level::CRITICAL:
+                    return "critical";
+                default:
+                    return "unknown log level";
+            }
+        }
+    }
+
+    // Ring of the records of one thread: written by that thread only, read
+    // by the flusher only. Positions grow forever and wrap on the buffer
+    struct Logger::ThreadBuffer {
+        std::unique_ptr<char[]> data{new char[THREAD_BUFFER_SIZE]};
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        // Set when the thread exits: the flusher frees the buffer once empty
+        std::atomic<bool> closed{false};
+
+        void copyIn(uint64_t position, const void* source, size_t size) {
+            size_t offset = position % THREAD_BUFFER_SIZE;
+            size_t first = std::min(size, THREAD_BUFFER_SIZE - offset);
+            std::memcpy(data.get() + offset, source, first);
+            std::memcpy(data.get(), static_cast<const char*>(source) + first, size - first);
+        }
+
+        void copyOut(uint64_t position, void* destination, size_t size) const {
+            size_t offset = position % THREAD_BUFFER_SIZE;
+            size_t first = std::min(size, THREAD_BUFFER_SIZE - offset);
+            std::memcpy(destination, data.get() + offset, first);
+            std::memcpy(static_cast<char*>(destination) + first, data.get(), size - first);
+        }
+    };
+
     Logger& Logger::getInstance() {
-        static Logger instance;
-        return instance;
+        // Never destroyed: threads may still log during the static
+        // destruction. The other singletons (ErrorReporter, Metrics,
+        // NodeProfiler) are kept alive the same way. The flusher is stopped,
+        // and the buffers drained, at exit
+        static Logger* instance = [] {
+            auto* logger = new Logger();
+            std::atexit([] { getInstance().stop(); });
+            return logger;
+        }();
+        return *instance;
+    }
+
+    Logger::Logger() {
+        running.store(true);
+        flusher = std::thread(&Logger::flushLoop, this);
     }
 
     Logger::Level Logger::getSeverity() {
-        return this->severity;
+        return this->severity.load(std::memory_order_relaxed);
     }
 
     void Logger::setSeverity(Level severity) {
-        this->severity = severity;
+        this->severity.store(severity, std::memory_order_relaxed);
+    }
+
+    void Logger::setOverflowPolicy(OverflowPolicy policy) {
+        this->overflowPolicy.store(policy, std::memory_order_relaxed);
+    }
+
+    Logger::ThreadBuffer& Logger::threadBuffer() {
+        struct Handle {
+            std::shared_ptr<ThreadBuffer> buffer;
+            ~Handle() {
+                if (buffer) {
+                    buffer->closed.store(true, std::memory_order_release);
+                }
+            }
+        };
+        thread_local Handle handle;
+        if (!handle.buffer) {
+            handle.buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            buffers.push_back(handle.buffer);
+        }
+        return *handle.buffer;
     }
 
     void Logger::log(const std::string& message, Level level) {
-        if (static_cast<unsigned int>(level) < static_cast<unsigned int>(this->severity)) return;
-
-        auto now_seconds = std::chrono::system_clock::now();
-        auto now_millis = std::chrono::time_point_cast<std::chrono::microseconds>(now_seconds);
-        auto value = now_millis.time_since_epoch().count();
-        std::time_t now_time = std::chrono::system_clock::to_time_t(now_seconds);
-        auto now_localtime = std::localtime(&now_time);
-        std::ostringstream ss;
-        ss << std::put_time(now_localtime, "[%Y-%m-%d %H:%M:%S.") << std::setfill('0') << std::setw(6) << (value % 1000000) << "] [";
-
-        switch (level) {
-            case Level::DEBUG:
-                ss << "debug";
-                break;
-            case Level::INFO:
-                ss << "info";
-                break;
-            case Level::WARNING:
-                ss << "warning";
-                break;
-            case Level::ERROR:
-                ss << "error";
-                break;
-            case Level::CRITICAL:
-                ss << "critical";
+        if (static_cast<unsigned int>(level) < static_cast<unsigned int>(getSeverity())) return;
+
+        int64_t micros = nowMicros();
+        if (!running.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            std::string out;
+            format(out, micros, level, message.data(), message.size());
+            write(out);
+            return;
+        }
+
+        ThreadBuffer& buffer = threadBuffer();
+        // A record never takes more than half of the buffer
+        size_t length = std::min(message.size(), THREAD_BUFFER_SIZE / 2 - sizeof(RecordHeader));
+        size_t size = sizeof(RecordHeader) + length;
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        uint64_t used;
+        while ((used = head - buffer.tail.load(std::memory_order_acquire)) + size > THREAD_BUFFER_SIZE) {
+            if (overflowPolicy.load(std::memory_order_relaxed) == OverflowPolicy::DROP) {
+                buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (!running.load(std::memory_order_acquire)) {
+                // Stopped while waiting: nobody will drain the buffer anymore
+                std::lock_guard<std::mutex> lock(writeMutex);
+                std::string out;
+                format(out, micros, level, message.data(), length);
+                write(out);
+                return;
+            }
+            wakeFlusher();
+            std::this_thread::yield();
+        }
+
+        RecordHeader header{micros, static_cast<uint32_t>(length), static_cast<uint32_t>(level)};
+        buffer.copyIn(head, &header, sizeof(header));
+        buffer.copyIn(head + sizeof(header), message.data(), length);
+        buffer.head.store(head + size, std::memory_order_release);
+
+        // Half full: the flusher should not wait for the end of its period
+        if (used + size > THREAD_BUFFER_SIZE / 2) {
+            wakeFlusher();
+        }
+        if (level == Level::CRITICAL) {
+            flush();
+        }
+    }
+
+    void Logger::wakeFlusher() {
+        {
+            std::lock_guard<std::mutex> lock(flusherMutex);
+            wakeRequested = true;
+        }
+        flusherCondition.notify_one();
+    }
+
+    void Logger::flush() {
+        if (!running.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(flusherMutex);
+        // A pass already running may have gone past the buffer of the caller
+        uint64_t target = passes + (draining ? 2 : 1);
+        wakeRequested = true;
+        flusherCondition.notify_one();
+        flushedCondition.wait(lock, [this, target] { return passes >= target || !running.load(); });
+    }
+
+    void Logger::flushLoop() {
+        std::string out;
+        std::unique_lock<std::mutex> lock(flusherMutex);
+        while (true) {
+            draining = true;
+            wakeRequested = false;
+            lock.unlock();
+            bool drained;
+            {
+                std::lock_guard<std::mutex> writeLock(writeMutex);
+                drained = drain(out);
+                write(out);
+            }
+            lock.lock();
+            draining = false;
+            passes++;
+            flushedCondition.notify_all();
+            if (drained) {
+                continue;
+            }
+            if (stopping) {
                 break;
-            default:
-                ss << "unknown log level";
+            }
+            flusherCondition.wait_for(lock, FLUSH_PERIOD, [this] { return wakeRequested || stopping; });
         }
+    }
 
-        ss << "] " << message << std::endl;
+    bool Logger::drain(std::string& out) {
+        struct Entry {
+            int64_t micros;
+            Level level;
+            size_t offset;
+            size_t length;
+        };
+        std::vector<Entry> entries;
+        std::string messages;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            for (auto it = buffers.begin(); it != buffers.end();) {
+                ThreadBuffer& buffer = **it;
+                bool closed = buffer.closed.load(std::memory_order_acquire);
+                uint64_t tail = buffer.tail.load(std::memory_order_relaxed);
+                uint64_t head = buffer.head.load(std::memory_order_acquire);
+                while (tail != head) {
+                    RecordHeader header;
+                    buffer.copyOut(tail, &header, sizeof(header));
+                    size_t offset = messages.size();
+                    messages.resize(offset + header.length);
+                    buffer.copyOut(tail + sizeof(header), &messages[offset], header.length);
+                    entries.push_back({header.micros, static_cast<Level>(header.level), offset, header.length});
+                    tail += sizeof(header) + header.length;
+                }
+                buffer.tail.store(tail, std::memory_order_release);
+                dropped += buffer.dropped.exchange(0, std::memory_order_relaxed);
+                if (closed) {
+                    it = buffers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
 
-        std::cout << ss.str();
+        // Each buffer is in order: merged by time across the threads
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.micros < b.micros; });
+        for (const auto& entry : entries) {
+            format(out, entry.micros, entry.level, messages.data() + entry.offset, entry.length);
+        }
+        if (dropped > 0) {
+            std::string message = std::to_string(dropped) + " log messages dropped: buffers full";
+            format(out, nowMicros(), Level::WARNING, message.data(), message.size());
+        }
+        return !entries.empty();
+    }
+
+    void Logger::format(std::string& out, int64_t micros, Level level, const char* message, size_t length) {
+        int64_t second = micros / 1000000;
+        if (second != cachedSecond) {
+            std::time_t time = static_cast<std::time_t>(second);
+            // localtime_r: the logger is used by the catalog loading workers too
+            std::tm localTime;
+            localtime_r(&time, &localTime);
+            char prefix[32];
+            std::strftime(prefix, sizeof(prefix), "[%Y-%m-%d %H:%M:%S.", &localTime);
+            cachedPrefix = prefix;
+            cachedSecond = second;
+        }
+        char fraction[8];
+        std::snprintf(fraction, sizeof(fraction), "%06d", static_cast<int>(micros % 1000000));
+        out += cachedPrefix;
+        out += fraction;
+        out += "] [";
+        out += levelName(level);
+        out += "] ";
+        out.append(message, length);
+        out += '\n';
+    }
+
+    void Logger::write(std::string& out) {
+        if (out.empty()) {
+            return;
+        }
+        std::cout.write(out.data(), out.size());
+        std::cout.flush();
+        out.clear();
+    }
+
+    void Logger::stop() {
+        running.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(flusherMutex);
+            stopping = true;
+        }
+        flusherCondition.notify_all();
+        if (flusher.joinable()) {
+            flusher.join();
+        }
+        // Records written while the flusher was exiting
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            std::string out;
+            drain(out);
+            write(out);
+        }
+        std::lock_guard<std::mutex> lock(flusherMutex);
+        flushedCondition.notify_all();
     }
 
     void Logger::debug(const std::string& message) {
@@ -74,4 +330,4 @@ namespace opencmd {
     void Logger::critical(const std::string& message) {
         this->log(message, Level::CRITICAL);
     }
-}
\ No newline at end of file
+}
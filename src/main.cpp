@@ -1,64 +1,90 @@
 #include <chrono>
+#include <csignal>
+#include <pthread.h>
 #include "opencmd.hpp"
+#include "server/ServiceServer.hpp"
+#include "server/LocalIngest.hpp"
+#include "server/MetricsEndpoint.hpp"
 
-int main() {
+int main(int argc, char** argv) {
     using namespace opencmd;
     Logger& logger = Logger::getInstance();
-    logger.setSeverity(Logger::Level::DEBUG);
+    logger.setSeverity(Logger::Level::INFO);
 
-    const std::string fileName = "../catalog/can.json";
-    nlohmann::json jsonData;
-    std::ifstream inputFile(fileName);
-    if (!inputFile.is_open()) {
-        logger.log("Errore: Impossibile aprire il file " + fileName, Logger::Level::ERROR);
-        return 1;
+    // Usage: openCMD [catalog directory] [snapshot file] [listen address] [workers] [local socket] [micro batch window us] [metrics address] [profile sample period]
+    const std::string catalogDirectory = argc > 1 ? argv[1] : "../catalog";
+    const std::string snapshotPath = argc > 2 ? argv[2] : "openCMD.snapshot";
+    ServerOptions serverOptions;
+    if(argc > 3){
+        serverOptions.address = argv[3];
     }
-    try {
-        inputFile >> jsonData;
-        inputFile.close();
-        Logger::getInstance().log("JSON file loaded", Logger::Level::INFO);
-    } catch (const nlohmann::json::parse_error& e) {
-        logger.log("Catalog file not correctly parsed: " + std::string(e.what()), Logger::Level::ERROR);
-        return 2;
+    if(argc > 4){
+        serverOptions.workers = std::stoul(argv[4]);
     }
-
-    std::string schemaName = "can";
-    if(SchemaCatalog::getInstance().parseSchema(schemaName, jsonData) < 0){
-        Logger::getInstance().log("Error in parsing the schema", Logger::Level::ERROR);
+    // Shared memory transport for the producers on the same host (disabled
+    // without a socket path)
+    LocalIngestOptions localOptions;
+    if(argc > 5){
+        localOptions.socketPath = argv[5];
+    }
+    // Coalescing window of the concurrent unary requests of a schema (0 =
+    // each request is decoded as soon as it is received)
+    if(argc > 6){
+        serverOptions.microBatch.window = std::chrono::microseconds(std::stoul(argv[6]));
+    }
+    // Prometheus scrape endpoint, e.g. 0.0.0.0:9464 (no metrics are
+    // recorded without it)
+    const std::string metricsAddress = argc > 7 ? argv[7] : "";
+    // Per node profiling of one message every N per thread, served by the
+    // metrics endpoint (0 = disabled)
+    if(argc > 8){
+        NodeProfiler::getInstance().setSamplePeriod(std::stoul(argv[8]));
     }
 
-    
-    nlohmann::ordered_json result;
-    BitStream bs_b64 = BitStream(std::string("AUBAIGhgL/A="));
+    // The termination signals are blocked before any thread is started (the
+    // threads inherit the mask) and collected by the main thread only
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
-    logger.log("bitstream_to_json", Logger::Level::INFO);
-    auto start = std::chrono::high_resolution_clock::now();
-    auto rn_b2j = SchemaCatalog::getInstance().cloneAbstractTree(schemaName);
-    if(!rn_b2j){
-        Logger::getInstance().log("Error in evaluating schema", Logger::Level::ERROR);
-        return 1;
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    if(SchemaCatalog::getInstance().loadCatalog(catalogDirectory, snapshotPath)){
+        logger.log("Error in loading the catalog <" + catalogDirectory + ">", Logger::Level::ERROR);
     }
-    int retVal = rn_b2j->bitstream_to_json(bs_b64, result);
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
-    logger.log("bitstream_to_json returned <" + std::to_string(retVal) + ">, evaluation time " + std::to_string(duration.count()) + " ns", Logger::Level::INFO);
+    auto loadEnd = std::chrono::high_resolution_clock::now();
+    auto loadDuration = std::chrono::duration_cast<std::chrono::microseconds>(loadEnd - loadStart);
+    logger.log("Catalog loaded in " + std::to_string(loadDuration.count()) + " us", Logger::Level::INFO);
 
-    logger.log("JSON: " + result.unflatten().dump(), Logger::Level::INFO);
+    // Schema changes in the catalog directory are applied without restart
+    CatalogWatcher catalogWatcher(catalogDirectory);
+    catalogWatcher.start();
 
-    BitStream output_bs = BitStream();
-    logger.log("json_to_bitstream", Logger::Level::INFO);
-    start = std::chrono::high_resolution_clock::now();
-    auto rn_j2b = SchemaCatalog::getInstance().cloneAbstractTree(schemaName);
-    if(!rn_j2b){
-        Logger::getInstance().log("Error in evaluating schema", Logger::Level::ERROR);
+    MetricsEndpoint metricsEndpoint(metricsAddress);
+    if(!metricsAddress.empty() && metricsEndpoint.start()){
+        return 1;
+    }
+    ServiceServer server(serverOptions);
+    if(server.start()){
+        return 1;
+    }
+    LocalIngest localIngest(localOptions);
+    if(!localOptions.socketPath.empty() && localIngest.start()){
+        server.shutdown();
         return 1;
     }
-    retVal = rn_j2b->json_to_bitstream(result, output_bs);
-    end = std::chrono::high_resolution_clock::now();
-    duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
-    logger.log("json_to_bitstream returned <" + std::to_string(retVal) + ">, evaluation time " + std::to_string(duration.count()) + " ns", Logger::Level::INFO);
 
-    logger.log("BITSTREAM: " + output_bs.to_base64(), Logger::Level::INFO);
+    int signal = 0;
+    sigwait(&signals, &signal);
+    logger.log("Received signal <" + std::to_string(signal) + ">, shutting down", Logger::Level::INFO);
+    localIngest.stop();
+    server.shutdown();
+    catalogWatcher.stop();
+    metricsEndpoint.stop();
+    if(NodeProfiler::getInstance().getSamplePeriod()){
+        logger.log("Node profile:\n" + NodeProfiler::getInstance().table(), Logger::Level::INFO);
+    }
 
     return 0;
 }
@@ -0,0 +1,49 @@
+#include "../../include/memory/Arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace opencmd;
+
+void Arena::addChunk(size_t minimumSize) {
+    size_t size = std::max(chunkSize, minimumSize);
+    Chunk* chunk = static_cast<Chunk*>(std::malloc(sizeof(Chunk) + size));
+    if (!chunk) {
+        throw std::bad_alloc();
+    }
+    chunk->next = head;
+    chunk->size = size;
+    head = chunk;
+    cursor = reinterpret_cast<uint8_t*>(chunk + 1);
+    limit = cursor + size;
+    bytesReserved += size;
+}
+
+void Arena::releaseChunks() {
+    while (head) {
+        Chunk* next = head->next;
+        std::free(head);
+        head = next;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+    bytesReserved = 0;
+}
+
+void Arena::reset() {
+    if (head && head->next) {
+        // More than one chunk has been needed: replace them with a single
+        // chunk able to hold everything, so the next cycle does not grow
+        size_t total = bytesReserved;
+        releaseChunks();
+        addChunk(total);
+    } else if (head) {
+        cursor = reinterpret_cast<uint8_t*>(head + 1);
+    }
+    bytesUsed = 0;
+}
+
+Arena& Arena::threadScratch() {
+    static thread_local Arena scratch;
+    return scratch;
+}
@@ -0,0 +1,273 @@
+#include "../../include/metrics/Metrics.hpp"
+#include "../../include/catalog/SchemaCatalog.hpp"
+#include "../../include/logger/ErrorReporter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+using namespace opencmd;
+
+namespace {
+
+    const char* RPC_NAMES[] = {"toJson", "toBits", "toJsonBatch", "toBitsBatch", "toFields", "resolveSchema", "classify", "getPathTable", "localDecode"};
+    const char* OPERATION_NAMES[] = {"decode", "encode"};
+    const char* STAGE_NAMES[] = {"decode", "encode", "base64", "serialization"};
+
+    // Bucket bounds exported: the powers of two from 256 ns to 2^35 ns,
+    // which are bounds of the log-linear buckets too
+    constexpr int EXPORT_MIN_EXPONENT = 8;
+    constexpr int EXPORT_MAX_EXPONENT = 35;
+
+    std::string escapeLabel(const std::string& value) {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    std::string schemaLabel(uint32_t id) {
+        if (id == INVALID_SCHEMA_ID) {
+            return "unknown";
+        }
+        auto schema = SchemaCatalog::getInstance().getSchema(id);
+        return escapeLabel(schema ? schema->getCatalogName() : "id_" + std::to_string(id));
+    }
+
+    void header(std::string& out, const char* name, const char* type, const char* help) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    void sample(std::string& out, const std::string& name, const std::string& labels, uint64_t value) {
+        out += name;
+        out += '{';
+        out += labels;
+        out += "} ";
+        out += std::to_string(value);
+        out += '\n';
+    }
+
+    void histogram(std::string& out, const char* name, const std::string& labels, const HistogramSnapshot& snapshot) {
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        char bound[32];
+        for (int exponent = EXPORT_MIN_EXPONENT; exponent <= EXPORT_MAX_EXPONENT; exponent++) {
+            for (; bucket < Histogram::firstBucketOf(exponent); bucket++) {
+                cumulative += snapshot.buckets[bucket];
+            }
+            std::snprintf(bound, sizeof(bound), "%.6g", static_cast<double>(uint64_t(1) << exponent) / 1e9);
+            sample(out, std::string(name) + "_bucket", labels + ",le=\"" + bound + "\"", cumulative);
+        }
+        sample(out, std::string(name) + "_bucket", labels + ",le=\"+Inf\"", snapshot.count);
+        std::snprintf(bound, sizeof(bound), "%.9g", static_cast<double>(snapshot.sum) / 1e9);
+        out += std::string(name) + "_sum{" + labels + "} " + bound + "\n";
+        sample(out, std::string(name) + "_count", labels, snapshot.count);
+    }
+
+}
+
+Metrics& Metrics::getInstance() {
+    // Never destroyed, like the Logger
+    static Metrics* instance = new Metrics();
+    return *instance;
+}
+
+Metrics::Shard::~Shard() {
+    for (auto& block : blocks) {
+        delete block.load(std::memory_order_relaxed);
+    }
+}
+
+Metrics::SchemaMetrics& Metrics::Shard::schema(uint32_t id) {
+    size_t index = std::min<size_t>(id, BLOCKS * BLOCK_SIZE - 1);
+    auto& slot = blocks[index / BLOCK_SIZE];
+    SchemaBlock* block = slot.load(std::memory_order_relaxed);
+    if (!block) {
+        // Only the owner thread allocates: published for the scrapes
+        block = new SchemaBlock();
+        slot.store(block, std::memory_order_release);
+    }
+    return block->schemas[index % BLOCK_SIZE];
+}
+
+size_t Metrics::statusIndex(int status) {
+    for (size_t i = 0; i < STATUS_CODES.size(); i++) {
+        if (STATUS_CODES[i] == status) {
+            return i;
+        }
+    }
+    return STATUS_CODES.size();
+}
+
+void Metrics::recordRpc(Rpc rpc, uint64_t nanos) {
+    RpcMetrics& metrics = shards.local().rpcs[static_cast<size_t>(rpc)];
+    metrics.requests.add(1);
+    metrics.duration.record(nanos);
+}
+
+void Metrics::recordMessage(uint32_t schema, Operation operation, int status, size_t bytesIn, size_t bytesOut) {
+    if (!isEnabled()) {
+        return;
+    }
+    SchemaMetrics& metrics = shards.local().schema(schema);
+    size_t index = static_cast<size_t>(operation);
+    metrics.messages[index][statusIndex(status)].add(1);
+    metrics.bytesIn[index].add(bytesIn);
+    metrics.bytesOut[index].add(bytesOut);
+}
+
+void Metrics::recordStage(uint32_t schema, Stage stage, uint64_t nanos) {
+    shards.local().schema(schema).stages[static_cast<size_t>(stage)].record(nanos);
+}
+
+Metrics::RpcTimer::RpcTimer(Rpc rpc) : rpc(rpc), enabled(Metrics::getInstance().isEnabled()) {
+    if (enabled) {
+        start = Clock::now();
+    }
+}
+
+Metrics::RpcTimer::~RpcTimer() {
+    if (enabled) {
+        Metrics::getInstance().recordRpc(rpc, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+}
+
+Metrics::StageTimer::StageTimer(uint32_t schema) : schema(schema), enabled(Metrics::getInstance().isEnabled()) {
+    if (enabled) {
+        last = Clock::now();
+    }
+}
+
+void Metrics::StageTimer::lap(Stage stage) {
+    if (!enabled) {
+        return;
+    }
+    auto now = Clock::now();
+    Metrics::getInstance().recordStage(schema, stage, std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+    last = now;
+}
+
+void Metrics::StageTimer::skip() {
+    if (enabled) {
+        last = Clock::now();
+    }
+}
+
+std::string Metrics::exposition() {
+    struct SchemaTotals {
+        uint64_t messages[OPERATIONS][STATUSES] = {};
+        uint64_t bytesIn[OPERATIONS] = {};
+        uint64_t bytesOut[OPERATIONS] = {};
+        HistogramSnapshot stages[STAGES];
+    };
+    uint64_t requests[RPCS] = {};
+    std::vector<HistogramSnapshot> durations(RPCS);
+    std::map<uint32_t, SchemaTotals> schemas;
+    shards.forEach([&](Shard& shard) {
+        for (size_t rpc = 0; rpc < RPCS; rpc++) {
+            requests[rpc] += shard.rpcs[rpc].requests.get();
+            durations[rpc].add(shard.rpcs[rpc].duration);
+        }
+        for (size_t b = 0; b < BLOCKS; b++) {
+            SchemaBlock* block = shard.blocks[b].load(std::memory_order_acquire);
+            if (!block) {
+                continue;
+            }
+            for (size_t s = 0; s < BLOCK_SIZE; s++) {
+                const SchemaMetrics& metrics = block->schemas[s];
+                SchemaTotals& totals = schemas[static_cast<uint32_t>(b * BLOCK_SIZE + s)];
+                for (size_t op = 0; op < OPERATIONS; op++) {
+                    for (size_t status = 0; status < STATUSES; status++) {
+                        totals.messages[op][status] += metrics.messages[op][status].get();
+                    }
+                    totals.bytesIn[op] += metrics.bytesIn[op].get();
+                    totals.bytesOut[op] += metrics.bytesOut[op].get();
+                }
+                for (size_t stage = 0; stage < STAGES; stage++) {
+                    totals.stages[stage].add(metrics.stages[stage]);
+                }
+            }
+        }
+    });
+
+    std::string out;
+    header(out, "opencmd_rpc_requests_total", "counter", "Requests handled per RPC");
+    for (size_t rpc = 0; rpc < RPCS; rpc++) {
+        if (requests[rpc] > 0) {
+            sample(out, "opencmd_rpc_requests_total", std::string("rpc=\"") + RPC_NAMES[rpc] + "\"", requests[rpc]);
+        }
+    }
+    header(out, "opencmd_rpc_duration_seconds", "histogram", "Time spent handling a request per RPC");
+    for (size_t rpc = 0; rpc < RPCS; rpc++) {
+        if (durations[rpc].count > 0) {
+            histogram(out, "opencmd_rpc_duration_seconds", std::string("rpc=\"") + RPC_NAMES[rpc] + "\"", durations[rpc]);
+        }
+    }
+
+    // Names are resolved once per schema
+    std::map<uint32_t, std::string> labels;
+    for (auto& [id, totals] : schemas) {
+        labels[id] = "schema=\"" + schemaLabel(id) + "\"";
+    }
+    header(out, "opencmd_messages_total", "counter", "Messages decoded or encoded per schema and status code (0 = success)");
+    for (auto& [id, totals] : schemas) {
+        for (size_t op = 0; op < OPERATIONS; op++) {
+            for (size_t status = 0; status < STATUSES; status++) {
+                if (totals.messages[op][status] == 0) {
+                    continue;
+                }
+                std::string code = status < STATUS_CODES.size() ? std::to_string(STATUS_CODES[status]) : "other";
+                sample(out, "opencmd_messages_total", labels[id] + ",operation=\"" + OPERATION_NAMES[op] + "\",code=\"" + code + "\"",
+                       totals.messages[op][status]);
+            }
+        }
+    }
+    header(out, "opencmd_received_bytes_total", "counter", "Payload bytes received per schema (frames to decode, JSON documents to encode)");
+    for (auto& [id, totals] : schemas) {
+        for (size_t op = 0; op < OPERATIONS; op++) {
+            if (totals.bytesIn[op] > 0) {
+                sample(out, "opencmd_received_bytes_total", labels[id] + ",operation=\"" + OPERATION_NAMES[op] + "\"", totals.bytesIn[op]);
+            }
+        }
+    }
+    header(out, "opencmd_sent_bytes_total", "counter", "Payload bytes sent per schema (JSON documents decoded, frames encoded)");
+    for (auto& [id, totals] : schemas) {
+        for (size_t op = 0; op < OPERATIONS; op++) {
+            if (totals.bytesOut[op] > 0) {
+                sample(out, "opencmd_sent_bytes_total", labels[id] + ",operation=\"" + OPERATION_NAMES[op] + "\"", totals.bytesOut[op]);
+            }
+        }
+    }
+    header(out, "opencmd_stage_duration_seconds", "histogram", "Time spent per stage of a message and schema");
+    for (auto& [id, totals] : schemas) {
+        for (size_t stage = 0; stage < STAGES; stage++) {
+            if (totals.stages[stage].count > 0) {
+                histogram(out, "opencmd_stage_duration_seconds", labels[id] + ",stage=\"" + STAGE_NAMES[stage] + "\"", totals.stages[stage]);
+            }
+        }
+    }
+
+    header(out, "opencmd_input_errors_total", "counter", "Errors of the input per error site and schema");
+    ErrorReporter::getInstance().forEach([&](const ErrorSite& site, uint32_t schema, uint64_t occurrences) {
+        sample(out, "opencmd_input_errors_total", "site=\"" + escapeLabel(site.getName()) + "\"," + (labels.count(schema) ? labels[schema] : "schema=\"" + schemaLabel(schema) + "\""),
+               occurrences);
+    });
+    return out;
+}
@@ -0,0 +1,23 @@
+#include "../../include/server/BatchEngine.hpp"
+#include "../../include/server/RequestHandler.hpp"
+
+using namespace opencmd;
+
+BatchEngine::BatchEngine(TaskPool& pool, size_t chunkSize) : pool(pool), chunkSize(chunkSize > 0 ? chunkSize : 1), handlers(pool) {}
+
+void BatchEngine::run(size_t count, RequestHandler& handler, const ChunkFunction& function) {
+    if (count <= chunkSize) {
+        function(handler, 0, count);
+        return;
+    }
+
+    // The first chunk stays with the caller, the others are split (and
+    // stolen) across the workers
+    TaskGroup group;
+    TaskPool::RangeFunction poolChunk = [&](TaskPool::Context& context, size_t begin, size_t end) {
+        function(handlers.get(context), chunkSize + begin, chunkSize + end);
+    };
+    pool.parallelFor(count - chunkSize, chunkSize, poolChunk, group);
+    function(handler, 0, chunkSize);
+    pool.wait(group);
+}
@@ -0,0 +1,280 @@
+#include "../../include/server/LocalIngest.hpp"
+#include "../../include/ipc/LocalProtocol.hpp"
+#include "../../include/ipc/ShmRing.hpp"
+#include "../../include/catalog/DecoderContext.hpp"
+#include "../../include/logger/Logger.hpp"
+#include "../../include/metrics/Metrics.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace opencmd {
+
+    struct LocalIngest::Session {
+        int socket = -1;
+        // Reader and writer doorbells of the request and response rings
+        int bells[4] = {-1, -1, -1, -1};
+        void* memory = nullptr;
+        size_t memorySize = 0;
+        ShmRing requests;
+        ShmRing responses;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+
+        ~Session() {
+            if (thread.joinable()) {
+                thread.join();
+            }
+            if (memory) {
+                ::munmap(memory, memorySize);
+            }
+            for (int bell : bells) {
+                if (bell >= 0) {
+                    ::close(bell);
+                }
+            }
+            if (socket >= 0) {
+                ::close(socket);
+            }
+        }
+    };
+
+    static bool isPowerOfTwo(size_t value) {
+        return value >= 64 && (value & (value - 1)) == 0;
+    }
+
+    LocalIngest::LocalIngest(const LocalIngestOptions& options) : options(options) {}
+
+    LocalIngest::~LocalIngest() {
+        stop();
+    }
+
+    int LocalIngest::start() {
+        if (listenSocket >= 0) {
+            Logger::getInstance().log("The local ingest is already running", Logger::Level::WARNING);
+            return 1;
+        }
+        if (!isPowerOfTwo(options.requestRingSize) || !isPowerOfTwo(options.responseRingSize)) {
+            Logger::getInstance().log("The ring sizes of the local ingest must be powers of two", Logger::Level::ERROR);
+            return 1;
+        }
+        sockaddr_un address{};
+        if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path)) {
+            Logger::getInstance().log("Invalid local ingest socket <" + options.socketPath + ">", Logger::Level::ERROR);
+            return 1;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+
+        // A socket file left by a previous run would make bind fail
+        ::unlink(options.socketPath.c_str());
+        listenSocket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenSocket < 0 || ::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenSocket, SOMAXCONN) != 0) {
+            Logger::getInstance().log("Error in starting the local ingest on <" + options.socketPath + ">: " + std::strerror(errno), Logger::Level::ERROR);
+            if (listenSocket >= 0) {
+                ::close(listenSocket);
+                listenSocket = -1;
+            }
+            return 1;
+        }
+
+        stopping = false;
+        acceptThread = std::thread(&LocalIngest::accept, this);
+        Logger::getInstance().log("Local ingest listening on <" + options.socketPath + ">", Logger::Level::INFO);
+        return 0;
+    }
+
+    void LocalIngest::stop() {
+        if (listenSocket < 0) {
+            return;
+        }
+        stopping = true;
+        ::shutdown(listenSocket, SHUT_RDWR);
+        acceptThread.join();
+        ::close(listenSocket);
+        listenSocket = -1;
+        ::unlink(options.socketPath.c_str());
+
+        // The sessions waiting on their doorbell see the socket hang up
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            for (auto& session : sessions) {
+                ::shutdown(session->socket, SHUT_RDWR);
+            }
+        }
+        reapSessions(true);
+        Logger::getInstance().log("Local ingest stopped", Logger::Level::INFO);
+    }
+
+    void LocalIngest::reapSessions(bool all) {
+        std::list<std::unique_ptr<Session>> closed;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                if (all || (*it)->finished.load(std::memory_order_acquire)) {
+                    closed.splice(closed.end(), sessions, it++);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // Joined and unmapped outside of the lock
+        closed.clear();
+    }
+
+    void LocalIngest::accept() {
+        while (!stopping) {
+            int socket = ::accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (socket < 0) {
+                if (stopping) {
+                    break;
+                }
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                Logger::getInstance().log(std::string("Error in accepting a local connection: ") + std::strerror(errno), Logger::Level::ERROR);
+                break;
+            }
+            reapSessions(false);
+
+            auto session = openSession(socket);
+            if (!session) {
+                Logger::getInstance().log(std::string("Error in setting up a local connection: ") + std::strerror(errno), Logger::Level::WARNING);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            Session& opened = *session;
+            sessions.push_back(std::move(session));
+            opened.thread = std::thread(&LocalIngest::serve, this, std::ref(opened));
+        }
+    }
+
+    std::unique_ptr<LocalIngest::Session> LocalIngest::openSession(int socket) {
+        auto session = std::make_unique<Session>();
+        session->socket = socket;
+
+        size_t requestRegion = ShmRing::regionSize(options.requestRingSize);
+        session->memorySize = requestRegion + ShmRing::regionSize(options.responseRingSize);
+        int memoryFd = ::memfd_create("openCMD-local", MFD_CLOEXEC);
+        if (memoryFd < 0) {
+            return nullptr;
+        }
+        if (::ftruncate(memoryFd, static_cast<off_t>(session->memorySize)) == 0) {
+            session->memory = ::mmap(nullptr, session->memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+        }
+        if (session->memory == MAP_FAILED || !session->memory) {
+            session->memory = nullptr;
+            ::close(memoryFd);
+            return nullptr;
+        }
+        auto* responseMemory = static_cast<uint8_t*>(session->memory) + requestRegion;
+        ShmRing::initialize(session->memory, options.requestRingSize);
+        ShmRing::initialize(responseMemory, options.responseRingSize);
+
+        int descriptors[LOCAL_HANDSHAKE_DESCRIPTORS] = {memoryFd};
+        bool sent = true;
+        for (size_t i = 0; i < 4; i++) {
+            session->bells[i] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            descriptors[i + 1] = session->bells[i];
+            sent = sent && session->bells[i] >= 0;
+        }
+        LocalHandshake handshake{LOCAL_PROTOCOL_MAGIC, LOCAL_PROTOCOL_VERSION, options.requestRingSize, options.responseRingSize};
+        sent = sent && sendDescriptors(socket, &handshake, sizeof(handshake), descriptors, LOCAL_HANDSHAKE_DESCRIPTORS) == 0;
+        ::close(memoryFd);
+        if (!sent) {
+            return nullptr;
+        }
+
+        session->requests = ShmRing(session->memory, requestRegion, Doorbells{session->bells[0], session->bells[1], socket});
+        session->responses = ShmRing(responseMemory, session->memorySize - requestRegion, Doorbells{session->bells[2], session->bells[3], socket});
+        return session;
+    }
+
+    void LocalIngest::serve(Session& session) {
+        DecoderContext context;
+        std::string text;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            size_t size;
+            const uint8_t* record = session.requests.peek(size);
+            if (!record) {
+                if (!session.requests.waitReadable()) {
+                    break;
+                }
+                continue;
+            }
+
+            Metrics::RpcTimer timer(Metrics::Rpc::LOCAL_DECODE);
+            LocalDecodeRequest request{};
+            int status;
+            if (size < sizeof(request)) {
+                status = STATUS_INVALID_REQUEST;
+                text = "Invalid request record of " + std::to_string(size) + " bytes";
+            } else {
+                std::memcpy(&request, record, sizeof(request));
+                size_t byteLength = size - sizeof(request);
+                if (request.bitLength == 0) {
+                    status = STATUS_INVALID_REQUEST;
+                    text = "Empty message";
+                } else if ((static_cast<size_t>(request.bitLength) + 7) / 8 != byteLength) {
+                    status = STATUS_INVALID_REQUEST;
+                    text = "Bit length " + std::to_string(request.bitLength) + " does not match a payload of " + std::to_string(byteLength) + " bytes";
+                } else if (!SchemaCatalog::getInstance().getSchema(request.schemaId)) {
+                    status = STATUS_UNKNOWN_SCHEMA;
+                    text = "Schema id <" + std::to_string(request.schemaId) + "> not available in the catalog";
+                } else {
+                    // Decoded in place: the request is released only once
+                    // its result is in the response ring
+                    nlohmann::ordered_json result;
+                    Metrics::StageTimer stages(request.schemaId);
+                    try {
+                        BitStream bitStream = BitStream::view(record + sizeof(request), request.bitLength);
+                        status = context.bitstream_to_json(request.schemaId, bitStream, result);
+                        stages.lap(Metrics::Stage::DECODE);
+                        if (status == 0) {
+                            text = result.unflatten().dump();
+                            stages.lap(Metrics::Stage::SERIALIZATION);
+                        } else {
+                            text = "Error in decoding the message (code " + std::to_string(status) + ")";
+                        }
+                    } catch (const std::out_of_range& e) {
+                        status = STATUS_INVALID_REQUEST;
+                        text = std::string("Truncated message: ") + e.what();
+                    } catch (const std::exception& e) {
+                        // Whatever a record makes the tree fail with, only
+                        // the record is refused
+                        status = STATUS_INVALID_REQUEST;
+                        text = std::string("Invalid message: ") + e.what();
+                    }
+                }
+            }
+            if (sizeof(LocalDecodeResult) + text.size() > session.responses.maxPayloadSize()) {
+                status = STATUS_RESULT_TOO_LARGE;
+                text = "Decoded message larger than the response ring";
+            }
+            Metrics::getInstance().recordMessage(request.schemaId, Metrics::Operation::DECODE, status, size, status == 0 ? text.size() : 0);
+
+            size_t resultSize = sizeof(LocalDecodeResult) + text.size();
+            uint8_t* output = session.responses.reserve(resultSize);
+            if (!output) {
+                if (!session.responses.waitWritable(resultSize)) {
+                    break;
+                }
+                output = session.responses.reserve(resultSize);
+            }
+            LocalDecodeResult header{request.tag, status, static_cast<uint32_t>(text.size())};
+            std::memcpy(output, &header, sizeof(header));
+            std::memcpy(output + sizeof(header), text.data(), text.size());
+            session.responses.commit(resultSize);
+            session.requests.release();
+        }
+        session.finished.store(true, std::memory_order_release);
+    }
+
+}
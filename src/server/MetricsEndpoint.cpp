@@ -0,0 +1,167 @@
+#include "../../include/server/MetricsEndpoint.hpp"
+#include "../../include/metrics/Metrics.hpp"
+#include "../../include/abstract_tree/NodeProfiler.hpp"
+#include "../../include/logger/Logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace opencmd {
+
+    // Largest request read: the request line is all that matters
+    static constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+    static void sendAll(int socket, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = ::send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            sent += static_cast<size_t>(written);
+        }
+    }
+
+    MetricsEndpoint::MetricsEndpoint(const std::string& address) : address(address) {}
+
+    MetricsEndpoint::~MetricsEndpoint() {
+        stop();
+    }
+
+    int MetricsEndpoint::start() {
+        if (listenSocket >= 0) {
+            Logger::getInstance().log("The metrics endpoint is already running", Logger::Level::WARNING);
+            return 1;
+        }
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            Logger::getInstance().log("Invalid metrics address <" + address + ">, host:port expected", Logger::Level::ERROR);
+            return 1;
+        }
+        std::string host = address.substr(0, colon);
+        std::string port = address.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* results = nullptr;
+        if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0 || !results) {
+            Logger::getInstance().log("Invalid metrics address <" + address + ">", Logger::Level::ERROR);
+            return 1;
+        }
+        listenSocket = ::socket(results->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (listenSocket >= 0) {
+            ::setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (listenSocket < 0 || ::bind(listenSocket, results->ai_addr, results->ai_addrlen) != 0 || ::listen(listenSocket, 16) != 0) {
+            Logger::getInstance().log("Error in starting the metrics endpoint on <" + address + ">: " + std::strerror(errno), Logger::Level::ERROR);
+            ::freeaddrinfo(results);
+            if (listenSocket >= 0) {
+                ::close(listenSocket);
+                listenSocket = -1;
+            }
+            return 1;
+        }
+        ::freeaddrinfo(results);
+
+        sockaddr_storage bound{};
+        socklen_t boundLength = sizeof(bound);
+        if (::getsockname(listenSocket, reinterpret_cast<sockaddr*>(&bound), &boundLength) == 0) {
+            selectedPort = bound.ss_family == AF_INET6 ? ntohs(reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port)
+                                                       : ntohs(reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+        }
+
+        Metrics::getInstance().setEnabled(true);
+        stopping = false;
+        acceptThread = std::thread(&MetricsEndpoint::accept, this);
+        Logger::getInstance().log("Metrics endpoint listening on <" + host + ":" + std::to_string(selectedPort) + ">", Logger::Level::INFO);
+        return 0;
+    }
+
+    void MetricsEndpoint::stop() {
+        if (listenSocket < 0) {
+            return;
+        }
+        stopping = true;
+        ::shutdown(listenSocket, SHUT_RDWR);
+        acceptThread.join();
+        ::close(listenSocket);
+        listenSocket = -1;
+        Logger::getInstance().log("Metrics endpoint stopped", Logger::Level::INFO);
+    }
+
+    void MetricsEndpoint::accept() {
+        while (!stopping) {
+            int socket = ::accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (socket < 0) {
+                if (stopping) {
+                    break;
+                }
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                Logger::getInstance().log(std::string("Error in accepting a metrics connection: ") + std::strerror(errno), Logger::Level::ERROR);
+                break;
+            }
+            serve(socket);
+            ::close(socket);
+        }
+    }
+
+    void MetricsEndpoint::serve(int socket) {
+        // A stalled client must not hold the endpoint
+        timeval timeout{2, 0};
+        ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+            ssize_t received = ::recv(socket, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                break;
+            }
+            request.append(buffer, static_cast<size_t>(received));
+        }
+
+        std::string status;
+        std::string body;
+        std::string contentType = "text/plain; charset=utf-8";
+        size_t lineEnd = request.find("\r\n");
+        std::string line = request.substr(0, lineEnd);
+        if (line.rfind("GET /metrics ", 0) == 0 || line.rfind("GET /metrics?", 0) == 0) {
+            status = "200 OK";
+            body = Metrics::getInstance().exposition();
+            contentType = "text/plain; version=0.0.4; charset=utf-8";
+        } else if (line.rfind("GET /profile/folded ", 0) == 0) {
+            // Profile of the schema paths, for the flame graph tools
+            status = "200 OK";
+            body = NodeProfiler::getInstance().folded();
+        } else if (line.rfind("GET /profile ", 0) == 0) {
+            status = "200 OK";
+            body = NodeProfiler::getInstance().table();
+        } else if (line.rfind("GET ", 0) == 0) {
+            status = "404 Not Found";
+            body = "Not found: the metrics are served on /metrics, the node profile on /profile and /profile/folded\n";
+        } else {
+            status = "405 Method Not Allowed";
+            body = "Only GET is supported\n";
+        }
+        sendAll(socket, "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType + "\r\nContent-Length: " + std::to_string(body.size()) +
+                            "\r\nConnection: close\r\n\r\n" + body);
+    }
+
+}
@@ -0,0 +1,143 @@
+#include "../../include/server/MicroBatcher.hpp"
+#include "../../include/server/RequestHandler.hpp"
+
+#include <algorithm>
+
+using namespace opencmd;
+
+MicroBatcher::MicroBatcher(const MicroBatchOptions& options, BatchEngine* batchEngine) : options(options), batchEngine(batchEngine) {
+    if (this->options.maxBatchSize == 0) {
+        this->options.maxBatchSize = 1;
+    }
+    size_t threadCount = std::max<size_t>(1, options.threads);
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&MicroBatcher::work, this);
+    }
+}
+
+MicroBatcher::~MicroBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& [key, queue] : queues) {
+        for (Item* item : queue) {
+            item->reject(STATUS_OVERLOADED, "Server shutting down");
+        }
+    }
+    queues.clear();
+}
+
+void MicroBatcher::submit(Item* item, const void* kind, SchemaId schema, Clock::time_point deadline) {
+    item->arrival = Clock::now();
+    item->deadline = deadline;
+
+    Item* shed = nullptr;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping || (queued >= options.maxQueued && (options.overloadPolicy == MicroBatchOptions::OverloadPolicy::REJECT_NEW || queued == 0))) {
+            shed = item;
+        } else {
+            if (queued >= options.maxQueued) {
+                // DROP_OLDEST: the request waiting for the longest time goes
+                auto oldest = queues.end();
+                for (auto it = queues.begin(); it != queues.end(); ++it) {
+                    if (oldest == queues.end() || it->second.front()->arrival < oldest->second.front()->arrival) {
+                        oldest = it;
+                    }
+                }
+                shed = oldest->second.front();
+                oldest->second.pop_front();
+                if (oldest->second.empty()) {
+                    queues.erase(oldest);
+                }
+                queued--;
+            }
+            auto& queue = queues[Key(kind, schema)];
+            queue.push_back(item);
+            queued++;
+            // A new queue starts a window, a full one is due right away
+            wake = queue.size() == 1 || queue.size() >= options.maxBatchSize;
+        }
+    }
+    if (wake) {
+        queueCondition.notify_one();
+    }
+    if (shed) {
+        overloaded.fetch_add(1, std::memory_order_relaxed);
+        shed->reject(STATUS_OVERLOADED, "Server overloaded: request shed by the scheduler");
+    }
+}
+
+void MicroBatcher::work() {
+    RequestHandler handler;
+    std::vector<Item*> batch;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (!stopping) {
+        // The queue due first: a full one, otherwise the one whose oldest
+        // request has been waiting for the longest time
+        auto due = queues.end();
+        Clock::time_point dueTime = Clock::time_point::max();
+        for (auto it = queues.begin(); it != queues.end(); ++it) {
+            Clock::time_point flushTime = it->second.size() >= options.maxBatchSize ? Clock::time_point::min()
+                                                                                      : it->second.front()->arrival + options.window;
+            if (flushTime < dueTime) {
+                due = it;
+                dueTime = flushTime;
+            }
+        }
+        if (due == queues.end()) {
+            queueCondition.wait(lock);
+            continue;
+        }
+        if (dueTime > Clock::now()) {
+            queueCondition.wait_until(lock, dueTime);
+            continue;
+        }
+
+        auto& queue = due->second;
+        size_t count = std::min(queue.size(), options.maxBatchSize);
+        batch.assign(queue.begin(), queue.begin() + count);
+        queue.erase(queue.begin(), queue.begin() + count);
+        // Empty queues are dropped: the keys come from the requests
+        if (queue.empty()) {
+            queues.erase(due);
+        }
+        queued -= count;
+
+        lock.unlock();
+        runBatch(batch, handler);
+        lock.lock();
+    }
+}
+
+void MicroBatcher::runBatch(std::vector<Item*>& batch, RequestHandler& handler) {
+    batches.fetch_add(1, std::memory_order_relaxed);
+    auto now = Clock::now();
+    size_t kept = 0;
+    for (Item* item : batch) {
+        if (now > item->deadline || (options.maxQueueDelay.count() > 0 && now - item->arrival > options.maxQueueDelay)) {
+            expired.fetch_add(1, std::memory_order_relaxed);
+            item->reject(STATUS_EXPIRED, "Request expired while waiting in the scheduler queue");
+        } else {
+            batch[kept++] = item;
+        }
+    }
+    batch.resize(kept);
+
+    BatchEngine::ChunkFunction processChunk = [&batch](RequestHandler& chunkHandler, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            batch[i]->process(chunkHandler);
+        }
+    };
+    if (batchEngine) {
+        batchEngine->run(batch.size(), handler, processChunk);
+    } else {
+        processChunk(handler, 0, batch.size());
+    }
+}
@@ -0,0 +1,357 @@
+#include "../../include/server/RequestHandler.hpp"
+#include "../../include/server/BatchEngine.hpp"
+#include "../../include/metrics/Metrics.hpp"
+
+using namespace opencmd;
+
+std::optional<SchemaId> RequestHandler::resolveSchemaId(uint32_t schemaId, const std::string& messageType) {
+    if (schemaId != INVALID_SCHEMA_ID) {
+        return schemaId;
+    }
+    return SchemaCatalog::getInstance().resolve(messageType);
+}
+
+std::string RequestHandler::schemaName(SchemaId id, const std::string& messageType) {
+    if (!messageType.empty()) {
+        return messageType;
+    }
+    auto schema = SchemaCatalog::getInstance().getSchema(id);
+    return schema ? schema->getCatalogName() : std::string();
+}
+
+template <typename Response>
+static void setStatus(Response& response, int status, const std::string& message) {
+    response.set_response_status(status);
+    response.set_response_message(message);
+}
+
+BitStream RequestHandler::inputStream(const std::string& messageBase64, const std::string& message, uint32_t bitLength) {
+    if (!message.empty()) {
+        // Decoded in place from the buffer of the protobuf message
+        size_t lengthInBits = bitLength;
+        if (lengthInBits == 0) {
+            lengthInBits = message.size() * 8;
+        } else if ((lengthInBits + 7) / 8 != message.size()) {
+            throw std::invalid_argument("Bit length " + std::to_string(lengthInBits) + " does not match a payload of " + std::to_string(message.size()) + " bytes");
+        }
+        return BitStream::view(reinterpret_cast<const uint8_t*>(message.data()), lengthInBits);
+    }
+    // The decoded base64 lives in the scratch arena until the request is completed
+    return BitStream(messageBase64, scratch, bitLength);
+}
+
+void RequestHandler::decodeMessage(SchemaId id, const std::string& messageBase64, const std::string& message, uint32_t bitLength,
+                                   interface::toJsonResponse& response) {
+    int retVal = STATUS_OK;
+    Metrics::StageTimer timer(id);
+    try {
+        BitStream bitStream = inputStream(messageBase64, message, bitLength);
+        if (message.empty()) {
+            timer.lap(Metrics::Stage::BASE64);
+        }
+        nlohmann::ordered_json result;
+        retVal = context.bitstream_to_json(id, bitStream, result);
+        timer.lap(Metrics::Stage::DECODE);
+        if (retVal == STATUS_OK) {
+            response.set_message_json(result.unflatten().dump());
+            timer.lap(Metrics::Stage::SERIALIZATION);
+        } else {
+            response.set_response_message("Error in decoding the message (code " + std::to_string(retVal) + ")");
+        }
+    } catch (const std::invalid_argument& e) {
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Invalid message: ") + e.what());
+    } catch (const std::out_of_range& e) {
+        // The schema reads past the end of the message
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Truncated message: ") + e.what());
+    } catch (const std::exception& e) {
+        // Whatever else the message makes the tree fail with (e.g. an array
+        // length beyond the memory): the worker thread must survive it
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Invalid message: ") + e.what());
+    }
+    scratch.reset();
+    response.set_response_status(retVal);
+    Metrics::getInstance().recordMessage(id, Metrics::Operation::DECODE, retVal, message.empty() ? messageBase64.size() : message.size(),
+                                         response.message_json().size());
+}
+
+void RequestHandler::encodeMessage(SchemaId id, const std::string& messageJson, bool binaryOutput, interface::toBitsResponse& response) {
+    // The message comes in the (nested) shape returned by toJson, the
+    // abstract tree addresses the fields by their flattened path
+    Metrics::StageTimer timer(id);
+    nlohmann::json inputJson = nlohmann::json::parse(messageJson, nullptr, false);
+    if (inputJson.is_discarded() || !inputJson.is_object()) {
+        setStatus(response, STATUS_INVALID_REQUEST, "Invalid message: message_json is not a JSON object");
+        Metrics::getInstance().recordMessage(id, Metrics::Operation::ENCODE, STATUS_INVALID_REQUEST, messageJson.size(), 0);
+        return;
+    }
+    nlohmann::json flatJson = inputJson.flatten();
+    timer.lap(Metrics::Stage::SERIALIZATION);
+
+    BitStream bitStream(scratch);
+    int retVal;
+    try {
+        retVal = context.json_to_bitstream(id, flatJson, bitStream);
+    } catch (const std::exception& e) {
+        scratch.reset();
+        setStatus(response, STATUS_INVALID_REQUEST, std::string("Invalid message: ") + e.what());
+        Metrics::getInstance().recordMessage(id, Metrics::Operation::ENCODE, STATUS_INVALID_REQUEST, messageJson.size(), 0);
+        return;
+    }
+    timer.lap(Metrics::Stage::ENCODE);
+    if (retVal == STATUS_OK) {
+        if (binaryOutput) {
+            response.set_message(reinterpret_cast<const char*>(bitStream.getBuffer()), bitStream.getByteLength());
+        } else {
+            response.set_message_base64(bitStream.to_base64());
+            timer.lap(Metrics::Stage::BASE64);
+        }
+        response.set_message_length(static_cast<int32_t>(bitStream.getCapacity()));
+        response.set_bit_length(static_cast<uint32_t>(bitStream.getCapacity()));
+    } else {
+        response.set_response_message("Error in encoding the message (code " + std::to_string(retVal) + ")");
+    }
+    response.set_response_status(retVal);
+    scratch.reset();
+    Metrics::getInstance().recordMessage(id, Metrics::Operation::ENCODE, retVal, messageJson.size(),
+                                         binaryOutput ? response.message().size() : response.message_base64().size());
+}
+
+void RequestHandler::toJson(const interface::toJsonRequest& request, interface::toJsonResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::TO_JSON);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    if (!schemaId) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        Metrics::getInstance().recordMessage(INVALID_SCHEMA_ID, Metrics::Operation::DECODE, STATUS_UNKNOWN_SCHEMA,
+                                             request.message().empty() ? request.message_base64().size() : request.message().size(), 0);
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    decodeMessage(schemaId.value(), request.message_base64(), request.message(), request.bit_length(), response);
+}
+
+void RequestHandler::toBits(const interface::toBitsRequest& request, interface::toBitsResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::TO_BITS);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    if (!schemaId) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        Metrics::getInstance().recordMessage(INVALID_SCHEMA_ID, Metrics::Operation::ENCODE, STATUS_UNKNOWN_SCHEMA,
+                                             request.message_json().size(), 0);
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    encodeMessage(schemaId.value(), request.message_json(), request.binary_output(), response);
+}
+
+void RequestHandler::toJsonBatch(const interface::toJsonBatchRequest& request, interface::toJsonBatchResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::TO_JSON_BATCH);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    if (!schemaId) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    response.set_schema_id(schemaId.value());
+
+    bool binary = request.messages_size() > 0;
+    int count = binary ? request.messages_size() : request.messages_base64_size();
+    if ((binary && request.messages_base64_size() > 0) || (request.bit_lengths_size() > 0 && request.bit_lengths_size() != count)) {
+        setStatus(response, STATUS_INVALID_REQUEST, "Invalid request: mixed payload kinds or bit_lengths not matching the messages");
+        return;
+    }
+
+    // One response per message, in order: the chunks fill disjoint ranges
+    // of the pre-sized repeated field
+    auto& responses = *response.mutable_responses();
+    responses.Reserve(count);
+    for (int i = 0; i < count; i++) {
+        responses.Add();
+    }
+    static const std::string none;
+    BatchEngine::ChunkFunction decodeChunk = [&](RequestHandler& handler, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t bitLength = request.bit_lengths_size() > 0 ? request.bit_lengths(i) : 0;
+            handler.decodeMessage(schemaId.value(), binary ? none : request.messages_base64(i), binary ? request.messages(i) : none,
+                                  bitLength, *responses.Mutable(i));
+        }
+    };
+    runBatch(count, decodeChunk);
+    response.set_response_status(STATUS_OK);
+}
+
+void RequestHandler::toBitsBatch(const interface::toBitsBatchRequest& request, interface::toBitsBatchResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::TO_BITS_BATCH);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    if (!schemaId) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    response.set_schema_id(schemaId.value());
+
+    auto& responses = *response.mutable_responses();
+    responses.Reserve(request.messages_json_size());
+    for (int i = 0; i < request.messages_json_size(); i++) {
+        responses.Add();
+    }
+    BatchEngine::ChunkFunction encodeChunk = [&](RequestHandler& handler, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            handler.encodeMessage(schemaId.value(), request.messages_json(i), request.binary_output(), *responses.Mutable(i));
+        }
+    };
+    runBatch(request.messages_json_size(), encodeChunk);
+    response.set_response_status(STATUS_OK);
+}
+
+void RequestHandler::runBatch(size_t count, const BatchEngine::ChunkFunction& function) {
+    if (batchEngine) {
+        batchEngine->run(count, *this, function);
+    } else {
+        function(*this, 0, count);
+    }
+}
+
+void RequestHandler::resolveSchema(const interface::resolveSchemaRequest& request, interface::resolveSchemaResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::RESOLVE_SCHEMA);
+    response.set_message_type(request.message_type());
+    auto schemaId = SchemaCatalog::getInstance().resolve(request.message_type());
+    if (!schemaId) {
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        return;
+    }
+    response.set_schema_id(schemaId.value());
+    response.set_response_status(STATUS_OK);
+}
+
+void RequestHandler::classify(const interface::classifyRequest& request, interface::classifyResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::CLASSIFY);
+    std::vector<SchemaId> candidates;
+    try {
+        BitStream bitStream = inputStream(request.message_base64(), request.message(), request.bit_length());
+        candidates = SchemaCatalog::getInstance().classify(bitStream);
+    } catch (const std::exception& e) {
+        scratch.reset();
+        setStatus(response, STATUS_INVALID_REQUEST, std::string("Invalid message: ") + e.what());
+        return;
+    }
+    scratch.reset();
+
+    if (candidates.empty()) {
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "No schema of the catalog matches the message");
+        return;
+    }
+    for (SchemaId id : candidates) {
+        response.add_candidate_ids(id);
+    }
+    response.set_schema_id(candidates.front());
+    response.set_message_type(schemaName(candidates.front(), ""));
+    response.set_response_status(STATUS_OK);
+}
+
+void RequestHandler::toFields(const interface::toJsonRequest& request, interface::toFieldsResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::TO_FIELDS);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    const PathTable* pathTable = schemaId ? context.acquirePathTable(schemaId.value()) : nullptr;
+    if (!pathTable) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    response.set_schema_id(schemaId.value());
+    response.set_path_table_version(pathTable->getVersion());
+
+    int retVal = STATUS_OK;
+    Metrics::StageTimer stages(schemaId.value());
+    try {
+        BitStream bitStream = inputStream(request.message_base64(), request.message(), request.bit_length());
+        if (request.message().empty()) {
+            stages.lap(Metrics::Stage::BASE64);
+        }
+        nlohmann::ordered_json result;
+        retVal = context.bitstream_to_json(schemaId.value(), bitStream, result);
+        stages.lap(Metrics::Stage::DECODE);
+        if (retVal == STATUS_OK) {
+            response.mutable_fields()->Reserve(static_cast<int>(result.size()));
+            for (const auto& [key, value] : result.items()) {
+                interface::fieldValue* field = response.add_fields();
+                uint32_t pathId = pathTable->lookup(key, pathBuffer, pathIndices);
+                field->set_path_id(pathId);
+                if (pathId == PathTable::NO_PATH) {
+                    field->set_path(key);
+                } else {
+                    for (uint32_t index : pathIndices) {
+                        field->add_indices(index);
+                    }
+                }
+                if (value.is_number_integer() && pathTable->isUnsigned(pathId)) {
+                    // Stored as int64_t by the tree: 64 bits values with the
+                    // top bit set come out negative
+                    field->set_uint_value(static_cast<uint64_t>(value.get<int64_t>()));
+                } else if (value.is_number_unsigned()) {
+                    field->set_uint_value(value.get<uint64_t>());
+                } else if (value.is_number_integer()) {
+                    field->set_int_value(value.get<int64_t>());
+                } else if (value.is_number_float()) {
+                    field->set_double_value(value.get<double>());
+                } else if (value.is_boolean()) {
+                    field->set_bool_value(value.get<bool>());
+                } else if (value.is_string()) {
+                    field->set_string_value(value.get_ref<const std::string&>());
+                } else if (value.is_binary()) {
+                    const auto& binary = value.get_binary();
+                    field->set_bytes_value(reinterpret_cast<const char*>(binary.data()), binary.size());
+                } else {
+                    field->set_string_value(value.dump());
+                }
+            }
+            stages.lap(Metrics::Stage::SERIALIZATION);
+        } else {
+            response.set_response_message("Error in decoding the message (code " + std::to_string(retVal) + ")");
+        }
+    } catch (const std::invalid_argument& e) {
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Invalid message: ") + e.what());
+    } catch (const std::out_of_range& e) {
+        // The schema reads past the end of the message
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Truncated message: ") + e.what());
+    } catch (const std::exception& e) {
+        // Whatever else the message makes the tree fail with (e.g. an array
+        // length beyond the memory): the worker thread must survive it
+        retVal = STATUS_INVALID_REQUEST;
+        response.set_response_message(std::string("Invalid message: ") + e.what());
+    }
+    scratch.reset();
+    response.set_response_status(retVal);
+    if (Metrics::getInstance().isEnabled()) {
+        // The size of the fields is computed only when it is recorded
+        Metrics::getInstance().recordMessage(schemaId.value(), Metrics::Operation::DECODE, retVal,
+                                             request.message().empty() ? request.message_base64().size() : request.message().size(),
+                                             response.ByteSizeLong());
+    }
+}
+
+void RequestHandler::getPathTable(const interface::pathTableRequest& request, interface::pathTableResponse& response) {
+    Metrics::RpcTimer timer(Metrics::Rpc::PATH_TABLE);
+    auto schemaId = resolveSchemaId(request.schema_id(), request.message_type());
+    const PathTable* pathTable = schemaId ? context.acquirePathTable(schemaId.value()) : nullptr;
+    if (!pathTable) {
+        response.set_message_type(request.message_type());
+        setStatus(response, STATUS_UNKNOWN_SCHEMA, "Schema <" + request.message_type() + "> not available in the catalog");
+        return;
+    }
+    response.set_message_type(schemaName(schemaId.value(), request.message_type()));
+    response.set_schema_id(schemaId.value());
+    response.set_path_table_version(pathTable->getVersion());
+    for (const auto& path : pathTable->getPaths()) {
+        response.add_paths(path);
+    }
+    response.set_response_status(STATUS_OK);
+}
@@ -0,0 +1,498 @@
+#include "../../include/server/ServiceServer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+#include <google/protobuf/arena.h>
+#include <grpcpp/alarm.h>
+
+#include "../../include/logger/Logger.hpp"
+
+namespace opencmd {
+
+    struct ServiceServer::Worker {
+        std::unique_ptr<grpc::ServerCompletionQueue> queue;
+        std::thread thread;
+        RequestHandler handler;
+        const ServerOptions* options = nullptr;
+
+        // Operations are started on the queue only while it is open: starting
+        // one on a queue that has been shut down is not allowed. Returns
+        // false (operation not started) once the server is shutting down
+        std::mutex queueMutex;
+        bool queueOpen = true;
+
+        template <typename F>
+        bool submit(F&& operation) {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!queueOpen) {
+                return false;
+            }
+            operation();
+            return true;
+        }
+    };
+
+    namespace {
+
+        using AsyncService = interface::service::AsyncService;
+
+        // Completion queue tag: the event of a call to be processed
+        class Call {
+        public:
+            virtual ~Call() = default;
+            virtual void proceed(bool ok) = 0;
+        };
+
+        // Requests of a single message of a schema, which the MicroBatcher
+        // can coalesce
+        template <typename Request, typename = void>
+        struct SchemaAddressed : std::false_type {};
+        template <typename Request>
+        struct SchemaAddressed<Request, std::void_t<decltype(std::declval<Request>().schema_id()), decltype(std::declval<Request>().message_type())>>
+            : std::true_type {};
+
+        /* Unary call, handled by the worker that received it or, when a
+         * MicroBatcher is given, queued and handled within a batch of
+         * requests of its schema on a scheduler thread. Either way the
+         * response is sent through the queue of the worker.
+         */
+        template <typename Request, typename Response>
+        class UnaryCall : public Call, public MicroBatcher::Item {
+        public:
+            using RequestMethod = void (AsyncService::*)(grpc::ServerContext*, Request*, grpc::ServerAsyncResponseWriter<Response>*,
+                                                         grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+            using HandleMethod = void (RequestHandler::*)(const Request&, Response&);
+
+        private:
+            AsyncService& service;
+            ServiceServer::Worker& worker;
+            RequestMethod requestMethod;
+            HandleMethod handleMethod;
+            MicroBatcher* batcher;
+
+            // Tells apart the requests of the different RPCs in the batcher
+            static inline const char batchKind = 0;
+
+            // Request and response are allocated on the protobuf arena of
+            // the call, whose first block is part of the call itself: small
+            // messages cost no allocation besides the call
+            static constexpr size_t ARENA_BLOCK_SIZE = 4096;
+            alignas(8) char arenaBlock[ARENA_BLOCK_SIZE];
+            google::protobuf::Arena arena;
+
+            grpc::ServerContext context;
+            Request* request;
+            Response* response;
+            grpc::ServerAsyncResponseWriter<Response> responder;
+            // Set by the thread sending the response (a scheduler thread for
+            // the batched calls), read by the worker when the send completes
+            std::atomic<bool> answered{false};
+
+            static google::protobuf::ArenaOptions arenaOptions(char* block) {
+                google::protobuf::ArenaOptions options;
+                options.initial_block = block;
+                options.initial_block_size = ARENA_BLOCK_SIZE;
+                return options;
+            }
+
+            UnaryCall(AsyncService& service, ServiceServer::Worker& worker, RequestMethod requestMethod, HandleMethod handleMethod,
+                      MicroBatcher* batcher)
+                : service(service), worker(worker), requestMethod(requestMethod), handleMethod(handleMethod), batcher(batcher),
+                  arena(arenaOptions(arenaBlock)),
+                  request(google::protobuf::Arena::CreateMessage<Request>(&arena)),
+                  response(google::protobuf::Arena::CreateMessage<Response>(&arena)),
+                  responder(&context) {}
+
+            void finish() {
+                answered.store(true, std::memory_order_release);
+                if (!worker.submit([&] { responder.Finish(*response, grpc::Status::OK, static_cast<Call*>(this)); })) {
+                    delete this;
+                }
+            }
+
+            // Deadline of the client on the clock of the batcher
+            MicroBatcher::Clock::time_point deadline() const {
+                auto clientDeadline = context.deadline();
+                if (clientDeadline == std::chrono::system_clock::time_point::max()) {
+                    return MicroBatcher::Clock::time_point::max();
+                }
+                return MicroBatcher::Clock::now() + std::chrono::duration_cast<MicroBatcher::Clock::duration>(clientDeadline - std::chrono::system_clock::now());
+            }
+
+        public:
+            // Keeps a call of the RPC waiting for the next client
+            static void post(AsyncService& service, ServiceServer::Worker& worker, RequestMethod requestMethod, HandleMethod handleMethod,
+                             MicroBatcher* batcher = nullptr) {
+                auto call = new UnaryCall(service, worker, requestMethod, handleMethod, batcher);
+                if (!worker.submit([&] { (service.*requestMethod)(&call->context, call->request, &call->responder, worker.queue.get(), worker.queue.get(), static_cast<Call*>(call)); })) {
+                    delete call;
+                }
+            }
+
+            void proceed(bool ok) override {
+                if (answered.load(std::memory_order_acquire) || !ok) {
+                    // Response sent, or the server is shutting down
+                    delete this;
+                    return;
+                }
+                post(service, worker, requestMethod, handleMethod, batcher);
+                if constexpr (SchemaAddressed<Request>::value) {
+                    auto schemaId = batcher ? RequestHandler::resolveSchemaId(request->schema_id(), request->message_type()) : std::nullopt;
+                    // Unknown schemas are answered right away
+                    if (schemaId) {
+                        batcher->submit(this, &batchKind, schemaId.value(), deadline());
+                        return;
+                    }
+                }
+                (worker.handler.*handleMethod)(*request, *response);
+                finish();
+            }
+
+            void process(RequestHandler& handler) override {
+                (handler.*handleMethod)(*request, *response);
+                finish();
+            }
+
+            void reject(int status, const std::string& message) override {
+                response->set_response_status(status);
+                response->set_response_message(message);
+                finish();
+            }
+        };
+
+        /* Bidirectional stream of requests of one schema.
+         *
+         * A read and a write can be in flight at the same time: requests keep
+         * being handled while the previous batch of responses is sent. The
+         * responses accumulate in <pending> and are written when the batch is
+         * full, when the coalescing window opened by the first of them
+         * expires, or as soon as the previous write completes when the window
+         * is zero. The call is released once the stream is finished and no
+         * operation is outstanding.
+         */
+        template <typename Request, typename Response, typename StreamResponse>
+        class StreamCall {
+        public:
+            using RequestMethod = void (AsyncService::*)(grpc::ServerContext*, grpc::ServerAsyncReaderWriter<StreamResponse, Request>*,
+                                                         grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+            using HandleMethod = void (RequestHandler::*)(const Request&, Response&);
+
+        private:
+            struct Event : public Call {
+                StreamCall* call;
+                void (StreamCall::*handler)(bool);
+
+                Event(StreamCall* call, void (StreamCall::*handler)(bool)) : call(call), handler(handler) {}
+
+                void proceed(bool ok) override {
+                    StreamCall* owner = call;
+                    owner->outstanding--;
+                    (owner->*handler)(ok);
+                    owner->release();
+                }
+            };
+
+            AsyncService& service;
+            ServiceServer::Worker& worker;
+            RequestMethod requestMethod;
+            HandleMethod handleMethod;
+
+            grpc::ServerContext context;
+            grpc::ServerAsyncReaderWriter<StreamResponse, Request> stream;
+            grpc::Alarm alarm;
+            Event acceptEvent{this, &StreamCall::onAccept};
+            Event readEvent{this, &StreamCall::onRead};
+            Event writeEvent{this, &StreamCall::onWrite};
+            Event alarmEvent{this, &StreamCall::onAlarm};
+            Event finishEvent{this, &StreamCall::onFinish};
+
+            Request request;
+            StreamResponse pending;
+            StreamResponse outgoing;
+
+            // Schema bound to the stream
+            uint32_t boundId = INVALID_SCHEMA_ID;
+            std::string boundType;
+
+            size_t outstanding = 0;
+            bool readsDone = false;
+            bool writing = false;
+            bool alarmArmed = false;
+            bool finishing = false;
+            bool finished = false;
+
+            StreamCall(AsyncService& service, ServiceServer::Worker& worker, RequestMethod requestMethod, HandleMethod handleMethod)
+                : service(service), worker(worker), requestMethod(requestMethod), handleMethod(handleMethod), stream(&context) {}
+
+            template <typename F>
+            void start(F&& operation) {
+                outstanding++;
+                if (!worker.submit(operation)) {
+                    outstanding--;
+                    // Shutting down: no further operation, the call ends as
+                    // soon as the outstanding ones complete
+                    readsDone = true;
+                    finishing = true;
+                    finished = true;
+                }
+            }
+
+            void release() {
+                if (finished && outstanding == 0) {
+                    delete this;
+                }
+            }
+
+            void bindSchema() {
+                if (request.schema_id() == INVALID_SCHEMA_ID && request.message_type().empty()) {
+                    request.set_schema_id(boundId);
+                    request.set_message_type(boundType);
+                    return;
+                }
+                if (request.schema_id() != INVALID_SCHEMA_ID && request.schema_id() == boundId) {
+                    request.set_message_type(boundType);
+                    return;
+                }
+                if (request.schema_id() == INVALID_SCHEMA_ID && request.message_type() == boundType && boundId != INVALID_SCHEMA_ID) {
+                    request.set_schema_id(boundId);
+                    return;
+                }
+                // First request of the stream or schema changed: resolved once here
+                auto schemaId = request.schema_id() != INVALID_SCHEMA_ID ? std::optional<SchemaId>(request.schema_id())
+                                                                         : SchemaCatalog::getInstance().resolve(request.message_type());
+                if (!schemaId) {
+                    return;
+                }
+                std::string messageType = request.message_type();
+                if (messageType.empty()) {
+                    auto schema = SchemaCatalog::getInstance().getSchema(schemaId.value());
+                    messageType = schema ? schema->getCatalogName() : std::string();
+                }
+                boundId = schemaId.value();
+                boundType = messageType;
+                request.set_schema_id(boundId);
+                request.set_message_type(boundType);
+            }
+
+            void flush() {
+                if (writing || finishing) {
+                    return;
+                }
+                if (pending.responses_size() > 0) {
+                    outgoing.Swap(&pending);
+                    pending.Clear();
+                    writing = true;
+                    start([&] { stream.Write(outgoing, &writeEvent); });
+                } else if (readsDone) {
+                    finishing = true;
+                    if (alarmArmed) {
+                        alarm.Cancel();
+                    }
+                    start([&] { stream.Finish(grpc::Status::OK, &finishEvent); });
+                }
+            }
+
+            void armAlarm() {
+                if (alarmArmed || worker.options->streamWindow.count() == 0) {
+                    return;
+                }
+                alarmArmed = true;
+                auto deadline = std::chrono::system_clock::now() + worker.options->streamWindow;
+                start([&] { alarm.Set(worker.queue.get(), deadline, &alarmEvent); });
+            }
+
+            void onAccept(bool ok) {
+                if (!ok) {
+                    finished = true;
+                    return;
+                }
+                post(service, worker, requestMethod, handleMethod);
+                start([&] { stream.Read(&request, &readEvent); });
+            }
+
+            void onRead(bool ok) {
+                if (!ok || finishing) {
+                    // The client is done writing (or the call is gone)
+                    readsDone = true;
+                    flush();
+                    return;
+                }
+                bindSchema();
+                (worker.handler.*handleMethod)(request, *pending.add_responses());
+                request.Clear();
+
+                if (static_cast<size_t>(pending.responses_size()) >= worker.options->streamBatchSize ||
+                    worker.options->streamWindow.count() == 0) {
+                    flush();
+                } else {
+                    armAlarm();
+                }
+                if (!finished) {
+                    start([&] { stream.Read(&request, &readEvent); });
+                }
+            }
+
+            void onWrite(bool ok) {
+                writing = false;
+                outgoing.Clear();
+                if (!ok) {
+                    // The client went away: nothing else can be delivered
+                    pending.Clear();
+                    readsDone = true;
+                }
+                if (readsDone || worker.options->streamWindow.count() == 0 ||
+                    static_cast<size_t>(pending.responses_size()) >= worker.options->streamBatchSize) {
+                    flush();
+                } else if (pending.responses_size() > 0) {
+                    armAlarm();
+                }
+            }
+
+            void onAlarm(bool) {
+                alarmArmed = false;
+                flush();
+            }
+
+            void onFinish(bool) {
+                finished = true;
+            }
+
+        public:
+            static void post(AsyncService& service, ServiceServer::Worker& worker, RequestMethod requestMethod, HandleMethod handleMethod) {
+                auto call = new StreamCall(service, worker, requestMethod, handleMethod);
+                call->start([&] { (service.*requestMethod)(&call->context, &call->stream, worker.queue.get(), worker.queue.get(), &call->acceptEvent); });
+                call->release();
+            }
+        };
+
+        template <typename CallType, typename... Extra>
+        void postCalls(AsyncService& service, ServiceServer::Worker& worker, size_t count,
+                       typename CallType::RequestMethod requestMethod, typename CallType::HandleMethod handleMethod, Extra... extra) {
+            for (size_t i = 0; i < count; i++) {
+                CallType::post(service, worker, requestMethod, handleMethod, extra...);
+            }
+        }
+
+    }
+
+    ServiceServer::ServiceServer(const ServerOptions& options) : options(options) {}
+
+    ServiceServer::~ServiceServer() {
+        shutdown();
+    }
+
+    int ServiceServer::start() {
+        if (server) {
+            Logger::getInstance().log("The server is already running", Logger::Level::WARNING);
+            return 1;
+        }
+        size_t workerCount = options.workers;
+        if (workerCount == 0) {
+            workerCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        if (options.batchThreads > 0) {
+            TaskPoolOptions poolOptions;
+            poolOptions.threads = options.batchThreads;
+            poolOptions.pinning = options.pinning;
+            taskPool = std::make_unique<TaskPool>(poolOptions);
+            batchEngine = std::make_unique<BatchEngine>(*taskPool, options.batchChunkSize);
+        }
+        if (options.microBatch.window.count() > 0) {
+            microBatcher = std::make_unique<MicroBatcher>(options.microBatch, batchEngine.get());
+        }
+
+        grpc::ServerBuilder builder;
+        builder.AddListeningPort(options.address, grpc::InsecureServerCredentials(), &selectedPort);
+        builder.RegisterService(&service);
+        for (size_t i = 0; i < workerCount; i++) {
+            auto worker = std::make_unique<Worker>();
+            worker->queue = builder.AddCompletionQueue();
+            worker->options = &options;
+            worker->handler.setBatchEngine(batchEngine.get());
+            workers.push_back(std::move(worker));
+        }
+        server = builder.BuildAndStart();
+        if (!server) {
+            Logger::getInstance().log("Error in starting the server on <" + options.address + ">", Logger::Level::ERROR);
+            workers.clear();
+            microBatcher.reset();
+            batchEngine.reset();
+            taskPool.reset();
+            return 1;
+        }
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            auto& worker = workers[i];
+            postCalls<UnaryCall<interface::toJsonRequest, interface::toJsonResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoJson, &RequestHandler::toJson, microBatcher.get());
+            postCalls<UnaryCall<interface::toBitsRequest, interface::toBitsResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoBits, &RequestHandler::toBits, microBatcher.get());
+            postCalls<UnaryCall<interface::resolveSchemaRequest, interface::resolveSchemaResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequestresolveSchema, &RequestHandler::resolveSchema);
+            postCalls<UnaryCall<interface::classifyRequest, interface::classifyResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::Requestclassify, &RequestHandler::classify);
+            postCalls<UnaryCall<interface::toJsonBatchRequest, interface::toJsonBatchResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoJsonBatch, &RequestHandler::toJsonBatch);
+            postCalls<UnaryCall<interface::toBitsBatchRequest, interface::toBitsBatchResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoBitsBatch, &RequestHandler::toBitsBatch);
+            postCalls<UnaryCall<interface::toJsonRequest, interface::toFieldsResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoFields, &RequestHandler::toFields, microBatcher.get());
+            postCalls<UnaryCall<interface::pathTableRequest, interface::pathTableResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequestgetPathTable, &RequestHandler::getPathTable);
+            postCalls<StreamCall<interface::toJsonRequest, interface::toJsonResponse, interface::toJsonStreamResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoJsonStream, &RequestHandler::toJson);
+            postCalls<StreamCall<interface::toBitsRequest, interface::toBitsResponse, interface::toBitsStreamResponse>>(
+                service, *worker, options.pendingCalls, &AsyncService::RequesttoBitsStream, &RequestHandler::toBits);
+            worker->thread = std::thread(&ServiceServer::run, this, std::ref(*worker));
+            if (pinThread(worker->thread.native_handle(), options.pinning, i)) {
+                Logger::getInstance().log("Unable to pin the server worker <" + std::to_string(i) + ">", Logger::Level::WARNING);
+            }
+        }
+
+        Logger::getInstance().log("Server listening on <" + options.address + "> with " + std::to_string(workers.size()) + " workers", Logger::Level::INFO);
+        return 0;
+    }
+
+    void ServiceServer::run(Worker& worker) {
+        void* tag;
+        bool ok;
+        // Next() returns false once the queue is shut down and drained
+        while (worker.queue->Next(&tag, &ok)) {
+            static_cast<Call*>(tag)->proceed(ok);
+        }
+    }
+
+    void ServiceServer::shutdown() {
+        if (!server) {
+            return;
+        }
+        // Open calls get <shutdownTimeout> to complete and are then
+        // cancelled, the calls waiting for a client complete with ok = false.
+        // Once the queues are closed the workers only release the calls
+        // whose last operation completes, then they exit
+        server->Shutdown(std::chrono::system_clock::now() + options.shutdownTimeout);
+        for (auto& worker : workers) {
+            std::lock_guard<std::mutex> lock(worker->queueMutex);
+            worker->queueOpen = false;
+            worker->queue->Shutdown();
+        }
+        // The requests still queued in the batcher are released without
+        // response, before their workers go away
+        microBatcher.reset();
+        for (auto& worker : workers) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
+        workers.clear();
+        batchEngine.reset();
+        taskPool.reset();
+        server.reset();
+        Logger::getInstance().log("Server stopped", Logger::Level::INFO);
+    }
+
+}
@@ -0,0 +1,85 @@
+#include <string>
+
+#include "opencmd.hpp"
+#include "Check.hpp"
+
+using namespace opencmd;
+
+// Decodes and encodes again messages with arrays: sized by a field of the
+// message or fixed, with items and without any (the decoder writes no key
+// for an empty array, the encoder must not ask for one).
+
+namespace {
+
+    const char* SCHEMA_NAME = "array_encode_test";
+    const char* FIXED_SCHEMA_NAME = "array_encode_test_fixed";
+
+    // A 4 bits length, the bytes it counts, then an 8 bits trailer
+    bool loadSchemas() {
+        nlohmann::json jsonSchema = {
+            {"version", "1.0"},
+            {"metadata", {{"name", SCHEMA_NAME}}},
+            {"structure",
+             {{{"type", "unsigned integer"}, {"name", "length"}, {"attributes", {{"bit_length", 4}}}},
+              {{"type", "array"},
+               {"name", "data"},
+               {"structure", {{{"type", "unsigned integer"}, {"attributes", {{"bit_length", 8}}}}}},
+               {"attributes", {{"repetitions", "/length"}}}},
+              {{"type", "unsigned integer"}, {"name", "trailer"}, {"attributes", {{"bit_length", 8}}}}}}};
+        nlohmann::json fixedSchema = {
+            {"version", "1.0"},
+            {"metadata", {{"name", FIXED_SCHEMA_NAME}}},
+            {"structure",
+             {{{"type", "array"},
+               {"name", "data"},
+               {"structure", {{{"type", "unsigned integer"}, {"attributes", {{"bit_length", 8}}}}}},
+               {"attributes", {{"repetitions", 0}}}},
+              {{"type", "unsigned integer"}, {"name", "trailer"}, {"attributes", {{"bit_length", 8}}}}}}};
+        return SchemaCatalog::getInstance().parseSchema(SCHEMA_NAME, jsonSchema) == 0 &&
+               SchemaCatalog::getInstance().parseSchema(FIXED_SCHEMA_NAME, fixedSchema) == 0;
+    }
+
+    // Decodes <bitLength> bits of <message>, encodes the fields again and
+    // checks the frame is the same
+    void checkRoundTrip(DecoderContext& context, const char* schemaName, const std::string& message, size_t bitLength) {
+        SchemaId id = SchemaCatalog::getInstance().resolve(schemaName).value_or(INVALID_SCHEMA_ID);
+        BitStream input = BitStream::view(reinterpret_cast<const uint8_t*>(message.data()), bitLength);
+        nlohmann::ordered_json fields;
+        OPENCMD_CHECK(context.bitstream_to_json(id, input, fields) == 0);
+
+        BitStream output;
+        OPENCMD_CHECK(context.json_to_bitstream(id, nlohmann::json(fields), output) == 0);
+        OPENCMD_CHECK(output.getCapacity() == bitLength);
+        OPENCMD_CHECK(std::string(reinterpret_cast<const char*>(output.getBuffer()), output.getByteLength()) == message);
+    }
+
+    void testReferencedLength(DecoderContext& context) {
+        // length 2, data 0xAB 0xCD, trailer 0x7E
+        checkRoundTrip(context, SCHEMA_NAME, std::string("\x2A\xBC\xD7\xE0", 4), 28);
+        // length 0, no data, trailer 0x7E
+        checkRoundTrip(context, SCHEMA_NAME, std::string("\x07\xE0", 2), 12);
+
+        // Without the items of a non empty array the message is refused
+        SchemaId id = SchemaCatalog::getInstance().resolve(SCHEMA_NAME).value_or(INVALID_SCHEMA_ID);
+        BitStream output;
+        nlohmann::json missingItems = {{"/length", 2}, {"/trailer", 0x7E}};
+        OPENCMD_CHECK(context.json_to_bitstream(id, missingItems, output) != 0);
+    }
+
+    void testFixedLength(DecoderContext& context) {
+        checkRoundTrip(context, FIXED_SCHEMA_NAME, std::string("\x7E", 1), 8);
+    }
+
+}
+
+int main() {
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    OPENCMD_CHECK(loadSchemas());
+    if (opencmd::test::failures) {
+        return opencmd::test::failures;
+    }
+    DecoderContext context;
+    testReferencedLength(context);
+    testFixedLength(context);
+    return opencmd::test::failures;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "opencmd.hpp"
+#include "Check.hpp"
+
+using namespace opencmd;
+
+// Compares BitStream::search and BitStream::shift with bit by bit loops:
+// patterns shorter than the 16 bits of the vector scan and of lengths not
+// multiple of 8, [from, to) bounds, streams whose length is not a multiple
+// of 8, shifts by whole bytes (8 * k) and by any number of bits.
+
+namespace {
+
+    std::mt19937_64 generator(7);
+
+    // Stream layout: bit 0 is the most significant bit of byte 0
+    bool streamBit(const uint8_t* data, size_t position) {
+        return (data[position / 8] >> (7 - position % 8)) & 1;
+    }
+
+    void setStreamBit(uint8_t* data, size_t position, bool value) {
+        uint8_t mask = static_cast<uint8_t>(0x80 >> (position % 8));
+        data[position / 8] = value ? (data[position / 8] | mask) : (data[position / 8] & ~mask);
+    }
+
+    std::vector<size_t> naiveSearch(const std::vector<uint8_t>& data, size_t bitLength, const std::vector<uint8_t>& pattern, size_t patternLength,
+                                    size_t from, size_t to) {
+        std::vector<size_t> positions;
+        for (size_t position = from; position < to && position + patternLength <= bitLength; position++) {
+            size_t i = 0;
+            while (i < patternLength && streamBit(data.data(), position + i) == streamBit(pattern.data(), i)) {
+                i++;
+            }
+            if (i == patternLength) {
+                positions.push_back(position);
+            }
+        }
+        return positions;
+    }
+
+    std::vector<uint8_t> randomBytes(size_t size) {
+        std::vector<uint8_t> bytes(size);
+        for (auto& byte : bytes) {
+            byte = static_cast<uint8_t>(generator());
+        }
+        return bytes;
+    }
+
+    // <bitLength> random bits with <pattern> planted at a few positions,
+    // overlapping ones included
+    std::vector<uint8_t> plantedStream(size_t bitLength, const std::vector<uint8_t>& pattern, size_t patternLength) {
+        std::vector<uint8_t> data = randomBytes((bitLength + 7) / 8);
+        if (patternLength > bitLength) {
+            return data;
+        }
+        for (int planted = 0; planted < 6; planted++) {
+            size_t position = generator() % (bitLength - patternLength + 1);
+            if (planted % 3 == 2 && position + patternLength / 2 + patternLength <= bitLength) {
+                // Right after the previous one, overlapping it
+                position += patternLength / 2;
+            }
+            for (size_t i = 0; i < patternLength; i++) {
+                setStreamBit(data.data(), position + i, streamBit(pattern.data(), i));
+            }
+        }
+        return data;
+    }
+
+    void checkSearch(const std::vector<uint8_t>& data, size_t bitLength, const std::vector<uint8_t>& pattern, size_t patternLength, size_t from,
+                     size_t to) {
+        BitStream bitStream;
+        bitStream.set(data.data(), bitLength);
+        std::vector<size_t> expected = naiveSearch(data, bitLength, pattern, patternLength, from, to);
+        std::vector<size_t> found = bitStream.search(pattern.data(), patternLength, from, to);
+        OPENCMD_CHECK(found == expected);
+        if (found != expected) {
+            std::fprintf(stderr, "  pattern of %zu bits in %zu bits, [%zu, %zu): %zu found, %zu expected\n", patternLength, bitLength, from, to,
+                         found.size(), expected.size());
+        }
+    }
+
+    void testSearch() {
+        const size_t patternLengths[] = {1, 3, 5, 7, 8, 9, 12, 13, 15, 16, 17, 23, 24, 31, 33, 56, 57, 63, 64, 100};
+        const size_t bitLengths[] = {1, 7, 15, 64, 101, 517, 1003, 4096, 4099};
+        for (size_t patternLength : patternLengths) {
+            for (size_t bitLength : bitLengths) {
+                std::vector<uint8_t> pattern = randomBytes((patternLength + 7) / 8);
+                std::vector<uint8_t> data = plantedStream(bitLength, pattern, patternLength);
+                checkSearch(data, bitLength, pattern, patternLength, 0, SIZE_MAX);
+                // Bounds on and off the byte boundaries, past the end, empty
+                for (int range = 0; range < 8; range++) {
+                    size_t from = generator() % (bitLength + 2);
+                    size_t to = range == 0 ? SIZE_MAX : from + generator() % (bitLength + 9);
+                    checkSearch(data, bitLength, pattern, patternLength, from, to);
+                }
+                checkSearch(data, bitLength, pattern, patternLength, bitLength / 2, bitLength / 2);
+                checkSearch(data, bitLength, pattern, patternLength, 5, 3);
+            }
+        }
+
+        // Every position matches: the overlapping occurrences are all found
+        for (size_t patternLength : {1, 7, 16, 31, 64}) {
+            std::vector<uint8_t> ones(128, 0xFF);
+            std::vector<uint8_t> pattern(8, 0xFF);
+            checkSearch(ones, 1021, pattern, patternLength, 0, SIZE_MAX);
+            checkSearch(ones, 1021, pattern, patternLength, 3, 900);
+        }
+
+        // A pattern longer than the stream
+        std::vector<uint8_t> data = randomBytes(2);
+        std::vector<uint8_t> pattern = randomBytes(3);
+        checkSearch(data, 13, pattern, 17, 0, SIZE_MAX);
+    }
+
+    // The bytes as one little endian integer: byte 0 least significant
+    std::vector<uint8_t> naiveShift(const std::vector<uint8_t>& data, size_t amount, bool right) {
+        const size_t bits = data.size() * 8;
+        auto bit = [&](size_t k) { return k < bits && ((data[k / 8] >> (k % 8)) & 1); };
+        std::vector<uint8_t> shifted(data.size(), 0);
+        for (size_t k = 0; k < bits; k++) {
+            bool value = right ? bit(k + amount) : (k >= amount && bit(k - amount));
+            if (value) {
+                shifted[k / 8] |= static_cast<uint8_t>(1 << (k % 8));
+            }
+        }
+        return shifted;
+    }
+
+    void testShift() {
+        for (size_t bitLength : {8, 13, 64, 67, 1000, 1003}) {
+            std::vector<uint8_t> data = randomBytes((bitLength + 7) / 8);
+            std::vector<size_t> amounts;
+            for (size_t k = 0; 8 * k <= bitLength; k++) {
+                amounts.push_back(8 * k);
+            }
+            for (int i = 0; i < 16; i++) {
+                amounts.push_back(1 + generator() % bitLength);
+            }
+            for (size_t amount : amounts) {
+                for (bool right : {false, true}) {
+                    BitStream bitStream;
+                    bitStream.set(data.data(), bitLength);
+                    bitStream.shift(amount, right);
+                    std::vector<uint8_t> shifted(bitStream.getBuffer(), bitStream.getBuffer() + bitStream.getByteLength());
+                    OPENCMD_CHECK(bitStream.getCapacity() == bitLength);
+                    OPENCMD_CHECK(shifted == naiveShift(data, amount, right));
+                    if (shifted != naiveShift(data, amount, right)) {
+                        std::fprintf(stderr, "  %s shift by %zu of %zu bits\n", right ? "right" : "left", amount, bitLength);
+                    }
+                }
+            }
+
+            // Shifting out more bits than the stream has clears it
+            BitStream bitStream;
+            bitStream.set(data.data(), bitLength);
+            bitStream.shift(bitLength + 1, true);
+            OPENCMD_CHECK(std::all_of(bitStream.getBuffer(), bitStream.getBuffer() + bitStream.getByteLength(), [](uint8_t byte) { return byte == 0; }));
+        }
+    }
+
+}
+
+int main() {
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    testSearch();
+    testShift();
+    return opencmd::test::failures;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the test executables: a failed check is reported
+// and counted, the test returns the count as its exit status
+namespace opencmd::test {
+
+    inline int failures = 0;
+
+}
+
+#define OPENCMD_CHECK(condition)                                                         \
+    do {                                                                                 \
+        if (!(condition)) {                                                              \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            opencmd::test::failures++;                                                   \
+        }                                                                                \
+    } while (0)
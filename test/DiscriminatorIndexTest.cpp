@@ -0,0 +1,130 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "opencmd.hpp"
+#include "Check.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Builds discriminator indexes from synthetic schemas and classifies
+// messages with them: the candidates and their order, messages too short for
+// a field, many schemas constraining unrelated fields (one table per field,
+// built in linear time) and the MAX_KEYS limit.
+
+namespace {
+
+    // <padding> unconstrained bytes, then one byte per entry of <allowed>
+    // (an empty entry leaves the byte unconstrained)
+    std::shared_ptr<const Schema> makeSchema(const std::string& name, size_t padding, const std::vector<std::vector<uint64_t>>& allowed) {
+        nlohmann::json structure = nlohmann::json::array();
+        for (size_t i = 0; i < padding; i++) {
+            structure.push_back({{"type", "unsigned integer"}, {"name", "pad" + std::to_string(i)}, {"attributes", {{"bit_length", 8}}}});
+        }
+        for (size_t i = 0; i < allowed.size(); i++) {
+            nlohmann::json attributes = {{"bit_length", 8}};
+            if (!allowed[i].empty()) {
+                attributes["allowed_values"] = allowed[i];
+            }
+            structure.push_back({{"type", "unsigned integer"}, {"name", "field" + std::to_string(i)}, {"attributes", attributes}});
+        }
+        nlohmann::json jsonSchema = {{"version", "1.0"}, {"metadata", {{"name", name}}}, {"structure", structure}};
+        if (SchemaCatalog::getInstance().parseSchema(name, jsonSchema)) {
+            return nullptr;
+        }
+        return SchemaCatalog::getInstance().getSchema(name);
+    }
+
+    std::vector<SchemaId> classify(const DiscriminatorIndex& index, const std::vector<uint8_t>& message) {
+        return index.classify(BitStream::view(message.data(), message.size() * 8));
+    }
+
+    void testCandidates() {
+        auto specific = makeSchema("candidates_specific", 0, {{1}, {2}});
+        auto general = makeSchema("candidates_general", 0, {{1, 5}});
+        auto open = makeSchema("candidates_open", 0, {{}});
+        OPENCMD_CHECK(specific && general && open);
+        if (!specific || !general || !open) {
+            return;
+        }
+        auto index = DiscriminatorIndex::build({open, general, specific});
+        OPENCMD_CHECK(index.keyCount() == 2);
+
+        // The most specific schemas come first
+        OPENCMD_CHECK((classify(index, {1, 2}) == std::vector<SchemaId>{specific->getId(), general->getId(), open->getId()}));
+        OPENCMD_CHECK((classify(index, {1, 3}) == std::vector<SchemaId>{general->getId(), open->getId()}));
+        OPENCMD_CHECK((classify(index, {5, 2}) == std::vector<SchemaId>{general->getId(), open->getId()}));
+        OPENCMD_CHECK((classify(index, {9, 9}) == std::vector<SchemaId>{open->getId()}));
+        // The second field cannot be read: the schema constraining it is out
+        OPENCMD_CHECK((classify(index, {1}) == std::vector<SchemaId>{general->getId(), open->getId()}));
+
+        OPENCMD_CHECK(DiscriminatorIndex::build({}).empty());
+        OPENCMD_CHECK(DiscriminatorIndex::build({}).classify(BitStream()).empty());
+    }
+
+    // Schema i constrains the byte at offset i to i + 1 and nothing else, so
+    // no two schemas share a field
+    std::vector<std::shared_ptr<const Schema>> makeUnrelatedSchemas(const std::string& prefix, size_t count) {
+        std::vector<std::shared_ptr<const Schema>> schemas;
+        for (size_t i = 0; i < count; i++) {
+            schemas.push_back(makeSchema(prefix + std::to_string(i), i, {{(i + 1) % 256}}));
+        }
+        return schemas;
+    }
+
+    void testUnrelatedSchemas() {
+        const size_t count = 200;
+        auto schemas = makeUnrelatedSchemas("unrelated_", count);
+        for (const auto& schema : schemas) {
+            OPENCMD_CHECK(schema != nullptr);
+            if (!schema) {
+                return;
+            }
+        }
+
+        auto start = Clock::now();
+        auto index = DiscriminatorIndex::build(schemas);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        OPENCMD_CHECK(index.keyCount() == count);
+        OPENCMD_CHECK(seconds < 1.0);
+
+        std::vector<uint8_t> message(count, 0);
+        OPENCMD_CHECK(classify(index, message).empty());
+        for (size_t i : {size_t(0), size_t(63), size_t(64), size_t(130), count - 1}) {
+            message.assign(count, 0);
+            message[i] = static_cast<uint8_t>((i + 1) % 256);
+            OPENCMD_CHECK((classify(index, message) == std::vector<SchemaId>{schemas[i]->getId()}));
+        }
+    }
+
+    void testKeyLimit() {
+        const size_t count = DiscriminatorIndex::MAX_KEYS + 44;
+        auto schemas = makeUnrelatedSchemas("limit_", count);
+        for (const auto& schema : schemas) {
+            OPENCMD_CHECK(schema != nullptr);
+            if (!schema) {
+                return;
+            }
+        }
+        auto index = DiscriminatorIndex::build(schemas);
+        OPENCMD_CHECK(index.keyCount() == DiscriminatorIndex::MAX_KEYS);
+
+        // No schema allows its field, but the fields left out are not
+        // checked: their schemas stay candidates
+        std::vector<uint8_t> message(count);
+        for (size_t i = 0; i < count; i++) {
+            message[i] = static_cast<uint8_t>(i % 256);
+        }
+        OPENCMD_CHECK(classify(index, message).size() == count - DiscriminatorIndex::MAX_KEYS);
+    }
+
+}
+
+int main() {
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    testCandidates();
+    testUnrelatedSchemas();
+    testKeyLimit();
+    return opencmd::test::failures;
+}
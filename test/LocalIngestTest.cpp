@@ -0,0 +1,75 @@
+#include <string>
+
+#include <unistd.h>
+
+#include "opencmd.hpp"
+#include "ipc/LocalClient.hpp"
+#include "server/LocalIngest.hpp"
+#include "Check.hpp"
+
+using namespace opencmd;
+
+// Sends valid and invalid frames through the shared memory transport: each
+// invalid one gets its own error status, and the session keeps serving the
+// frames that follow.
+
+namespace {
+
+    const char* SCHEMA_NAME = "local_ingest_test";
+
+    // A fixed header byte and a 16 bits value
+    SchemaId loadSchema() {
+        nlohmann::json jsonSchema = {
+            {"version", "1.0"},
+            {"metadata", {{"name", SCHEMA_NAME}}},
+            {"structure",
+             {{{"type", "unsigned integer"}, {"name", "header"}, {"attributes", {{"bit_length", 8}, {"allowed_values", {0xA5}}}}},
+              {{"type", "unsigned integer"}, {"name", "value"}, {"attributes", {{"bit_length", 16}}}}}}};
+        if (SchemaCatalog::getInstance().parseSchema(SCHEMA_NAME, jsonSchema)) {
+            return INVALID_SCHEMA_ID;
+        }
+        return SchemaCatalog::getInstance().resolve(SCHEMA_NAME).value_or(INVALID_SCHEMA_ID);
+    }
+
+    int decode(LocalClient& client, uint32_t schemaId, const uint8_t* data, size_t bitLength) {
+        LocalClient::Result result;
+        if (!client.send(schemaId, data, bitLength, nullptr, 1000) || !client.receive(result, 5000)) {
+            return -1;
+        }
+        return result.status;
+    }
+
+}
+
+int main() {
+    Logger::getInstance().setSeverity(Logger::Level::CRITICAL);
+    SchemaId schemaId = loadSchema();
+    OPENCMD_CHECK(schemaId != INVALID_SCHEMA_ID);
+
+    LocalIngestOptions options;
+    options.socketPath = "/tmp/opencmd_local_ingest_test_" + std::to_string(::getpid()) + ".sock";
+    options.requestRingSize = size_t(1) << 16;
+    options.responseRingSize = size_t(1) << 16;
+    LocalIngest ingest(options);
+    OPENCMD_CHECK(ingest.start() == 0);
+    LocalClient client;
+    OPENCMD_CHECK(client.connect(options.socketPath) == 0);
+    if (opencmd::test::failures) {
+        return opencmd::test::failures;
+    }
+
+    const uint8_t frame[] = {0xA5, 0x12, 0x34};
+    OPENCMD_CHECK(decode(client, schemaId, frame, 24) == 0);
+    // Unknown schema ids, however large
+    OPENCMD_CHECK(decode(client, 0xFFFFFFF0, frame, 24) == LocalIngest::STATUS_UNKNOWN_SCHEMA);
+    OPENCMD_CHECK(decode(client, 100000000, frame, 24) == LocalIngest::STATUS_UNKNOWN_SCHEMA);
+    // The schema reads past the end of the frame
+    OPENCMD_CHECK(decode(client, schemaId, frame, 8) == LocalIngest::STATUS_INVALID_REQUEST);
+    // Empty frames are refused by the client
+    OPENCMD_CHECK(!client.send(schemaId, frame, 0));
+    OPENCMD_CHECK(decode(client, schemaId, frame, 24) == 0);
+
+    client.close();
+    ingest.stop();
+    return opencmd::test::failures;
+}
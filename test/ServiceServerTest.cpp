@@ -0,0 +1,308 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <grpcpp/grpcpp.h>
+
+#include "service.grpc.pb.h"
+
+#include "opencmd.hpp"
+#include "server/ServiceServer.hpp"
+#include "Check.hpp"
+
+using namespace opencmd;
+
+// Starts the service on a free local port and on a unix socket, and calls
+// it through the generated stub: toJson, toBits, resolveSchema and classify
+// with their 400 (invalid request) and 404 (unknown schema) answers, then
+// many concurrent clients against the same server.
+
+namespace {
+
+    const char* SCHEMA_NAME = "server_test";
+    const char* WIDE_SCHEMA_NAME = "server_test_wide";
+    constexpr uint8_t HEADER = 0xA5;
+    constexpr uint8_t WIDE_HEADER = 0x5A;
+
+    // A fixed header byte (discriminating field) and a 16 bits value
+    bool loadSchema() {
+        nlohmann::json jsonSchema = {
+            {"version", "1.0"},
+            {"metadata", {{"name", SCHEMA_NAME}}},
+            {"structure",
+             {{{"type", "unsigned integer"}, {"name", "header"}, {"attributes", {{"bit_length", 8}, {"allowed_values", {HEADER}}}}},
+              {{"type", "unsigned integer"}, {"name", "value"}, {"attributes", {{"bit_length", 16}}}}}}};
+        // The same with a 64 bits value
+        nlohmann::json wideSchema = {
+            {"version", "1.0"},
+            {"metadata", {{"name", WIDE_SCHEMA_NAME}}},
+            {"structure",
+             {{{"type", "unsigned integer"}, {"name", "header"}, {"attributes", {{"bit_length", 8}, {"allowed_values", {WIDE_HEADER}}}}},
+              {{"type", "unsigned integer"}, {"name", "value"}, {"attributes", {{"bit_length", 64}}}}}}};
+        return SchemaCatalog::getInstance().parseSchema(SCHEMA_NAME, jsonSchema) == 0 &&
+               SchemaCatalog::getInstance().parseSchema(WIDE_SCHEMA_NAME, wideSchema) == 0;
+    }
+
+    std::string message(uint16_t value) {
+        return std::string{static_cast<char>(HEADER), static_cast<char>(value >> 8), static_cast<char>(value & 0xFF)};
+    }
+
+    std::unique_ptr<interface::service::Stub> connect(const std::string& address) {
+        // A channel of its own for every client, not shared with the others
+        grpc::ChannelArguments arguments;
+        arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        return interface::service::NewStub(grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), arguments));
+    }
+
+    void testResolveSchema(interface::service::Stub& stub) {
+        grpc::ClientContext context;
+        interface::resolveSchemaRequest request;
+        interface::resolveSchemaResponse response;
+        request.set_message_type(SCHEMA_NAME);
+        OPENCMD_CHECK(stub.resolveSchema(&context, request, &response).ok());
+        OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_OK);
+        OPENCMD_CHECK(response.schema_id() == SchemaCatalog::getInstance().resolve(SCHEMA_NAME).value_or(INVALID_SCHEMA_ID));
+
+        grpc::ClientContext missingContext;
+        interface::resolveSchemaResponse missing;
+        request.set_message_type("server_test_missing");
+        OPENCMD_CHECK(stub.resolveSchema(&missingContext, request, &missing).ok());
+        OPENCMD_CHECK(missing.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+        OPENCMD_CHECK(missing.response_status() == 404);
+    }
+
+    void testToJson(interface::service::Stub& stub) {
+        interface::toJsonRequest request;
+        request.set_message_type(SCHEMA_NAME);
+        request.set_message(message(0x1234));
+        {
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            OPENCMD_CHECK(stub.toJson(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_OK);
+            auto json = nlohmann::json::parse(response.message_json(), nullptr, false);
+            OPENCMD_CHECK(!json.is_discarded() && json.value("header", 0) == HEADER && json.value("value", 0) == 0x1234);
+        }
+        {
+            // The schema reads past the end of the message
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            request.set_message(message(0x1234).substr(0, 2));
+            OPENCMD_CHECK(stub.toJson(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == 400);
+        }
+        {
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            request.set_message(message(0x1234));
+            request.set_bit_length(40);
+            OPENCMD_CHECK(stub.toJson(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_INVALID_REQUEST);
+        }
+        {
+            // Padding longer than the data
+            interface::toJsonRequest base64Request;
+            base64Request.set_message_type(SCHEMA_NAME);
+            base64Request.set_message_base64("A===");
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            OPENCMD_CHECK(stub.toJson(&context, base64Request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_INVALID_REQUEST);
+
+            interface::classifyRequest classifyRequest;
+            classifyRequest.set_message_base64("A===");
+            grpc::ClientContext classifyContext;
+            interface::classifyResponse classifyResponse;
+            OPENCMD_CHECK(stub.classify(&classifyContext, classifyRequest, &classifyResponse).ok());
+            OPENCMD_CHECK(classifyResponse.response_status() == RequestHandler::STATUS_INVALID_REQUEST);
+        }
+        {
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            request.set_bit_length(0);
+            request.set_message_type("server_test_missing");
+            OPENCMD_CHECK(stub.toJson(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+        }
+        // Schema ids no schema was given: the per worker caches must not
+        // grow to them
+        for (uint32_t schemaId : {0xFFFFFFF0u, 100000000u}) {
+            request.set_message_type("");
+            request.set_schema_id(schemaId);
+            grpc::ClientContext context;
+            interface::toJsonResponse response;
+            OPENCMD_CHECK(stub.toJson(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+
+            grpc::ClientContext fieldsContext;
+            interface::toFieldsResponse fields;
+            OPENCMD_CHECK(stub.toFields(&fieldsContext, request, &fields).ok());
+            OPENCMD_CHECK(fields.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+        }
+    }
+
+    // Unsigned integer fields come as uint_value, all of their 64 bits too
+    void testToFields(interface::service::Stub& stub) {
+        const uint64_t wideValue = 0x8000000000000001ULL;
+        interface::toJsonRequest request;
+        request.set_message_type(WIDE_SCHEMA_NAME);
+        std::string wideMessage(1, static_cast<char>(WIDE_HEADER));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            wideMessage += static_cast<char>(wideValue >> shift);
+        }
+        request.set_message(wideMessage);
+        grpc::ClientContext context;
+        interface::toFieldsResponse response;
+        OPENCMD_CHECK(stub.toFields(&context, request, &response).ok());
+        OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_OK);
+        OPENCMD_CHECK(response.fields_size() == 2);
+        if (response.fields_size() == 2) {
+            OPENCMD_CHECK(response.fields(0).value_case() == interface::fieldValue::kUintValue);
+            OPENCMD_CHECK(response.fields(0).uint_value() == WIDE_HEADER);
+            OPENCMD_CHECK(response.fields(1).value_case() == interface::fieldValue::kUintValue);
+            OPENCMD_CHECK(response.fields(1).uint_value() == wideValue);
+        }
+    }
+
+    // toBits gives back the frame toJson decodes, and toJson the fields
+    void testToBits(interface::service::Stub& stub) {
+        interface::toBitsRequest request;
+        request.set_message_type(SCHEMA_NAME);
+        request.set_message_json("{\"header\":165,\"value\":4660}");
+        request.set_binary_output(true);
+        {
+            grpc::ClientContext context;
+            interface::toBitsResponse response;
+            OPENCMD_CHECK(stub.toBits(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_OK);
+            OPENCMD_CHECK(response.message() == message(0x1234));
+            OPENCMD_CHECK(response.bit_length() == 24);
+
+            grpc::ClientContext decodeContext;
+            interface::toJsonRequest decodeRequest;
+            interface::toJsonResponse decoded;
+            decodeRequest.set_message_type(SCHEMA_NAME);
+            decodeRequest.set_message(response.message());
+            decodeRequest.set_bit_length(response.bit_length());
+            OPENCMD_CHECK(stub.toJson(&decodeContext, decodeRequest, &decoded).ok());
+            OPENCMD_CHECK(nlohmann::json::parse(decoded.message_json(), nullptr, false) == nlohmann::json::parse(request.message_json()));
+        }
+        {
+            grpc::ClientContext context;
+            interface::toBitsResponse response;
+            request.set_message_json("[1, 2");
+            OPENCMD_CHECK(stub.toBits(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_INVALID_REQUEST);
+        }
+        {
+            grpc::ClientContext context;
+            interface::toBitsResponse response;
+            request.set_message_json("{\"header\":165,\"value\":4660}");
+            request.set_message_type("server_test_missing");
+            OPENCMD_CHECK(stub.toBits(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+        }
+    }
+
+    void testClassify(interface::service::Stub& stub) {
+        interface::classifyRequest request;
+        request.set_message(message(7));
+        {
+            grpc::ClientContext context;
+            interface::classifyResponse response;
+            OPENCMD_CHECK(stub.classify(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_OK);
+            OPENCMD_CHECK(response.message_type() == SCHEMA_NAME);
+        }
+        {
+            grpc::ClientContext context;
+            interface::classifyResponse response;
+            request.set_message(std::string(3, '\0'));
+            OPENCMD_CHECK(stub.classify(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_UNKNOWN_SCHEMA);
+        }
+        {
+            grpc::ClientContext context;
+            interface::classifyResponse response;
+            request.set_message(message(7));
+            request.set_bit_length(8);
+            OPENCMD_CHECK(stub.classify(&context, request, &response).ok());
+            OPENCMD_CHECK(response.response_status() == RequestHandler::STATUS_INVALID_REQUEST);
+        }
+    }
+
+    void testServer(const std::string& address) {
+        ServerOptions options;
+        options.address = address;
+        options.workers = 2;
+        ServiceServer server(options);
+        OPENCMD_CHECK(server.start() == 0);
+
+        auto stub = connect(address.rfind("unix:", 0) == 0 ? address : "127.0.0.1:" + std::to_string(server.getPort()));
+        testResolveSchema(*stub);
+        testToJson(*stub);
+        testToBits(*stub);
+        testToFields(*stub);
+        testClassify(*stub);
+        server.shutdown();
+    }
+
+    // Every client decodes its own values, the answers must not get mixed up
+    void testConcurrentClients() {
+        ServerOptions options;
+        options.address = "127.0.0.1:0";
+        options.workers = 4;
+        ServiceServer server(options);
+        OPENCMD_CHECK(server.start() == 0);
+        const std::string address = "127.0.0.1:" + std::to_string(server.getPort());
+
+        const int clients = 16;
+        const int calls = 200;
+        std::atomic<int> errors{0};
+        std::vector<std::thread> threads;
+        for (int client = 0; client < clients; client++) {
+            threads.emplace_back([&, client] {
+                auto stub = connect(address);
+                for (int call = 0; call < calls; call++) {
+                    uint16_t value = static_cast<uint16_t>(client * calls + call);
+                    grpc::ClientContext context;
+                    interface::toJsonRequest request;
+                    interface::toJsonResponse response;
+                    request.set_message_type(SCHEMA_NAME);
+                    request.set_message(message(value));
+                    if (!stub->toJson(&context, request, &response).ok() || response.response_status() != RequestHandler::STATUS_OK) {
+                        errors++;
+                        continue;
+                    }
+                    auto json = nlohmann::json::parse(response.message_json(), nullptr, false);
+                    if (json.is_discarded() || json.value("value", -1) != value) {
+                        errors++;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        OPENCMD_CHECK(errors.load() == 0);
+        server.shutdown();
+    }
+
+}
+
+int main() {
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    OPENCMD_CHECK(loadSchema());
+    if (opencmd::test::failures) {
+        return opencmd::test::failures;
+    }
+    testServer("127.0.0.1:0");
+    const std::string socketPath = "/tmp/opencmd_server_test_" + std::to_string(::getpid()) + ".sock";
+    testServer("unix:" + socketPath);
+    ::unlink(socketPath.c_str());
+    testConcurrentClients();
+    return opencmd::test::failures;
+}
@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "service.grpc.pb.h"
+#include "opencmd.hpp"
+#include "generator/MessageGenerator.hpp"
+#include "metrics/Histogram.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Load generator for the service RPCs.
+//
+// Closed loop: every worker sends its next request as soon as the previous
+// one is answered (the rate is what the server sustains). Open loop: the
+// requests are scheduled at --rate per second whatever the response times,
+// and the latency of a request is measured from its scheduled time, so that
+// a stalled server is charged for the requests it kept waiting (coordinated
+// omission); the service time from the actual send is reported as well.
+//
+// The messages come from a corpus file (one base64 frame per line, or the
+// JSON lines of opencmd_generate, needed by toBits) or are generated from
+// the schema of a local catalog.
+//
+// Usage: client <address> <schema> (--corpus file | --catalog directory [--messages n] [--seed n])
+//            [--rpc toJson|toFields|toBits|classify] [--mode closed|open] [--rate n]
+//            [--concurrency n] [--connections n] [--duration s] [--warmup s]
+//            [--requests n] [--timeout ms]
+
+namespace {
+
+    struct Options {
+        std::string address;
+        std::string schema;
+        std::string corpusPath;
+        std::string catalogDirectory;
+        size_t messages = 1000;
+        uint64_t seed = 1;
+        std::string rpc = "toJson";
+        bool openLoop = false;
+        double rate = 0;
+        size_t concurrency = 8;
+        size_t connections = 1;
+        double duration = 10;
+        double warmup = 1;
+        size_t requests = 0;
+        unsigned timeoutMs = 1000;
+    };
+
+    struct Message {
+        std::string bytes;
+        uint32_t bitLength = 0;
+        // Unflattened message, empty when unknown
+        std::string json;
+    };
+
+    // One request per message of the corpus, built once
+    struct Requests {
+        std::vector<interface::toJsonRequest> toJson;
+        std::vector<interface::toBitsRequest> toBits;
+        std::vector<interface::classifyRequest> classify;
+    };
+
+    // Scheduling of a run, shared by the workers
+    struct Phase {
+        Clock::time_point start;
+        Clock::time_point end;
+        // Between two scheduled requests (open loop only)
+        Clock::duration interval{0};
+        size_t maxRequests = 0;
+        std::atomic<size_t> next{0};
+    };
+
+    struct WorkerResult {
+        // From the scheduled time (open loop) or the send (closed loop)
+        std::vector<uint64_t> latencies;
+        // From the send
+        std::vector<uint64_t> serviceTimes;
+        size_t rpcErrors = 0;
+        size_t statusErrors = 0;
+        // Scheduled (open loop) but never sent, in <latencies> as timeouts
+        size_t abandoned = 0;
+    };
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+                     "Usage: %s <address> <schema> (--corpus file | --catalog directory [--messages n] [--seed n])\n"
+                     "       [--rpc toJson|toFields|toBits|classify] [--mode closed|open] [--rate n] [--concurrency n] [--connections n]\n"
+                     "       [--duration s] [--warmup s] [--requests n] [--timeout ms]\n",
+                     program);
+    }
+
+    int loadCorpus(const std::string& path, std::vector<Message>& messages) {
+        std::ifstream input(path);
+        if (!input) {
+            std::fprintf(stderr, "Impossible to open <%s>\n", path.c_str());
+            return 1;
+        }
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(input, line)) {
+            lineNumber++;
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                Message message;
+                std::string base64 = line;
+                if (line[0] == '{') {
+                    auto entry = nlohmann::json::parse(line);
+                    base64 = entry.at("message_base64").get<std::string>();
+                    message.bitLength = entry.value("bit_length", 0u);
+                    if (entry.contains("message_json")) {
+                        const auto& json = entry["message_json"];
+                        message.json = json.is_string() ? json.get<std::string>() : json.dump();
+                    }
+                }
+                BitStream bitStream(base64);
+                message.bytes.assign(reinterpret_cast<const char*>(bitStream.getBuffer()), bitStream.getByteLength());
+                messages.push_back(std::move(message));
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "Invalid message at line %zu of <%s>: %s\n", lineNumber, path.c_str(), e.what());
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    int generateCorpus(const Options& options, std::vector<Message>& messages) {
+        Logger::getInstance().setSeverity(Logger::Level::ERROR);
+        if (SchemaCatalog::getInstance().loadCatalog(options.catalogDirectory)) {
+            std::fprintf(stderr, "Error in loading the catalog <%s>\n", options.catalogDirectory.c_str());
+            return 1;
+        }
+        auto schema = SchemaCatalog::getInstance().getSchema(options.schema);
+        if (!schema) {
+            std::fprintf(stderr, "Unknown schema <%s> in <%s>\n", options.schema.c_str(), options.catalogDirectory.c_str());
+            return 1;
+        }
+        GeneratorOptions generatorOptions;
+        generatorOptions.seed = options.seed;
+        if (options.rpc == "toBits") {
+            // An empty array has no key in the decoded message, which the
+            // encoder rejects
+            generatorOptions.minRepetitions = 1;
+        }
+        MessageGenerator generator(generatorOptions);
+        if (generator.load(*schema)) {
+            std::fprintf(stderr, "Schema <%s> not supported by the generator\n", options.schema.c_str());
+            return 1;
+        }
+        nlohmann::ordered_json fields;
+        for (size_t i = 0; i < options.messages; i++) {
+            BitStream bitStream;
+            fields.clear();
+            generator.generate(bitStream, &fields);
+            Message message;
+            message.bytes.assign(reinterpret_cast<const char*>(bitStream.getBuffer()), bitStream.getByteLength());
+            message.bitLength = static_cast<uint32_t>(bitStream.getCapacity());
+            message.json = fields.unflatten().dump();
+            messages.push_back(std::move(message));
+        }
+        return 0;
+    }
+
+    Requests buildRequests(const std::vector<Message>& messages, uint32_t schemaId) {
+        Requests requests;
+        for (const auto& message : messages) {
+            interface::toJsonRequest toJson;
+            toJson.set_schema_id(schemaId);
+            toJson.set_message(message.bytes);
+            toJson.set_bit_length(message.bitLength);
+            requests.toJson.push_back(std::move(toJson));
+
+            interface::toBitsRequest toBits;
+            toBits.set_schema_id(schemaId);
+            toBits.set_message_json(message.json);
+            toBits.set_binary_output(true);
+            requests.toBits.push_back(std::move(toBits));
+
+            interface::classifyRequest classify;
+            classify.set_message(message.bytes);
+            classify.set_bit_length(message.bitLength);
+            requests.classify.push_back(std::move(classify));
+        }
+        return requests;
+    }
+
+    // Sends one request: false on an RPC error, <statusOk> false on an error
+    // status in the response
+    bool call(interface::service::Stub& stub, const Options& options, const Requests& requests, size_t index, bool& statusOk) {
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(options.timeoutMs));
+        grpc::Status status;
+        if (options.rpc == "toBits") {
+            interface::toBitsResponse response;
+            status = stub.toBits(&context, requests.toBits[index], &response);
+            statusOk = response.response_status() == 0;
+        } else if (options.rpc == "toFields") {
+            interface::toFieldsResponse response;
+            status = stub.toFields(&context, requests.toJson[index], &response);
+            statusOk = response.response_status() == 0;
+        } else if (options.rpc == "classify") {
+            interface::classifyResponse response;
+            status = stub.classify(&context, requests.classify[index], &response);
+            statusOk = response.response_status() == 0;
+        } else {
+            interface::toJsonResponse response;
+            status = stub.toJson(&context, requests.toJson[index], &response);
+            statusOk = response.response_status() == 0;
+        }
+        return status.ok();
+    }
+
+    void work(interface::service::Stub& stub, const Options& options, const Requests& requests, Phase& phase, WorkerResult& result) {
+        const size_t corpusSize = requests.toJson.size();
+        // Scheduled requests still waiting for a worker after the end of the
+        // run are abandoned once they could only time out: their latency is
+        // the wait so far, not sending them must not shorten the tail
+        const Clock::time_point drainEnd = phase.end + std::chrono::milliseconds(options.timeoutMs);
+        for (;;) {
+            size_t index = phase.next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= phase.maxRequests) {
+                break;
+            }
+            Clock::time_point scheduled;
+            if (options.openLoop) {
+                scheduled = phase.start + phase.interval * index;
+                if (scheduled >= phase.end) {
+                    break;
+                }
+                Clock::time_point now = Clock::now();
+                if (now >= drainEnd) {
+                    result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - scheduled).count());
+                    result.abandoned++;
+                    continue;
+                }
+                std::this_thread::sleep_until(scheduled);
+            } else {
+                scheduled = Clock::now();
+                if (scheduled >= phase.end) {
+                    break;
+                }
+            }
+
+            Clock::time_point sent = Clock::now();
+            bool statusOk = false;
+            bool rpcOk = call(stub, options, requests, index % corpusSize, statusOk);
+            Clock::time_point done = Clock::now();
+            if (!rpcOk) {
+                result.rpcErrors++;
+            } else if (!statusOk) {
+                result.statusErrors++;
+            }
+            result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(done - scheduled).count());
+            result.serviceTimes.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+        }
+    }
+
+    // Runs the workers for <seconds>, merging their results into <total>
+    double run(std::vector<std::unique_ptr<interface::service::Stub>>& stubs, const Options& options, const Requests& requests, double seconds,
+               size_t maxRequests, WorkerResult& total) {
+        Phase phase;
+        phase.start = Clock::now();
+        phase.end = phase.start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        phase.maxRequests = maxRequests;
+        if (options.openLoop) {
+            phase.interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+        }
+
+        std::vector<WorkerResult> results(options.concurrency);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < options.concurrency; i++) {
+            // The workers are spread over the connections
+            workers.emplace_back(work, std::ref(*stubs[i % stubs.size()]), std::cref(options), std::cref(requests), std::ref(phase), std::ref(results[i]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - phase.start).count();
+
+        for (auto& result : results) {
+            total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+            total.serviceTimes.insert(total.serviceTimes.end(), result.serviceTimes.begin(), result.serviceTimes.end());
+            total.rpcErrors += result.rpcErrors;
+            total.statusErrors += result.statusErrors;
+            total.abandoned += result.abandoned;
+        }
+        return elapsed;
+    }
+
+    uint64_t percentile(const std::vector<uint64_t>& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t rank = static_cast<size_t>(fraction * sorted.size());
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    void printLatencies(const char* name, std::vector<uint64_t>& values) {
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (uint64_t value : values) {
+            sum += value;
+        }
+        double mean = values.empty() ? 0 : sum / values.size();
+        std::printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, percentile(values, 0.50) / 1e3, percentile(values, 0.90) / 1e3,
+                    percentile(values, 0.99) / 1e3, percentile(values, 0.999) / 1e3, percentile(values, 0.9999) / 1e3,
+                    values.empty() ? 0.0 : values.back() / 1e3, mean / 1e3);
+    }
+
+    // Lower bound of a bucket of the metrics histogram, in nanoseconds
+    uint64_t bucketLowerBound(size_t bucket) {
+        if (bucket == 0) {
+            return 0;
+        }
+        size_t index = bucket - 1;
+        int exponent = Histogram::MIN_EXPONENT + static_cast<int>(index >> Histogram::SUB_BUCKET_BITS);
+        uint64_t subBucket = index & ((size_t(1) << Histogram::SUB_BUCKET_BITS) - 1);
+        return (uint64_t(1) << exponent) + (subBucket << (exponent - Histogram::SUB_BUCKET_BITS));
+    }
+
+    void printHistogram(const std::vector<uint64_t>& values) {
+        auto histogram = std::make_unique<Histogram>();
+        for (uint64_t value : values) {
+            histogram->record(value);
+        }
+        HistogramSnapshot snapshot;
+        snapshot.add(*histogram);
+        uint64_t cumulative = 0;
+        std::printf("\n%14s %12s %10s\n", "latency >= us", "requests", "cumul. %");
+        for (size_t i = 0; i < Histogram::BUCKETS; i++) {
+            if (snapshot.buckets[i] == 0) {
+                continue;
+            }
+            cumulative += snapshot.buckets[i];
+            std::printf("%14.1f %12lu %10.3f\n", bucketLowerBound(i) / 1e3, static_cast<unsigned long>(snapshot.buckets[i]), 100.0 * cumulative / snapshot.count);
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    Options options;
+    options.address = argv[1];
+    options.schema = argv[2];
+    for (int i = 3; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--corpus" && hasValue) {
+            options.corpusPath = argv[++i];
+        } else if (argument == "--catalog" && hasValue) {
+            options.catalogDirectory = argv[++i];
+        } else if (argument == "--messages" && hasValue) {
+            options.messages = std::stoull(argv[++i]);
+        } else if (argument == "--seed" && hasValue) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (argument == "--rpc" && hasValue) {
+            options.rpc = argv[++i];
+        } else if (argument == "--mode" && hasValue) {
+            options.openLoop = std::string(argv[++i]) == "open";
+        } else if (argument == "--rate" && hasValue) {
+            options.rate = std::stod(argv[++i]);
+        } else if (argument == "--concurrency" && hasValue) {
+            options.concurrency = std::stoull(argv[++i]);
+        } else if (argument == "--connections" && hasValue) {
+            options.connections = std::stoull(argv[++i]);
+        } else if (argument == "--duration" && hasValue) {
+            options.duration = std::stod(argv[++i]);
+        } else if (argument == "--warmup" && hasValue) {
+            options.warmup = std::stod(argv[++i]);
+        } else if (argument == "--requests" && hasValue) {
+            options.requests = std::stoull(argv[++i]);
+        } else if (argument == "--timeout" && hasValue) {
+            options.timeoutMs = std::stoul(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.corpusPath.empty() == options.catalogDirectory.empty()) {
+        std::fprintf(stderr, "Either --corpus or --catalog is needed\n");
+        return 1;
+    }
+    if (options.rpc != "toJson" && options.rpc != "toFields" && options.rpc != "toBits" && options.rpc != "classify") {
+        std::fprintf(stderr, "Unknown RPC <%s>\n", options.rpc.c_str());
+        return 1;
+    }
+    if (options.openLoop && options.rate <= 0) {
+        std::fprintf(stderr, "The open loop mode needs a --rate\n");
+        return 1;
+    }
+    if (options.concurrency == 0 || options.connections == 0) {
+        std::fprintf(stderr, "At least one worker and one connection are needed\n");
+        return 1;
+    }
+
+    std::vector<Message> messages;
+    if (options.corpusPath.empty() ? generateCorpus(options, messages) : loadCorpus(options.corpusPath, messages)) {
+        return 1;
+    }
+    if (messages.empty()) {
+        std::fprintf(stderr, "No message to send\n");
+        return 1;
+    }
+    if (options.rpc == "toBits" && messages.front().json.empty()) {
+        std::fprintf(stderr, "toBits needs the JSON of the messages: a JSON lines corpus or --catalog\n");
+        return 1;
+    }
+
+    // Channels with their own subchannel pool do not share a connection
+    std::vector<std::unique_ptr<interface::service::Stub>> stubs;
+    for (size_t i = 0; i < options.connections; i++) {
+        grpc::ChannelArguments arguments;
+        arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        auto channel = grpc::CreateCustomChannel(options.address, grpc::InsecureChannelCredentials(), arguments);
+        if (!channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(5))) {
+            std::fprintf(stderr, "Impossible to connect to <%s>\n", options.address.c_str());
+            return 1;
+        }
+        stubs.push_back(interface::service::NewStub(channel));
+    }
+
+    interface::resolveSchemaRequest resolveRequest;
+    interface::resolveSchemaResponse resolveResponse;
+    resolveRequest.set_message_type(options.schema);
+    grpc::ClientContext resolveContext;
+    if (!stubs.front()->resolveSchema(&resolveContext, resolveRequest, &resolveResponse).ok() || resolveResponse.response_status() != 0) {
+        std::fprintf(stderr, "Schema <%s> not resolved by the server: %s\n", options.schema.c_str(), resolveResponse.response_message().c_str());
+        return 1;
+    }
+    Requests requests = buildRequests(messages, resolveResponse.schema_id());
+
+    if (options.warmup > 0) {
+        WorkerResult discarded;
+        run(stubs, options, requests, options.warmup, SIZE_MAX, discarded);
+    }
+    WorkerResult total;
+    size_t maxRequests = options.requests ? options.requests : SIZE_MAX;
+    double elapsed = run(stubs, options, requests, options.duration, maxRequests, total);
+
+    size_t completed = total.latencies.size() - total.abandoned;
+    std::printf("%s loop, %s, %zu workers on %zu connections, %zu distinct messages", options.openLoop ? "open" : "closed", options.rpc.c_str(),
+                options.concurrency, options.connections, messages.size());
+    if (options.openLoop) {
+        std::printf(", target %.0f msg/s", options.rate);
+    }
+    std::printf("\n%zu requests in %.3f s: %.0f msg/s, %zu RPC errors, %zu error statuses\n", completed, elapsed, completed / elapsed, total.rpcErrors,
+                total.statusErrors);
+    if (options.openLoop) {
+        // Scheduled in the run but never sent: the workers could not keep up
+        if (total.abandoned) {
+            std::printf("%zu scheduled requests not sent, counted as timeouts: the target rate needs more workers, or the server is saturated\n",
+                        total.abandoned);
+        }
+    }
+    std::printf("\n%-12s %10s %10s %10s %10s %10s %10s %10s\n", "latency us", "p50", "p90", "p99", "p99.9", "p99.99", "max", "mean");
+    if (options.openLoop) {
+        printLatencies("corrected", total.latencies);
+    }
+    printLatencies("service", total.serviceTimes);
+    printHistogram(total.latencies);
+    return total.rpcErrors ? 2 : 0;
+}
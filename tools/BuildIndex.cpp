@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "opencmd.hpp"
+#include "capture/FrameIndex.hpp"
+#include "capture/MappedFile.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Builds, or brings up to date, the frame index of a capture file: the
+// offset and length of every frame and, with a catalog, the schema each
+// frame is classified as. An index written before the capture was
+// appended to is extended with the new frames only. opencmd_decode --index
+// then decodes ranges of frames (or of offsets, or of time) and splits them
+// across threads on exact frame boundaries.
+//
+// An index classified with a catalog is kept so: it is updated with a
+// catalog only, and rebuilt with classification when a catalog is given for
+// an index without it.
+//
+// With --frame the entry of a frame is printed, and the frame as base64. A
+// stored index is then only read.
+//
+// Usage: opencmd_index <input file> [--format raw|length-prefixed|base64|candump]
+//            [--frame-size bytes] [--index file] [--catalog directory]
+//            [--frame n]
+
+static void usage(const char* program) {
+    std::fprintf(stderr,
+                 "Usage: %s <input file> [--format raw|length-prefixed|base64|candump] [--frame-size bytes] [--index file]\n"
+                 "       [--catalog directory] [--frame n]\n",
+                 program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string inputPath = argv[1];
+    CaptureFormat format;
+    std::string indexPath = inputPath + ".idx";
+    std::string catalogDirectory;
+    bool printFrame = false;
+    size_t frameNumber = 0;
+    for (int i = 2; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--format" && hasValue) {
+            auto type = CaptureFormat::parse(argv[++i]);
+            if (!type) {
+                std::fprintf(stderr, "Unknown format <%s>\n", argv[i]);
+                return 1;
+            }
+            format.type = type.value();
+        } else if (argument == "--frame-size" && hasValue) {
+            format.frameSize = std::stoull(argv[++i]);
+        } else if (argument == "--index" && hasValue) {
+            indexPath = argv[++i];
+        } else if (argument == "--catalog" && hasValue) {
+            catalogDirectory = argv[++i];
+        } else if (argument == "--frame" && hasValue) {
+            printFrame = true;
+            frameNumber = std::stoull(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (format.type == CaptureFormat::Type::RAW && format.frameSize == 0) {
+        std::fprintf(stderr, "The raw format needs a --frame-size\n");
+        return 1;
+    }
+    if (format.type == CaptureFormat::Type::SYNC) {
+        std::fprintf(stderr, "The frames of the sync format are not byte aligned, they are not indexed\n");
+        return 1;
+    }
+
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    const bool classify = !catalogDirectory.empty();
+    if (classify && SchemaCatalog::getInstance().loadCatalog(catalogDirectory)) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", catalogDirectory.c_str());
+        return 1;
+    }
+    MappedFile file;
+    if (file.open(inputPath)) {
+        return 1;
+    }
+
+    auto start = Clock::now();
+    FrameIndex index;
+    const bool stored = index.read(indexPath, format) == FrameIndex::STATUS_OK;
+    if (!stored || (classify && !index.isClassified())) {
+        index = FrameIndex(format, classify);
+    }
+    const uint64_t knownBytes = index.getIndexedBytes();
+    size_t invalid = index.update(file.getData(), file.getSize());
+    const bool changed = index.getIndexedBytes() != knownBytes || index.getScanStart() != knownBytes;
+    // With --frame the stored index is only read, the frame is looked up in
+    // the one updated in memory
+    if (changed && !(stored && printFrame)) {
+        if (index.isClassified() && !classify) {
+            // The new frames could not be classified: the index would no
+            // longer tell the schema of every frame
+            std::fprintf(stderr, "The index <%s> classifies its frames, it is updated with the --catalog only\n", indexPath.c_str());
+            return 1;
+        }
+        if (index.write(indexPath)) {
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t scanned = index.getIndexedBytes() - index.getScanStart();
+    std::fprintf(stderr, "%zu frames (%zu new, %zu malformed) in %llu of %zu bytes, %llu bytes scanned in %.3f s: %.1f MB/s\n", index.size(),
+                 index.size() - index.findOffset(index.getScanStart()), invalid, static_cast<unsigned long long>(index.getIndexedBytes()),
+                 file.getSize(), static_cast<unsigned long long>(scanned), seconds, scanned / seconds / 1e6);
+
+    if (index.isClassified()) {
+        std::map<std::string, size_t> counts;
+        for (size_t frame = 0; frame < index.size(); frame++) {
+            std::string_view name = index.getSchemaName(index[frame]);
+            counts[name.empty() ? "(unclassified)" : std::string(name)]++;
+        }
+        for (const auto& [name, count] : counts) {
+            std::fprintf(stderr, "  %s: %zu\n", name.c_str(), count);
+        }
+    }
+
+    if (printFrame) {
+        if (frameNumber >= index.size()) {
+            std::fprintf(stderr, "No frame %zu, the capture has %zu\n", frameNumber, index.size());
+            return 1;
+        }
+        const FrameIndex::Entry& entry = index[frameNumber];
+        FrameReader reader(file.getData(), entry.offset, index.frameEnd(frameNumber), format);
+        CaptureFrame frame;
+        if (reader.next(frame) != FrameReader::STATUS_OK) {
+            std::fprintf(stderr, "Frame %zu at offset %llu is malformed\n", frameNumber, static_cast<unsigned long long>(entry.offset));
+            return 2;
+        }
+        BitStream bitStream = BitStream::view(frame.data, frame.bitLength);
+        std::string schema(index.getSchemaName(entry));
+        std::printf("frame %zu offset %llu bits %u%s%s%s%s\n%s\n", frameNumber, static_cast<unsigned long long>(entry.offset), entry.bitLength,
+                    schema.empty() ? "" : " schema ", schema.c_str(), frame.timestamp.empty() ? "" : " timestamp ",
+                    std::string(frame.timestamp).c_str(), bitStream.to_base64().c_str());
+    }
+    return 0;
+}
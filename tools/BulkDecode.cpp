@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "opencmd.hpp"
+#include "capture/FrameIndex.hpp"
+#include "capture/FrameReader.hpp"
+#include "capture/MappedFile.hpp"
+#include "executor/OrderedPipeline.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Decodes every frame of a capture file against a schema of the catalog.
+// The file is mapped and split in chunks starting on frame boundaries; the
+// chunks are decoded in parallel and written in file order, with a bounded
+// number of chunks in flight.
+//
+// Output: one decoded message per line (ndjson; with --envelope each line
+// also carries the offset of the frame in the file and, for candump logs,
+// the timestamp, interface and identifier), or csv with one column per
+// field path of the schema (the items of an array in one cell, separated
+// by spaces). Frames that cannot be decoded are counted and skipped.
+//
+// The sync format is a bit stream without byte alignment (e.g. a link
+// layer capture): the frames are located by the --sync word at any bit
+// position, and are --frame-bits long or run up to the next sync word; the
+// offsets are then in bits.
+//
+// With --index the chunks are split on the frames of the index of the file
+// (see opencmd_index; built, or brought up to date, when needed), and the
+// decoding can be restricted to a range of frames, of offsets or, for
+// candump logs, of time (seconds since the epoch); the end of a range is
+// excluded, and may be omitted.
+//
+// Usage: opencmd_decode <catalog directory> <schema> <input file>
+//            [--format raw|length-prefixed|base64|candump|sync] [--frame-size bytes]
+//            [--sync hex[/bits]] [--frame-bits n] [--keep-sync]
+//            [--output file] [--output-format ndjson|csv] [--envelope]
+//            [--can-id hex] [--threads n] [--chunk-size bytes]
+//            [--index file] [--frames first:last] [--offsets begin:end]
+//            [--time from:to]
+
+namespace {
+
+    struct Options {
+        CaptureFormat format;
+        std::string outputPath;
+        bool csv = false;
+        bool envelope = false;
+        bool filterCanId = false;
+        uint32_t canId = 0;
+        size_t threads = 0;
+        size_t chunkSize = 256 << 10;
+        // Ranges: need an index
+        bool useIndex = false;
+        std::string indexPath;
+        std::string frames;
+        std::string offsets;
+        std::string time;
+    };
+
+    struct ChunkResult {
+        std::string output;
+        size_t frames = 0;
+        size_t skipped = 0;
+        size_t errors = 0;
+        // The first errors of the chunk
+        std::vector<std::string> errorMessages;
+    };
+
+    /* decoded.unflatten().dump(), written from the flattened keys without
+     * building the nested document (about half of the cost of a frame).
+     *
+     * The decoder returns the keys in tree order, the items of an array
+     * contiguous and numbered from 0: a key then only closes containers or
+     * opens new ones. Anything else (a container revisited, a gap in an
+     * array, an escaped key) is left to unflatten.
+     */
+    class UnflattenedWriter {
+        struct Level {
+            std::string_view name;
+            bool array = false;
+            size_t count = 0;
+            // Object only: the containers already closed in it
+            std::vector<std::string_view> closed;
+        };
+        std::vector<Level> levels;
+        std::vector<std::string_view> tokens;
+
+        static void appendName(std::string& out, std::string_view name) {
+            for (char c : name) {
+                if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+                    out += nlohmann::json(std::string(name)).dump();
+                    return;
+                }
+            }
+            out += '"';
+            out += name;
+            out += '"';
+        }
+
+        static void appendValue(std::string& out, const nlohmann::ordered_json& value) {
+            char digits[24];
+            char* last;
+            if (value.is_number_unsigned()) {
+                last = std::to_chars(digits, digits + sizeof(digits), value.get<uint64_t>()).ptr;
+            } else if (value.is_number_integer()) {
+                last = std::to_chars(digits, digits + sizeof(digits), value.get<int64_t>()).ptr;
+            } else {
+                out += value.dump();
+                return;
+            }
+            out.append(digits, last);
+        }
+
+        void closeLevel(std::string& out) {
+            Level& level = levels.back();
+            out += level.array ? ']' : '}';
+            std::string_view name = level.name;
+            levels.pop_back();
+            if (!levels.back().array) {
+                levels.back().closed.push_back(name);
+            }
+        }
+
+        bool write(std::string& out, const nlohmann::ordered_json& flat) {
+            levels.resize(1);
+            levels[0] = Level();
+            for (const auto& [key, value] : flat.items()) {
+                std::string_view path = key;
+                if (path.empty() || path.front() != '/' || path.find('~') != std::string_view::npos || value.is_structured()) {
+                    return false;
+                }
+                tokens.clear();
+                for (size_t start = 1;;) {
+                    size_t slash = path.find('/', start);
+                    tokens.push_back(path.substr(start, slash == std::string_view::npos ? std::string_view::npos : slash - start));
+                    if (slash == std::string_view::npos) {
+                        break;
+                    }
+                    start = slash + 1;
+                }
+                // Containers still open for this key
+                size_t depth = 0;
+                while (depth + 1 < levels.size() && depth + 1 < tokens.size() && levels[depth + 1].name == tokens[depth]) {
+                    depth++;
+                }
+                while (levels.size() > depth + 1) {
+                    closeLevel(out);
+                }
+                for (size_t i = depth; i < tokens.size(); i++) {
+                    Level& parent = levels.back();
+                    std::string_view token = tokens[i];
+                    if (parent.count == 0) {
+                        parent.array = token == "0";
+                        out += parent.array ? '[' : '{';
+                    } else {
+                        out += ',';
+                    }
+                    if (parent.array) {
+                        if (token != std::to_string(parent.count)) {
+                            return false;
+                        }
+                    } else {
+                        if (std::find(parent.closed.begin(), parent.closed.end(), token) != parent.closed.end()) {
+                            return false;
+                        }
+                        appendName(out, token);
+                        out += ':';
+                    }
+                    parent.count++;
+                    if (i + 1 == tokens.size()) {
+                        appendValue(out, value);
+                    } else {
+                        levels.emplace_back();
+                        levels.back().name = token;
+                    }
+                }
+            }
+            if (levels[0].count == 0) {
+                return false;
+            }
+            while (levels.size() > 1) {
+                closeLevel(out);
+            }
+            out += levels[0].array ? ']' : '}';
+            return true;
+        }
+
+    public:
+        void append(std::string& out, const nlohmann::ordered_json& flat) {
+            size_t start = out.size();
+            if (!write(out, flat)) {
+                out.resize(start);
+                out += flat.unflatten().dump();
+            }
+        }
+    };
+
+    // Per worker
+    struct WorkerState {
+        UnflattenedWriter writer;
+        std::vector<std::string> cells;
+        std::string pathBuffer;
+        std::vector<uint32_t> pathIndices;
+    };
+
+    constexpr size_t ERRORS_REPORTED = 5;
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+                     "Usage: %s <catalog directory> <schema> <input file> [--format raw|length-prefixed|base64|candump|sync] [--frame-size bytes]\n"
+                     "       [--sync hex[/bits]] [--frame-bits n] [--keep-sync]\n"
+                     "       [--output file] [--output-format ndjson|csv] [--envelope] [--can-id hex] [--threads n] [--chunk-size bytes]\n"
+                     "       [--index file] [--frames first:last] [--offsets begin:end] [--time from:to]\n",
+                     program);
+    }
+
+    void appendCsvValue(std::string& cell, const nlohmann::ordered_json& value) {
+        if (value.is_number()) {
+            cell += value.dump();
+            return;
+        }
+        // Quoted, with the quotes doubled
+        std::string text = value.is_string() ? value.get<std::string>() : value.dump();
+        cell += '"';
+        for (char c : text) {
+            if (c == '"') {
+                cell += '"';
+            }
+            cell += c;
+        }
+        cell += '"';
+    }
+
+    void appendCandumpFields(std::string& line, const CaptureFrame& frame, bool json) {
+        if (json) {
+            if (!frame.timestamp.empty()) {
+                line += ",\"timestamp\":";
+                line += frame.timestamp;
+            }
+            line += ",\"interface\":";
+            line += nlohmann::json(std::string(frame.interface)).dump();
+            line += ",\"can_id\":";
+            line += std::to_string(frame.canId);
+        } else {
+            line += ',';
+            line += frame.timestamp;
+            line += ',';
+            line += frame.interface;
+            line += ',';
+            line += std::to_string(frame.canId);
+        }
+    }
+
+    // "<first>:<last>", either side may be empty
+    bool splitRange(const std::string& range, std::string_view& first, std::string_view& last) {
+        size_t colon = range.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        first = std::string_view(range).substr(0, colon);
+        last = std::string_view(range).substr(colon + 1);
+        return true;
+    }
+
+    // Frames [first, last) of the index selected by the range options
+    bool selectFrames(const FrameIndex& index, const Options& options, size_t& first, size_t& last) {
+        first = 0;
+        last = index.size();
+        std::string_view begin, end;
+        if (!options.frames.empty()) {
+            if (!splitRange(options.frames, begin, end)) {
+                return false;
+            }
+            first = std::max<size_t>(first, begin.empty() ? 0 : std::stoull(std::string(begin)));
+            last = std::min<size_t>(last, end.empty() ? index.size() : std::stoull(std::string(end)));
+        }
+        if (!options.offsets.empty()) {
+            if (!splitRange(options.offsets, begin, end)) {
+                return false;
+            }
+            first = std::max(first, begin.empty() ? 0 : index.findOffset(std::stoull(std::string(begin))));
+            last = std::min(last, end.empty() ? index.size() : index.findOffset(std::stoull(std::string(end))));
+        }
+        if (!options.time.empty()) {
+            if (!splitRange(options.time, begin, end) || options.format.type != CaptureFormat::Type::CANDUMP) {
+                return false;
+            }
+            first = std::max(first, begin.empty() ? 0 : index.findTime(FrameIndex::parseTimestamp(begin)));
+            last = std::min(last, end.empty() ? index.size() : index.findTime(FrameIndex::parseTimestamp(end)));
+        }
+        return true;
+    }
+
+    void decodeChunk(TaskPool::Context& context, const MappedFile& file, const std::vector<size_t>& boundaries, size_t chunk, SchemaId schemaId,
+                     const Options& options, WorkerLocal<WorkerState>& states, ChunkResult& result) {
+        const bool candump = options.format.type == CaptureFormat::Type::CANDUMP;
+        FrameReader reader(file.getData(), boundaries[chunk], boundaries[chunk + 1], options.format, file.getSize());
+        const PathTable* pathTable = options.csv ? context.decoder.acquirePathTable(schemaId) : nullptr;
+        WorkerState& state = states.get(context);
+        CaptureFrame frame;
+        nlohmann::ordered_json decoded;
+        int retVal;
+        while ((retVal = reader.next(frame)) != FrameReader::END_OF_RANGE) {
+            if (retVal == FrameReader::STATUS_OK && candump && options.filterCanId && frame.canId != options.canId) {
+                result.skipped++;
+                continue;
+            }
+            if (retVal == FrameReader::STATUS_OK) {
+                decoded.clear();
+                try {
+                    BitStream bitStream = BitStream::view(frame.data, frame.bitLength);
+                    retVal = context.decoder.bitstream_to_json(schemaId, bitStream, decoded);
+                } catch (const std::exception&) {
+                    // Frame shorter than the schema
+                    retVal = FrameReader::ERROR_INVALID_FRAME;
+                }
+            }
+            if (retVal != FrameReader::STATUS_OK) {
+                if (result.errors++ < ERRORS_REPORTED) {
+                    result.errorMessages.push_back("Frame at offset " + std::to_string(frame.offset) + " not decoded (code " + std::to_string(retVal) + ")");
+                }
+                continue;
+            }
+            result.frames++;
+
+            if (!options.csv) {
+                if (options.envelope) {
+                    result.output += "{\"offset\":";
+                    result.output += std::to_string(frame.offset);
+                    if (candump) {
+                        appendCandumpFields(result.output, frame, true);
+                    }
+                    result.output += ",\"message\":";
+                    state.writer.append(result.output, decoded);
+                    result.output += "}\n";
+                } else {
+                    state.writer.append(result.output, decoded);
+                    result.output += '\n';
+                }
+                continue;
+            }
+
+            if (!pathTable) {
+                continue;
+            }
+            state.cells.assign(pathTable->getPaths().size(), std::string());
+            for (const auto& [key, value] : decoded.items()) {
+                uint32_t pathId = pathTable->lookup(key, state.pathBuffer, state.pathIndices);
+                if (pathId == PathTable::NO_PATH) {
+                    continue;
+                }
+                std::string& cell = state.cells[pathId - 1];
+                if (!cell.empty()) {
+                    cell += ' ';
+                }
+                appendCsvValue(cell, value);
+            }
+            result.output += std::to_string(frame.offset);
+            if (candump) {
+                appendCandumpFields(result.output, frame, false);
+            }
+            for (const auto& cell : state.cells) {
+                result.output += ',';
+                result.output += cell;
+            }
+            result.output += '\n';
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string catalogDirectory = argv[1];
+    const std::string schemaName = argv[2];
+    const std::string inputPath = argv[3];
+    Options options;
+    for (int i = 4; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--format" && hasValue) {
+            auto type = CaptureFormat::parse(argv[++i]);
+            if (!type) {
+                std::fprintf(stderr, "Unknown format <%s>\n", argv[i]);
+                return 1;
+            }
+            options.format.type = type.value();
+        } else if (argument == "--frame-size" && hasValue) {
+            options.format.frameSize = std::stoull(argv[++i]);
+        } else if (argument == "--sync" && hasValue) {
+            if (!options.format.parseSyncWord(argv[++i])) {
+                std::fprintf(stderr, "Invalid sync word <%s>\n", argv[i]);
+                return 1;
+            }
+        } else if (argument == "--frame-bits" && hasValue) {
+            options.format.frameBits = std::stoull(argv[++i]);
+        } else if (argument == "--keep-sync") {
+            options.format.keepSync = true;
+        } else if (argument == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (argument == "--output-format" && hasValue) {
+            std::string outputFormat = argv[++i];
+            if (outputFormat != "ndjson" && outputFormat != "csv") {
+                std::fprintf(stderr, "Unknown output format <%s>\n", outputFormat.c_str());
+                return 1;
+            }
+            options.csv = outputFormat == "csv";
+        } else if (argument == "--envelope") {
+            options.envelope = true;
+        } else if (argument == "--can-id" && hasValue) {
+            options.filterCanId = true;
+            options.canId = static_cast<uint32_t>(std::stoul(argv[++i], nullptr, 16));
+        } else if (argument == "--threads" && hasValue) {
+            options.threads = std::stoull(argv[++i]);
+        } else if (argument == "--chunk-size" && hasValue) {
+            options.chunkSize = std::stoull(argv[++i]);
+        } else if (argument == "--index" && hasValue) {
+            options.useIndex = true;
+            options.indexPath = argv[++i];
+        } else if (argument == "--frames" && hasValue) {
+            options.useIndex = true;
+            options.frames = argv[++i];
+        } else if (argument == "--offsets" && hasValue) {
+            options.useIndex = true;
+            options.offsets = argv[++i];
+        } else if (argument == "--time" && hasValue) {
+            options.useIndex = true;
+            options.time = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.format.type == CaptureFormat::Type::RAW && options.format.frameSize == 0) {
+        std::fprintf(stderr, "The raw format needs a --frame-size\n");
+        return 1;
+    }
+    if (options.format.type == CaptureFormat::Type::SYNC && (options.format.syncBits == 0 || options.useIndex)) {
+        std::fprintf(stderr, "The sync format needs a --sync word, and is not indexed\n");
+        return 1;
+    }
+
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    if (SchemaCatalog::getInstance().loadCatalog(catalogDirectory)) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", catalogDirectory.c_str());
+        return 1;
+    }
+    auto schemaId = SchemaCatalog::getInstance().resolve(schemaName);
+    DecoderContext headerContext;
+    const PathTable* pathTable = schemaId ? headerContext.acquirePathTable(schemaId.value()) : nullptr;
+    if (!pathTable) {
+        std::fprintf(stderr, "Unknown schema <%s>\n", schemaName.c_str());
+        return 1;
+    }
+    MappedFile file;
+    if (file.open(inputPath)) {
+        return 1;
+    }
+    FILE* output = options.outputPath.empty() ? stdout : std::fopen(options.outputPath.c_str(), "wb");
+    if (!output) {
+        std::fprintf(stderr, "Impossible to open <%s>\n", options.outputPath.c_str());
+        return 1;
+    }
+
+    auto start = Clock::now();
+    if (options.csv) {
+        std::string header = "offset";
+        if (options.format.type == CaptureFormat::Type::CANDUMP) {
+            header += ",timestamp,interface,can_id";
+        }
+        for (const auto& path : pathTable->getPaths()) {
+            header += ',';
+            header += path;
+        }
+        header += '\n';
+        std::fwrite(header.data(), 1, header.size(), output);
+    }
+
+    TaskPoolOptions poolOptions;
+    poolOptions.threads = options.threads;
+    TaskPool pool(poolOptions);
+    WorkerLocal<WorkerState> states(pool);
+    std::vector<size_t> boundaries;
+    if (options.useIndex) {
+        std::string indexPath = options.indexPath.empty() ? inputPath + ".idx" : options.indexPath;
+        FrameIndex index;
+        if (index.read(indexPath, options.format) != FrameIndex::STATUS_OK) {
+            index = FrameIndex(options.format);
+        }
+        uint64_t knownBytes = index.getIndexedBytes();
+        index.update(file.getData(), file.getSize());
+        if (index.getIndexedBytes() != knownBytes) {
+            // Not fatal: the index is rebuilt next time
+            index.write(indexPath);
+        }
+        size_t first, last;
+        if (!selectFrames(index, options, first, last)) {
+            std::fprintf(stderr, "Invalid range (--time needs a candump log)\n");
+            return 1;
+        }
+        boundaries = index.chunkBoundaries(first, last, options.chunkSize);
+    } else {
+        boundaries = FrameReader::chunkBoundaries(file.getData(), file.getSize(), options.chunkSize, options.format);
+    }
+    // Two chunks per worker: one being decoded, one waiting to be written.
+    // The memory is about that many times the output of a chunk
+    OrderedPipeline<ChunkResult> pipeline(pool, 2 * pool.size());
+    size_t frames = 0;
+    size_t skipped = 0;
+    size_t errors = 0;
+    pipeline.run(
+        boundaries.size() - 1,
+        [&](TaskPool::Context& context, size_t chunk, ChunkResult& result) {
+            decodeChunk(context, file, boundaries, chunk, schemaId.value(), options, states, result);
+        },
+        [&](size_t chunk, ChunkResult& result) {
+            std::fwrite(result.output.data(), 1, result.output.size(), output);
+            file.release(boundaries[chunk], boundaries[chunk + 1]);
+            for (const auto& message : result.errorMessages) {
+                if (errors++ < ERRORS_REPORTED) {
+                    std::fprintf(stderr, "%s\n", message.c_str());
+                }
+            }
+            errors += result.errors - result.errorMessages.size();
+            frames += result.frames;
+            skipped += result.skipped;
+        });
+    if (output != stdout) {
+        std::fclose(output);
+    } else {
+        std::fflush(output);
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t bytes = boundaries.back() - boundaries.front();
+    std::fprintf(stderr, "%zu frames decoded, %zu skipped, %zu errors from %zu bytes in %.3f s (%zu threads): %.0f frames/s, %.1f MB/s\n", frames,
+                 skipped, errors, bytes, seconds, pool.size(), frames / seconds, bytes / seconds / 1e6);
+    return errors ? 2 : 0;
+}
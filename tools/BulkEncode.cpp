@@ -0,0 +1,499 @@
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "opencmd.hpp"
+#include "capture/FrameReader.hpp"
+#include "capture/MappedFile.hpp"
+#include "executor/OrderedPipeline.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Encodes every record of a file of field values with a schema of the
+// catalog, the reverse of opencmd_decode. The file is mapped and split in
+// chunks of whole lines, encoded in parallel and written in file order.
+//
+// Input: one message per line in the shape returned by toJson (ndjson;
+// --field takes the message from a key of each line instead, e.g.
+// "message" for the --envelope output of opencmd_decode or "message_json"
+// for the JSON lines of opencmd_generate), or csv with a header of field
+// paths as written by opencmd_decode (the columns not starting with '/'
+// are ignored, a path with one "*" holds the items of an array separated
+// by spaces). Output: raw frames back to back, length-prefixed frames (32
+// bits little endian bit length, then the bytes) or one base64 frame per
+// line. Records that cannot be encoded are counted and skipped.
+//
+// Usage: opencmd_encode <catalog directory> <schema> <input file>
+//            [--input-format ndjson|csv] [--field name]
+//            [--format raw|length-prefixed|base64] [--output file]
+//            [--threads n] [--chunk-size bytes]
+
+namespace {
+
+    struct Options {
+        bool csv = false;
+        std::string field;
+        CaptureFormat::Type format = CaptureFormat::Type::LENGTH_PREFIXED;
+        std::string outputPath;
+        size_t threads = 0;
+        size_t chunkSize = 256 << 10;
+    };
+
+    struct ChunkResult {
+        std::string output;
+        size_t records = 0;
+        size_t errors = 0;
+        // The first errors of the chunk
+        std::vector<std::string> errorMessages;
+    };
+
+    // CSV column: a field path, or the items of an array ("/data/*" gives
+    // "/data/0", "/data/1", ...)
+    struct Column {
+        std::string path;
+        bool items = false;
+        bool ignored = false;
+    };
+
+    constexpr size_t ERRORS_REPORTED = 5;
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+                     "Usage: %s <catalog directory> <schema> <input file> [--input-format ndjson|csv] [--field name]\n"
+                     "       [--format raw|length-prefixed|base64] [--output file] [--threads n] [--chunk-size bytes]\n",
+                     program);
+    }
+
+    /* JSON text to the flattened object expected by json_to_bitstream, in
+     * a single pass: the nested document is never built (same keys and
+     * values as parse(text).flatten()).
+     */
+    class FlatteningHandler : public nlohmann::json_sax<nlohmann::json> {
+        struct Level {
+            bool array;
+            size_t pathLength;
+            size_t count = 0;
+        };
+        nlohmann::json* flat = nullptr;
+        std::string path;
+        std::vector<Level> levels;
+        // "/<field>" when the message is a member of the line
+        std::string prefix;
+
+        void appendToken(std::string_view token) {
+            path += '/';
+            for (char c : token) {
+                if (c == '~') {
+                    path += "~0";
+                } else if (c == '/') {
+                    path += "~1";
+                } else {
+                    path += c;
+                }
+            }
+        }
+
+        // Position of the next value in its container
+        void beginValue() {
+            Level& level = levels.back();
+            if (level.array) {
+                path.resize(level.pathLength);
+                appendToken(std::to_string(level.count));
+            }
+            level.count++;
+        }
+
+        template <typename Value>
+        bool record(Value&& value) {
+            if (levels.empty()) {
+                // Not an object
+                return false;
+            }
+            beginValue();
+            store(std::forward<Value>(value));
+            return true;
+        }
+
+        template <typename Value>
+        void store(Value&& value) {
+            if (prefix.empty()) {
+                (*flat)[path] = std::forward<Value>(value);
+            } else if (path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0 && path[prefix.size()] == '/') {
+                (*flat)[path.substr(prefix.size())] = std::forward<Value>(value);
+            }
+        }
+
+        bool startContainer(bool array) {
+            if (levels.empty()) {
+                if (array) {
+                    return false;
+                }
+            } else {
+                beginValue();
+            }
+            levels.push_back({array, path.size()});
+            return true;
+        }
+
+        bool endContainer() {
+            Level level = levels.back();
+            levels.pop_back();
+            path.resize(level.pathLength);
+            if (level.count == 0 && !levels.empty()) {
+                // flatten() keeps the empty containers as null
+                store(nullptr);
+            }
+            return true;
+        }
+
+    public:
+        explicit FlatteningHandler(const std::string& field) {
+            if (!field.empty()) {
+                appendToken(field);
+                prefix = path;
+            }
+        }
+
+        void reset(nlohmann::json& output) {
+            flat = &output;
+            *flat = nlohmann::json::object();
+            path.clear();
+            levels.clear();
+        }
+
+        bool null() override { return record(nullptr); }
+        bool boolean(bool value) override { return record(value); }
+        bool number_integer(number_integer_t value) override { return record(value); }
+        bool number_unsigned(number_unsigned_t value) override { return record(value); }
+        bool number_float(number_float_t value, const string_t&) override { return record(value); }
+        bool string(string_t& value) override { return record(std::move(value)); }
+        bool binary(binary_t& value) override { return record(nlohmann::json::binary_t(std::move(value))); }
+        bool start_object(std::size_t) override { return startContainer(false); }
+        bool key(string_t& name) override {
+            path.resize(levels.back().pathLength);
+            appendToken(name);
+            return true;
+        }
+        bool end_object() override { return endContainer(); }
+        bool start_array(std::size_t) override { return startContainer(true); }
+        bool end_array() override { return endContainer(); }
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+    };
+
+    // Next field of a CSV line, unquoted, advancing <position>
+    std::string_view nextCsvField(std::string_view line, size_t& position, std::string& unquoted, bool& quoted) {
+        quoted = position < line.size() && line[position] == '"';
+        if (!quoted) {
+            size_t comma = line.find(',', position);
+            std::string_view field = line.substr(position, comma == std::string_view::npos ? std::string_view::npos : comma - position);
+            position = comma == std::string_view::npos ? line.size() + 1 : comma + 1;
+            return field;
+        }
+        unquoted.clear();
+        size_t i = position + 1;
+        for (; i < line.size(); i++) {
+            if (line[i] == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    unquoted += '"';
+                    i++;
+                    continue;
+                }
+                break;
+            }
+            unquoted += line[i];
+        }
+        size_t comma = line.find(',', i);
+        position = comma == std::string_view::npos ? line.size() + 1 : comma + 1;
+        return unquoted;
+    }
+
+    // Integer (or, failing that, floating point or text) CSV value
+    nlohmann::json csvValue(std::string_view text, bool quoted) {
+        if (!quoted) {
+            const char* first = text.data();
+            const char* last = text.data() + text.size();
+            if (!text.empty() && text.front() == '-') {
+                int64_t value;
+                if (std::from_chars(first, last, value).ptr == last) {
+                    return value;
+                }
+            } else {
+                uint64_t value;
+                if (std::from_chars(first, last, value).ptr == last) {
+                    return value;
+                }
+            }
+            try {
+                size_t used = 0;
+                double value = std::stod(std::string(text), &used);
+                if (used == text.size()) {
+                    return value;
+                }
+            } catch (const std::exception&) {
+            }
+        }
+        return std::string(text);
+    }
+
+    int parseCsvRecord(std::string_view line, const std::vector<Column>& columns, std::string& unquoted, std::string& key, nlohmann::json& flat) {
+        flat = nlohmann::json::object();
+        size_t position = 0;
+        bool quoted = false;
+        for (const auto& column : columns) {
+            if (position > line.size()) {
+                // Fewer cells than columns
+                return FrameReader::ERROR_INVALID_FRAME;
+            }
+            std::string_view cell = nextCsvField(line, position, unquoted, quoted);
+            if (column.ignored || (cell.empty() && !quoted)) {
+                continue;
+            }
+            if (!column.items) {
+                flat[column.path] = csvValue(cell, quoted);
+                continue;
+            }
+            size_t index = 0;
+            for (size_t start = 0; start < cell.size();) {
+                size_t space = cell.find(' ', start);
+                std::string_view item = cell.substr(start, space == std::string_view::npos ? std::string_view::npos : space - start);
+                start = space == std::string_view::npos ? cell.size() : space + 1;
+                if (item.empty()) {
+                    continue;
+                }
+                key = column.path;
+                key += std::to_string(index++);
+                flat[key] = csvValue(item, false);
+            }
+        }
+        return FrameReader::STATUS_OK;
+    }
+
+    int parseCsvHeader(std::string_view header, std::vector<Column>& columns) {
+        std::string unquoted;
+        bool quoted = false;
+        for (size_t position = 0; position <= header.size();) {
+            Column column;
+            column.path = std::string(nextCsvField(header, position, unquoted, quoted));
+            column.ignored = column.path.empty() || column.path.front() != '/';
+            size_t star = column.path.find("/*");
+            if (!column.ignored && star != std::string::npos) {
+                // The items of one array only: the indices of nested arrays
+                // are not in the cell
+                if (star + 2 != column.path.size() || column.path.find('*') != star + 1) {
+                    std::fprintf(stderr, "Column <%s> not supported: only the last path token can be \"*\"\n", column.path.c_str());
+                    return 1;
+                }
+                column.path.pop_back();
+                column.items = true;
+            }
+            columns.push_back(std::move(column));
+        }
+        return 0;
+    }
+
+    void appendFrame(std::string& output, const BitStream& bitStream, CaptureFormat::Type format) {
+        const char* bytes = reinterpret_cast<const char*>(bitStream.getBuffer());
+        if (format == CaptureFormat::Type::BASE64_LINES) {
+            output += bitStream.to_base64();
+            output += '\n';
+            return;
+        }
+        if (format == CaptureFormat::Type::LENGTH_PREFIXED) {
+            uint32_t bitLength = static_cast<uint32_t>(bitStream.getCapacity());
+            char prefix[4] = {char(bitLength), char(bitLength >> 8), char(bitLength >> 16), char(bitLength >> 24)};
+            output.append(prefix, sizeof(prefix));
+        }
+        output.append(bytes, bitStream.getByteLength());
+    }
+
+    // Per worker
+    struct WorkerState {
+        std::unique_ptr<FlatteningHandler> handler;
+        nlohmann::json flat;
+        std::string unquoted;
+        std::string key;
+    };
+
+    void encodeChunk(TaskPool::Context& context, const MappedFile& file, size_t begin, size_t end, SchemaId schemaId, const Options& options,
+                     const std::vector<Column>& columns, WorkerLocal<WorkerState>& states, ChunkResult& result) {
+        WorkerState& state = states.get(context);
+        if (!state.handler) {
+            state.handler = std::make_unique<FlatteningHandler>(options.field);
+        }
+        const char* text = reinterpret_cast<const char*>(file.getData());
+        for (size_t position = begin; position < end;) {
+            const void* newline = std::memchr(text + position, '\n', end - position);
+            size_t length = newline ? static_cast<const char*>(newline) - (text + position) : end - position;
+            std::string_view line(text + position, length);
+            size_t offset = position;
+            position += newline ? length + 1 : length;
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+
+            int retVal = FrameReader::STATUS_OK;
+            if (options.csv) {
+                retVal = parseCsvRecord(line, columns, state.unquoted, state.key, state.flat);
+            } else {
+                state.handler->reset(state.flat);
+                if (!nlohmann::json::sax_parse(line.begin(), line.end(), state.handler.get())) {
+                    retVal = FrameReader::ERROR_INVALID_FRAME;
+                }
+            }
+            if (retVal == FrameReader::STATUS_OK) {
+                BitStream bitStream(context.scratch);
+                try {
+                    retVal = context.decoder.json_to_bitstream(schemaId, state.flat, bitStream);
+                } catch (const std::exception&) {
+                    retVal = FrameReader::ERROR_INVALID_FRAME;
+                }
+                if (retVal == FrameReader::STATUS_OK && bitStream.getCapacity() == 0) {
+                    retVal = FrameReader::ERROR_INVALID_FRAME;
+                }
+                if (retVal == FrameReader::STATUS_OK) {
+                    appendFrame(result.output, bitStream, options.format);
+                }
+            }
+            context.scratch.reset();
+            if (retVal != FrameReader::STATUS_OK) {
+                if (result.errors++ < ERRORS_REPORTED) {
+                    result.errorMessages.push_back("Record at offset " + std::to_string(offset) + " not encoded (code " + std::to_string(retVal) + ")");
+                }
+                continue;
+            }
+            result.records++;
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string catalogDirectory = argv[1];
+    const std::string schemaName = argv[2];
+    const std::string inputPath = argv[3];
+    Options options;
+    for (int i = 4; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--input-format" && hasValue) {
+            std::string inputFormat = argv[++i];
+            if (inputFormat != "ndjson" && inputFormat != "csv") {
+                std::fprintf(stderr, "Unknown input format <%s>\n", inputFormat.c_str());
+                return 1;
+            }
+            options.csv = inputFormat == "csv";
+        } else if (argument == "--field" && hasValue) {
+            options.field = argv[++i];
+        } else if (argument == "--format" && hasValue) {
+            auto type = CaptureFormat::parse(argv[++i]);
+            if (!type || type.value() == CaptureFormat::Type::CANDUMP || type.value() == CaptureFormat::Type::SYNC) {
+                std::fprintf(stderr, "Unknown output format <%s>\n", argv[i]);
+                return 1;
+            }
+            options.format = type.value();
+        } else if (argument == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (argument == "--threads" && hasValue) {
+            options.threads = std::stoull(argv[++i]);
+        } else if (argument == "--chunk-size" && hasValue) {
+            options.chunkSize = std::stoull(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    if (SchemaCatalog::getInstance().loadCatalog(catalogDirectory)) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", catalogDirectory.c_str());
+        return 1;
+    }
+    auto schemaId = SchemaCatalog::getInstance().resolve(schemaName);
+    if (!schemaId) {
+        std::fprintf(stderr, "Unknown schema <%s>\n", schemaName.c_str());
+        return 1;
+    }
+    MappedFile file;
+    if (file.open(inputPath)) {
+        return 1;
+    }
+
+    // The records start after the header of a CSV file
+    size_t begin = 0;
+    std::vector<Column> columns;
+    if (options.csv && file.getSize() > 0) {
+        const char* text = reinterpret_cast<const char*>(file.getData());
+        const void* newline = std::memchr(text, '\n', file.getSize());
+        std::string_view header(text, newline ? static_cast<const char*>(newline) - text : file.getSize());
+        if (!header.empty() && header.back() == '\r') {
+            header.remove_suffix(1);
+        }
+        if (parseCsvHeader(header, columns)) {
+            return 1;
+        }
+        begin = newline ? static_cast<const char*>(newline) - text + 1 : file.getSize();
+    }
+
+    FILE* output = options.outputPath.empty() ? stdout : std::fopen(options.outputPath.c_str(), "wb");
+    if (!output) {
+        std::fprintf(stderr, "Impossible to open <%s>\n", options.outputPath.c_str());
+        return 1;
+    }
+
+    auto start = Clock::now();
+    TaskPoolOptions poolOptions;
+    poolOptions.threads = options.threads;
+    TaskPool pool(poolOptions);
+    WorkerLocal<WorkerState> states(pool);
+    // Chunks of whole lines
+    CaptureFormat lines;
+    lines.type = CaptureFormat::Type::BASE64_LINES;
+    std::vector<size_t> boundaries = FrameReader::chunkBoundaries(file.getData() + begin, file.getSize() - begin, options.chunkSize, lines);
+    for (auto& boundary : boundaries) {
+        boundary += begin;
+    }
+    // Two chunks per worker: one being encoded, one waiting to be written
+    OrderedPipeline<ChunkResult> pipeline(pool, 2 * pool.size());
+    size_t records = 0;
+    size_t errors = 0;
+    size_t outputBytes = 0;
+    pipeline.run(
+        boundaries.size() - 1,
+        [&](TaskPool::Context& context, size_t chunk, ChunkResult& result) {
+            encodeChunk(context, file, boundaries[chunk], boundaries[chunk + 1], schemaId.value(), options, columns, states, result);
+        },
+        [&](size_t chunk, ChunkResult& result) {
+            std::fwrite(result.output.data(), 1, result.output.size(), output);
+            file.release(boundaries[chunk], boundaries[chunk + 1]);
+            for (const auto& message : result.errorMessages) {
+                if (errors++ < ERRORS_REPORTED) {
+                    std::fprintf(stderr, "%s\n", message.c_str());
+                }
+            }
+            errors += result.errors - result.errorMessages.size();
+            records += result.records;
+            outputBytes += result.output.size();
+        });
+    if (output != stdout) {
+        std::fclose(output);
+    } else {
+        std::fflush(output);
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::fprintf(stderr, "%zu records encoded, %zu errors from %zu bytes to %zu bytes in %.3f s (%zu threads): %.0f records/s, %.1f MB/s\n", records,
+                 errors, file.getSize(), outputBytes, seconds, pool.size(), records / seconds, file.getSize() / seconds / 1e6);
+    return errors ? 2 : 0;
+}
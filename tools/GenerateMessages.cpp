@@ -0,0 +1,163 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "opencmd.hpp"
+#include "generator/MessageGenerator.hpp"
+
+using namespace opencmd;
+using Clock = std::chrono::steady_clock;
+
+// Writes random valid messages of a catalog schema: one base64 frame per
+// line, length-prefixed binary frames (32 bits little endian bit length,
+// then the bytes) or JSON lines with the frame and its decoded message in
+// the toJson shape. With --verify every frame is decoded again and checked
+// against the generated fields.
+//
+// Usage: opencmd_generate <catalog directory> <schema> [--count n] [--seed n]
+//            [--format base64|length-prefixed|jsonl] [--output file]
+//            [--distribution uniform|boundary] [--min-repetitions n]
+//            [--max-repetitions n] [--range path=min:max]... [--verify]
+
+static void usage(const char* program) {
+    std::fprintf(stderr,
+                 "Usage: %s <catalog directory> <schema> [--count n] [--seed n] [--format base64|length-prefixed|jsonl] [--output file]\n"
+                 "       [--distribution uniform|boundary] [--min-repetitions n] [--max-repetitions n] [--range path=min:max]... [--verify]\n",
+                 program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string catalogDirectory = argv[1];
+    const std::string schemaName = argv[2];
+    GeneratorOptions options;
+    size_t count = 1000;
+    std::string format = "base64";
+    std::string outputPath;
+    bool verify = false;
+    for (int i = 3; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--count" && hasValue) {
+            count = std::stoull(argv[++i]);
+        } else if (argument == "--seed" && hasValue) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (argument == "--format" && hasValue) {
+            format = argv[++i];
+        } else if (argument == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else if (argument == "--distribution" && hasValue) {
+            std::string distribution = argv[++i];
+            options.distribution = distribution == "boundary" ? GeneratorOptions::Distribution::BOUNDARY : GeneratorOptions::Distribution::UNIFORM;
+        } else if (argument == "--min-repetitions" && hasValue) {
+            options.minRepetitions = std::stoull(argv[++i]);
+        } else if (argument == "--max-repetitions" && hasValue) {
+            options.maxRepetitions = std::stoull(argv[++i]);
+        } else if (argument == "--range" && hasValue) {
+            std::string range = argv[++i];
+            size_t equal = range.rfind('=');
+            size_t colon = range.rfind(':');
+            if (equal == std::string::npos || colon == std::string::npos || colon < equal) {
+                std::fprintf(stderr, "Invalid range <%s>, path=min:max expected\n", range.c_str());
+                return 1;
+            }
+            options.ranges[range.substr(0, equal)] = {std::stoull(range.substr(equal + 1, colon - equal - 1)), std::stoull(range.substr(colon + 1))};
+        } else if (argument == "--verify") {
+            verify = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (format != "base64" && format != "length-prefixed" && format != "jsonl") {
+        std::fprintf(stderr, "Unknown format <%s>\n", format.c_str());
+        return 1;
+    }
+
+    Logger::getInstance().setSeverity(Logger::Level::ERROR);
+    if (SchemaCatalog::getInstance().loadCatalog(catalogDirectory)) {
+        std::fprintf(stderr, "Error in loading the catalog <%s>\n", catalogDirectory.c_str());
+        return 1;
+    }
+    auto schema = SchemaCatalog::getInstance().getSchema(schemaName);
+    if (!schema) {
+        std::fprintf(stderr, "Unknown schema <%s>\n", schemaName.c_str());
+        return 1;
+    }
+    MessageGenerator generator(options);
+    if (generator.load(*schema)) {
+        std::fprintf(stderr, "Schema <%s> not supported by the generator\n", schemaName.c_str());
+        return 1;
+    }
+
+    FILE* output = outputPath.empty() ? stdout : std::fopen(outputPath.c_str(), "wb");
+    if (!output) {
+        std::fprintf(stderr, "Impossible to open <%s>\n", outputPath.c_str());
+        return 1;
+    }
+
+    Arena arena;
+    DecoderContext context;
+    std::string buffer;
+    size_t mismatches = 0;
+    size_t bytes = 0;
+    bool withFields = verify || format == "jsonl";
+    nlohmann::ordered_json fields;
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        BitStream bitStream(arena);
+        fields.clear();
+        generator.generate(bitStream, withFields ? &fields : nullptr);
+        bytes += bitStream.getByteLength();
+
+        if (verify) {
+            BitStream decodeStream = BitStream::view(bitStream.getBuffer(), bitStream.getCapacity());
+            nlohmann::ordered_json decoded;
+            int retVal = -1;
+            try {
+                retVal = context.bitstream_to_json(schema->getId(), decodeStream, decoded);
+            } catch (const std::out_of_range&) {
+            }
+            if (retVal != 0 || decoded != fields || decodeStream.getOffset() != bitStream.getCapacity()) {
+                if (mismatches++ < 5) {
+                    std::fprintf(stderr, "Mismatch on message %zu (code %d): generated %s, decoded %s\n", i, retVal, fields.dump().c_str(),
+                                 decoded.dump().c_str());
+                }
+            }
+        }
+
+        if (format == "base64") {
+            buffer += bitStream.to_base64();
+            buffer += '\n';
+        } else if (format == "length-prefixed") {
+            uint32_t bitLength = static_cast<uint32_t>(bitStream.getCapacity());
+            uint8_t prefix[4] = {uint8_t(bitLength), uint8_t(bitLength >> 8), uint8_t(bitLength >> 16), uint8_t(bitLength >> 24)};
+            buffer.append(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+            buffer.append(reinterpret_cast<const char*>(bitStream.getBuffer()), bitStream.getByteLength());
+        } else {
+            nlohmann::ordered_json line;
+            line["message_base64"] = bitStream.to_base64();
+            line["bit_length"] = bitStream.getCapacity();
+            line["message_json"] = fields.unflatten();
+            buffer += line.dump();
+            buffer += '\n';
+        }
+        if (buffer.size() >= (1 << 20)) {
+            std::fwrite(buffer.data(), 1, buffer.size(), output);
+            buffer.clear();
+        }
+        arena.reset();
+    }
+    std::fwrite(buffer.data(), 1, buffer.size(), output);
+    if (output != stdout) {
+        std::fclose(output);
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::fprintf(stderr, "%zu messages (%zu bytes) in %.3f s: %.0f msg/s%s\n", count, bytes, seconds, count / seconds,
+                 verify ? (", " + std::to_string(mismatches) + " mismatches").c_str() : "");
+    return mismatches ? 2 : 0;
+}